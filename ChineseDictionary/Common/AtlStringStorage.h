@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// AtlStringStorage.h -- Storage policy based on ATL's CStringW (V2A).
+//
+// See StoragePolicies.h for the storage policy interface.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <atlstr.h>     // for CStringW
+#include "DictionaryOptions.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+class CStringStorage
+{
+public:
+    typedef WCHAR CharType;
+    typedef CStringW String;
+
+    explicit CStringStorage(const DictionaryOptions&) {}
+
+    String Alloc(const WCHAR* pchBegin, const WCHAR* pchEnd)
+    {
+        return String(pchBegin, static_cast<int>(pchEnd - pchBegin));
+    }
+
+    void Free(String&) {}
+
+    static TextSpan<WCHAR> View(const String& s)
+    {
+        return MakeSpan(s.GetString(), s.GetString() + s.GetLength());
+    }
+
+    // Non-empty strings have a buffer of their own, after a CStringData
+    // header; the empty ones share a static one.
+    static void CountBytes(const String& s, size_t* pcbUsed, size_t* pcbSlack)
+    {
+        if (s.GetAllocLength() == 0) return;
+        *pcbUsed += (s.GetLength() + 1) * sizeof(WCHAR);
+        *pcbSlack += (s.GetAllocLength() - s.GetLength()) * sizeof(WCHAR) + sizeof(CStringData);
+    }
+
+    void Reserve(size_t) {}
+    size_t ChunkCount() const { return 0; }
+    size_t LargePageChunkCount() const { return 0; }
+    size_t ChunkBytes() const { return 0; }
+};
+
+
+} // namespace cedict
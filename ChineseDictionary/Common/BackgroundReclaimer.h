@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// BackgroundReclaimer.h -- Destroys retired objects on a background thread.
+//
+// Freeing a loaded dictionary is not free: the entry vector and, depending on
+// the storage policy, one heap block per string (V3 frees three per entry)
+// or a few hundred pool chunks. When a dictionary is replaced by a reloaded
+// one, the thread that swaps them in should not pay for that. Retire() moves
+// the old dictionary (or any other object) to the reclaimer, whose thread
+// destroys it while the caller goes on.
+//
+// Typical reload path:
+//
+//     std::unique_ptr<Dictionary> fresh(new Dictionary(pszFile));
+//     current.swap(fresh);
+//     reclaimer.Retire(std::move(fresh));   // the old one, freed later
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "LoadTrace.h"
+
+
+namespace cedict
+{
+
+
+class BackgroundReclaimer
+{
+public:
+    BackgroundReclaimer()
+        : m_fStop(false)
+        , m_fBusy(false)
+        , m_cReclaimed(0)
+    {
+        m_thread = std::thread([this]() { Run(); });
+        // Reclaiming is never urgent: leave the processors to the request
+        // threads.
+        SetThreadPriority(m_thread.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+    }
+
+    // Destroys whatever is still pending, then stops the thread.
+    ~BackgroundReclaimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_fStop = true;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+    }
+
+    // Hand p over to the background thread, which destroys it. Only takes a
+    // lock and pushes a pointer: the caller never runs the destructor.
+    template <typename T>
+    void Retire(std::unique_ptr<T> p)
+    {
+        if (!p) return;
+        std::unique_ptr<RetiredBase> retired(new Retired<T>(std::move(p)));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.push_back(std::move(retired));
+        }
+        m_wake.notify_one();
+    }
+
+    // Wait until everything retired so far has been destroyed.
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return m_pending.empty() && !m_fBusy; });
+    }
+
+    // Objects destroyed so far.
+    size_t ReclaimedCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_cReclaimed;
+    }
+
+private:
+    BackgroundReclaimer(const BackgroundReclaimer&) = delete;
+    BackgroundReclaimer& operator=(const BackgroundReclaimer&) = delete;
+
+    struct RetiredBase
+    {
+        virtual ~RetiredBase() {}
+    };
+
+    template <typename T>
+    struct Retired : RetiredBase
+    {
+        explicit Retired(std::unique_ptr<T> p) : object(std::move(p)) {}
+        std::unique_ptr<T> object;
+    };
+
+    void Run()
+    {
+        Tracer::SetThreadName("reclaimer");
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [this]() { return m_fStop || !m_pending.empty(); });
+            if (m_pending.empty()) return;  // stopping, and nothing left
+
+            std::unique_ptr<RetiredBase> retired(std::move(m_pending.front()));
+            m_pending.pop_front();
+            m_fBusy = true;
+
+            // The destructor runs without the lock, so that Retire() never
+            // waits for it.
+            lock.unlock();
+            {
+                TraceScope trace("reclaim");
+                retired.reset();
+            }
+            lock.lock();
+
+            m_fBusy = false;
+            m_cReclaimed++;
+            if (m_pending.empty()) m_idle.notify_all();
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;     // work to do, or stopping
+    std::condition_variable m_idle;     // queue drained
+    std::deque<std::unique_ptr<RetiredBase>> m_pending;
+    bool m_fStop;
+    bool m_fBusy;
+    size_t m_cReclaimed;
+    std::thread m_thread;
+};
+
+
+} // namespace cedict
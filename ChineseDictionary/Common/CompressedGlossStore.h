@@ -0,0 +1,345 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// CompressedGlossStore.h -- English glosses compressed with a static symbol
+//                           table, with random access to single entries.
+//
+// The glosses are mostly ASCII English, with a lot of recurring words and
+// fragments ("variant of", "(literary)", "CL:"...). Like FSST (Boncz,
+// Neumann, Leis: "FSST: Fast Random Access String Compression", VLDB 2020),
+// the store learns up to 255 symbols of 1 to 8 ASCII characters from a
+// sample of the glosses, and encodes each gloss as a sequence of 1-byte
+// symbol codes. Characters not covered by a symbol (e.g. the Chinese
+// characters of "variant of" cross-references) follow an escape code.
+//
+// As each gloss is encoded on its own, decoding entry i only touches its
+// own bytes and the symbol table: a loop of table lookups and 8-character
+// copies, with no per-entry frames or state to set up.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <cstring>      // for memcpy
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+template <typename Char>
+class CompressedGlossStore
+{
+public:
+    enum {
+        kMaxSymbolLength = 8,
+        kEscape = 255,              // followed by sizeof(Char) raw bytes
+        kMaxSymbols = kEscape,
+        kSampleLength = 64 * 1024,  // characters of glosses to train on
+        kTrainingRounds = 5
+    };
+
+    CompressedGlossStore() : m_cSymbols(0), m_cchMax(0), m_cbRaw(0) {}
+
+    // Add the gloss of the next entry; Compress() must be called once all of
+    // them have been added.
+    void Append(const Char* pchBegin, const Char* pchEnd);
+
+    // Learn the symbol table and encode the appended glosses.
+    void Compress();
+
+    size_t Length() const { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+
+    // Characters needed by the buffer passed to Decode().
+    size_t BufferLength() const { return m_cchMax + kMaxSymbolLength; }
+
+    // Decode gloss i into pchDest, which must hold BufferLength() characters.
+    // Returns the length of the gloss (no terminator is written).
+    size_t Decode(size_t i, Char* pchDest) const;
+
+    size_t RawBytes() const { return m_cbRaw; }
+    size_t CompressedBytes() const { return m_data.size(); }
+    size_t OffsetBytes() const { return m_offsets.size() * sizeof(UINT32); }
+    size_t SymbolTableBytes() const { return sizeof(m_symbols); }
+    size_t SymbolCount() const { return m_cSymbols; }
+
+    // Memory held by the store: the encoded glosses, their offsets and the
+    // symbol tables (and the glosses not compressed yet, if any).
+    size_t Bytes() const
+    {
+        return m_data.capacity() + m_offsets.capacity() * sizeof(UINT32)
+            + sizeof(m_symbols) + sizeof(m_singleCodes)
+            + m_longFirst.capacity() * sizeof(UINT32) + m_longCodes.capacity()
+            + m_shortCodes.capacity() * sizeof(int)
+            + m_pending.capacity() * sizeof(Char) + m_pendingOffsets.capacity() * sizeof(UINT32);
+    }
+
+private:
+    // While encoding, the (up to 8) ASCII characters at the current position
+    // are packed 7 bits each, with their count in the top byte: the same key
+    // identifies a symbol, and a symbol matches if its bits are a prefix of
+    // the packed text.
+    typedef UINT64 SymbolKey;
+
+    static SymbolKey PackText(const Char* pch, const Char* pchEnd);
+    static size_t KeyLength(SymbolKey key) { return static_cast<size_t>(key >> 56); }
+    static UINT64 KeyBits(SymbolKey key) { return key & ((1ull << 56) - 1); }
+    static UINT64 LengthMask(size_t cch) { return (1ull << (7 * cch)) - 1; }
+    static UINT32 KeyPrefix(SymbolKey key) { return static_cast<UINT32>(key & 0x3FFF); }
+
+    struct Symbol
+    {
+        Char ch[kMaxSymbolLength];
+        UINT32 cch;
+        SymbolKey key;
+    };
+
+    void SetSymbols(const std::vector<SymbolKey>& symbols);
+    size_t MatchSymbol(SymbolKey text, int* pCode) const;
+    void Encode(const Char* pchBegin, const Char* pchEnd);
+
+    Symbol m_symbols[kMaxSymbols];
+    size_t m_cSymbols;
+
+    // Symbols of 3 or more characters by their first two characters, longest
+    // first; the symbols of 1 or 2 characters are looked up directly.
+    std::vector<UINT32> m_longFirst;        // 128 * 128 + 1 offsets into m_longCodes
+    std::vector<BYTE> m_longCodes;
+    std::vector<int> m_shortCodes;          // 128 * 128 codes (or kEscape)
+    int m_singleCodes[128];
+
+    std::vector<BYTE> m_data;
+    std::vector<UINT32> m_offsets;          // gloss i is [m_offsets[i], m_offsets[i + 1])
+    size_t m_cchMax;
+    size_t m_cbRaw;
+
+    // Glosses appended but not compressed yet.
+    std::vector<Char> m_pending;
+    std::vector<UINT32> m_pendingOffsets;
+};
+
+
+template <typename Char>
+void CompressedGlossStore<Char>::Append(const Char* pchBegin, const Char* pchEnd)
+{
+    if (m_pendingOffsets.empty()) m_pendingOffsets.push_back(0);
+    m_pending.insert(m_pending.end(), pchBegin, pchEnd);
+    m_pendingOffsets.push_back(static_cast<UINT32>(m_pending.size()));
+    m_cchMax = (std::max)(m_cchMax, static_cast<size_t>(pchEnd - pchBegin));
+}
+
+template <typename Char>
+typename CompressedGlossStore<Char>::SymbolKey CompressedGlossStore<Char>::PackText(
+    const Char* pch, const Char* pchEnd)
+{
+    UINT64 bits = 0;
+    size_t cch = 0;
+    for (; cch < kMaxSymbolLength && pch + cch < pchEnd; ++cch) {
+        UINT32 ch = static_cast<UINT32>(pch[cch]);
+        if (ch >= 128) break;
+        bits |= static_cast<UINT64>(ch) << (7 * cch);
+    }
+    return bits | (static_cast<UINT64>(cch) << 56);
+}
+
+template <typename Char>
+void CompressedGlossStore<Char>::SetSymbols(const std::vector<SymbolKey>& symbols)
+{
+    m_cSymbols = symbols.size();
+    std::fill(m_singleCodes, m_singleCodes + 128, static_cast<int>(kEscape));
+    m_shortCodes.assign(128 * 128, kEscape);
+    m_longFirst.assign(128 * 128 + 1, 0);
+
+    for (size_t code = 0; code < m_cSymbols; ++code) {
+        Symbol& symbol = m_symbols[code];
+        symbol.key = symbols[code];
+        symbol.cch = static_cast<UINT32>(KeyLength(symbol.key));
+        for (size_t i = 0; i < kMaxSymbolLength; ++i) {
+            symbol.ch[i] = static_cast<Char>((symbol.key >> (7 * i)) & 0x7F);
+        }
+        if (symbol.cch == 1) {
+            m_singleCodes[symbol.key & 0x7F] = static_cast<int>(code);
+        } else if (symbol.cch == 2) {
+            m_shortCodes[KeyPrefix(symbol.key)] = static_cast<int>(code);
+        } else {
+            m_longFirst[KeyPrefix(symbol.key) + 1]++;
+        }
+    }
+
+    // Two-character prefixes without a 2-character symbol fall back to the
+    // symbol of their first character.
+    for (UINT32 prefix = 0; prefix < 128 * 128; ++prefix) {
+        if (m_shortCodes[prefix] == kEscape) {
+            m_shortCodes[prefix] = m_singleCodes[prefix & 0x7F];
+        }
+    }
+
+    for (size_t prefix = 0; prefix < 128 * 128; ++prefix) {
+        m_longFirst[prefix + 1] += m_longFirst[prefix];
+    }
+    m_longCodes.assign(m_longFirst.back(), 0);
+    std::vector<UINT32> next(m_longFirst.begin(), m_longFirst.end() - 1);
+    for (size_t code = 0; code < m_cSymbols; ++code) {
+        if (m_symbols[code].cch > 2) {
+            m_longCodes[next[KeyPrefix(m_symbols[code].key)]++] = static_cast<BYTE>(code);
+        }
+    }
+    for (size_t prefix = 0; prefix < 128 * 128; ++prefix) {
+        std::sort(m_longCodes.begin() + m_longFirst[prefix],
+            m_longCodes.begin() + m_longFirst[prefix + 1], [this](BYTE a, BYTE b) {
+                return m_symbols[a].cch > m_symbols[b].cch;
+            });
+    }
+}
+
+// Longest symbol at the packed text: returns its length and code, or 1 and
+// kEscape.
+template <typename Char>
+size_t CompressedGlossStore<Char>::MatchSymbol(SymbolKey text, int* pCode) const
+{
+    size_t cchText = KeyLength(text);
+    if (cchText == 0) {
+        *pCode = kEscape;
+        return 1;
+    }
+    if (cchText == 1) {
+        *pCode = m_singleCodes[text & 0x7F];
+        return 1;
+    }
+
+    UINT32 prefix = KeyPrefix(text);
+    for (UINT32 i = m_longFirst[prefix]; i < m_longFirst[prefix + 1]; ++i) {
+        const Symbol& symbol = m_symbols[m_longCodes[i]];
+        if (symbol.cch <= cchText
+                && ((text ^ symbol.key) & LengthMask(symbol.cch)) == 0) {
+            *pCode = m_longCodes[i];
+            return symbol.cch;
+        }
+    }
+    *pCode = m_shortCodes[prefix];
+    return *pCode == kEscape ? 1 : m_symbols[*pCode].cch;
+}
+
+template <typename Char>
+void CompressedGlossStore<Char>::Compress()
+{
+    const size_t cGlosses = m_pendingOffsets.empty() ? 0 : m_pendingOffsets.size() - 1;
+    m_cbRaw = m_pending.size() * sizeof(Char);
+
+    // Training sample: every n-th gloss, about kSampleLength characters.
+    size_t step = (std::max)(static_cast<size_t>(1), m_pending.size() / kSampleLength);
+    std::vector<std::pair<UINT32, UINT32>> sample;
+    for (size_t i = 0; i < cGlosses; i += step) {
+        sample.push_back(std::make_pair(m_pendingOffsets[i], m_pendingOffsets[i + 1]));
+    }
+
+    // Each round parses the sample with the current symbols and counts
+    // the symbols and the concatenations of adjacent symbols. The next
+    // symbols are the candidates that cover the most characters.
+    std::vector<SymbolKey> symbols;
+    for (int round = 0; round < kTrainingRounds; ++round) {
+        SetSymbols(symbols);
+
+        std::unordered_map<SymbolKey, size_t> counts;
+        for (const auto& gloss : sample) {
+            const Char* pch = m_pending.data() + gloss.first;
+            const Char* pchEnd = m_pending.data() + gloss.second;
+            SymbolKey prev = 0;
+            while (pch < pchEnd) {
+                SymbolKey text = PackText(pch, pchEnd);
+                int code;
+                size_t cch = MatchSymbol(text, &code);
+                pch += cch;
+
+                // Non-ASCII characters are no candidates, and break the pairs.
+                SymbolKey cur = 0;
+                if (KeyLength(text) != 0) {
+                    cur = (KeyBits(text) & LengthMask(cch)) | (static_cast<UINT64>(cch) << 56);
+                    counts[cur]++;
+                }
+                size_t cchPair = KeyLength(prev) + cch;
+                if (KeyLength(prev) != 0 && cur != 0 && cchPair <= kMaxSymbolLength) {
+                    UINT64 bits = KeyBits(prev) | (KeyBits(cur) << (7 * KeyLength(prev)));
+                    counts[bits | (static_cast<UINT64>(cchPair) << 56)]++;
+                }
+                prev = cur;
+            }
+        }
+
+        std::vector<std::pair<size_t, SymbolKey>> candidates;
+        candidates.reserve(counts.size());
+        for (const auto& c : counts) {
+            candidates.push_back(std::make_pair(c.second * KeyLength(c.first), c.first));
+        }
+        size_t cKeep = (std::min)(candidates.size(), static_cast<size_t>(kMaxSymbols));
+        std::partial_sort(candidates.begin(), candidates.begin() + cKeep, candidates.end(),
+            [](const std::pair<size_t, SymbolKey>& a, const std::pair<size_t, SymbolKey>& b) {
+                return a.first > b.first || (a.first == b.first && a.second < b.second);
+            });
+
+        symbols.clear();
+        for (size_t i = 0; i < cKeep; ++i) {
+            symbols.push_back(candidates[i].second);
+        }
+    }
+    SetSymbols(symbols);
+
+    m_offsets.clear();
+    m_offsets.reserve(cGlosses + 1);
+    m_data.reserve(m_pending.size() / 2);
+    m_offsets.push_back(0);
+    for (size_t i = 0; i < cGlosses; ++i) {
+        Encode(m_pending.data() + m_pendingOffsets[i], m_pending.data() + m_pendingOffsets[i + 1]);
+        m_offsets.push_back(static_cast<UINT32>(m_data.size()));
+    }
+    m_data.shrink_to_fit();
+
+    std::vector<Char>().swap(m_pending);
+    std::vector<UINT32>().swap(m_pendingOffsets);
+}
+
+template <typename Char>
+void CompressedGlossStore<Char>::Encode(const Char* pchBegin, const Char* pchEnd)
+{
+    for (const Char* pch = pchBegin; pch < pchEnd; ) {
+        int code;
+        size_t cch = MatchSymbol(PackText(pch, pchEnd), &code);
+        m_data.push_back(static_cast<BYTE>(code));
+        if (code == kEscape) {
+            const BYTE* pb = reinterpret_cast<const BYTE*>(pch);
+            m_data.insert(m_data.end(), pb, pb + sizeof(Char));
+        }
+        pch += cch;
+    }
+}
+
+template <typename Char>
+size_t CompressedGlossStore<Char>::Decode(size_t i, Char* pchDest) const
+{
+    const BYTE* pb = m_data.data() + m_offsets[i];
+    const BYTE* pbEnd = m_data.data() + m_offsets[i + 1];
+    Char* pch = pchDest;
+    while (pb < pbEnd) {
+        BYTE code = *pb++;
+        if (code != kEscape) {
+            // Always copy a whole symbol: the buffer has room for it.
+            const Symbol& symbol = m_symbols[code];
+            memcpy(pch, symbol.ch, sizeof(symbol.ch));
+            pch += symbol.cch;
+        } else {
+            memcpy(pch, pb, sizeof(Char));
+            pb += sizeof(Char);
+            pch++;
+        }
+    }
+    return pch - pchDest;
+}
+
+
+} // namespace cedict
@@ -0,0 +1,360 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// CrossReferenceGraph.h -- Links between entries, from the references that
+//                          their English glosses make to other entries.
+//
+// CEDICT writes the references as text in the glosses:
+//
+//     variant of 為|为[wei4]          (also "old variant of", ...)
+//     see 某某[mou3 mou3]             (also "see also")
+//     CL:個|个[ge4],隻|只[zhi1]        (the classifiers of a noun)
+//
+// A reference is a traditional headword, then the simplified one after a
+// '|' when it differs, then the pinyin in brackets, which may be missing.
+// The graph extracts them once, after loading, and resolves each to the
+// entries with that traditional headword and that pinyin (or to all the
+// entries with that headword when no pinyin matches, or none is given).
+//
+// The links are stored in compressed sparse row form: the links of entry
+// id are m_links[m_linkStarts[id]] to m_links[m_linkStarts[id + 1] - 1],
+// each a linked entry id with its kind in the top 2 bits, so following the
+// references of an entry is a walk over a few adjacent integers:
+//
+//     for (const UINT32* p = graph.LinksBegin(id); p != graph.LinksEnd(id); ++p) {
+//         if (LinkKind(*p) == kClassifierReference) Use(dict.Item(LinkedEntry(*p)));
+//     }
+//
+// The reverse links (the entries that refer to an entry: the variants of a
+// character, the nouns that take a classifier) are stored the same way.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "HeadwordIndex.h"
+#include "LoadTrace.h"
+#include "Pinyin.h"
+#include "TaskScheduler.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+enum CrossReferenceKind
+{
+    kVariantReference,      // "variant of X", "old variant of X"...
+    kSeeReference,          // "see X", "see also X"
+    kClassifierReference,   // "CL:X,Y"
+};
+
+const size_t kCrossReferenceKinds = 3;
+
+// A reference as written in a gloss; the spans point into the gloss.
+template <typename Char>
+struct CrossReference
+{
+    CrossReferenceKind kind;
+    TextSpan<Char> trad;
+    TextSpan<Char> simp;        // the same as trad when only one is written
+    TextSpan<Char> pinyin;      // empty when none is written
+};
+
+
+namespace detail
+{
+
+template <typename Char>
+inline bool IsAsciiUnit(Char ch)
+{
+    return static_cast<typename std::make_unsigned<Char>::type>(ch) < 0x80;
+}
+
+// Whether [pch, pchEnd) starts with the ASCII string psz.
+template <typename Char>
+bool StartsWith(const Char* pch, const Char* pchEnd, const char* psz)
+{
+    for (; *psz; ++psz, ++pch) {
+        if (pch == pchEnd || *pch != static_cast<Char>(*psz)) return false;
+    }
+    return true;
+}
+
+// A headword of a reference: up to the next delimiter, or the end of the
+// gloss.
+template <typename Char>
+const Char* SkipHeadword(const Char* pch, const Char* pchEnd)
+{
+    while (pch < pchEnd) {
+        UINT32 u = static_cast<UINT32>(*pch);
+        if (u == ' ' || u == '|' || u == '[' || u == ']' || u == ',' || u == ';'
+            || u == '(' || u == ')' || u == '/') break;
+        ++pch;
+    }
+    return pch;
+}
+
+// Parses a reference, trad[|simp][[pinyin]], at pch. The headword must
+// start with a character outside ASCII, so that "see below" is not taken
+// for one. Returns the end of the reference, or nullptr.
+template <typename Char>
+const Char* ParseCrossReference(const Char* pch, const Char* pchEnd, CrossReference<Char>& ref)
+{
+    if (pch == pchEnd || IsAsciiUnit(*pch)) return nullptr;
+    ref.trad = MakeSpan(pch, SkipHeadword(pch, pchEnd));
+    ref.simp = ref.trad;
+    pch = ref.trad.pchEnd;
+    if (pch < pchEnd && *pch == static_cast<Char>('|')) {
+        ref.simp = MakeSpan(pch + 1, SkipHeadword(pch + 1, pchEnd));
+        pch = ref.simp.pchEnd;
+        if (ref.simp.Length() == 0) return nullptr;
+    }
+    ref.pinyin = MakeSpan(pch, pch);
+    if (pch < pchEnd && *pch == static_cast<Char>('[')) {
+        const Char* pchClose = pch + 1;
+        while (pchClose < pchEnd && *pchClose != static_cast<Char>(']')) {
+            if (*pchClose == static_cast<Char>('/')) return nullptr;
+            ++pchClose;
+        }
+        if (pchClose == pchEnd) return nullptr;
+        ref.pinyin = MakeSpan(pch + 1, pchClose);
+        pch = pchClose + 1;
+    }
+    return pch;
+}
+
+} // namespace detail
+
+
+// Calls handler(reference) for each reference in the English field of an
+// entry, in order. The markers are looked for at the start of each word of
+// each gloss, in one pass over the field; a classifier list is comma
+// separated.
+template <typename Char, typename ReferenceHandler>
+void ForEachCrossReference(const TextSpan<Char>& english, ReferenceHandler handler)
+{
+    const Char* pchEnd = english.pchEnd;
+    for (const Char* pch = english.pchBegin; pch < pchEnd; ++pch) {
+        // Most characters start no marker; the test is cheapest that way.
+        UINT32 u = static_cast<UINT32>(*pch);
+        if (u != 'C' && u != 'v' && u != 's') continue;
+        if (pch > english.pchBegin) {
+            UINT32 uPrevious = static_cast<UINT32>(pch[-1]);
+            if (uPrevious != ' ' && uPrevious != '(' && uPrevious != '/') continue;
+        }
+
+        CrossReference<Char> ref;
+        const Char* pchRef;
+        if (detail::StartsWith(pch, pchEnd, "CL:")) {
+            ref.kind = kClassifierReference;
+            pchRef = pch + 3;
+        } else if (detail::StartsWith(pch, pchEnd, "variant of ")) {
+            ref.kind = kVariantReference;
+            pchRef = pch + 11;
+        } else if (detail::StartsWith(pch, pchEnd, "see also ")) {
+            ref.kind = kSeeReference;
+            pchRef = pch + 9;
+        } else if (detail::StartsWith(pch, pchEnd, "see ")) {
+            ref.kind = kSeeReference;
+            pchRef = pch + 4;
+        } else {
+            continue;
+        }
+        while (const Char* pchNext = detail::ParseCrossReference(pchRef, pchEnd, ref)) {
+            handler(ref);
+            pch = pchNext - 1;
+            if (pchNext == pchEnd || *pchNext != static_cast<Char>(',')) break;
+            pchRef = pchNext + 1;
+            while (pchRef < pchEnd && *pchRef == static_cast<Char>(' ')) ++pchRef;
+        }
+    }
+}
+
+
+template <typename Char>
+class CrossReferenceGraph
+{
+public:
+    typedef TextSpan<Char> Key;
+
+    CrossReferenceGraph() : m_cReferences(0), m_cUnresolved(0) {}
+
+    // trad[i] and pinyin[i] are the traditional headword and the pinyin of
+    // entry i, and text(i, buffer) its English glosses, as for
+    // FuzzyGlossIndex::Build(). fToneMarks tells that the pinyin of the
+    // entries has tone marks (DictionaryOptions::pinyinToneMarks), so that
+    // the tone numbers of the references are converted to compare them.
+    // With a scheduler, the glosses of pieces of the entries are parsed and
+    // resolved in parallel, and text() must be safe to call from several
+    // threads.
+    template <typename TextFunction>
+    void Build(const std::vector<Key>& trad, const std::vector<Key>& pinyin, TextFunction text,
+        bool fToneMarks, TaskScheduler* pScheduler = nullptr);
+
+    // The links of entry id, linked entry and kind in each (see
+    // LinkedEntry() and LinkKind()), ordered by kind, then by entry id.
+    // The graph must have been built.
+    const UINT32* LinksBegin(UINT32 id) const { return m_links.data() + m_linkStarts[id]; }
+    const UINT32* LinksEnd(UINT32 id) const { return m_links.data() + m_linkStarts[id + 1]; }
+
+    // The links to entry id from the entries that refer to it, the same way.
+    const UINT32* BacklinksBegin(UINT32 id) const { return m_backlinks.data() + m_backlinkStarts[id]; }
+    const UINT32* BacklinksEnd(UINT32 id) const { return m_backlinks.data() + m_backlinkStarts[id + 1]; }
+
+    static UINT32 LinkedEntry(UINT32 link) { return link & kLinkEntryMask; }
+    static CrossReferenceKind LinkKind(UINT32 link)
+    {
+        return static_cast<CrossReferenceKind>(link >> kLinkKindShift);
+    }
+
+    size_t LinkCount() const { return m_links.size(); }
+    size_t ReferenceCount() const { return m_cReferences; }
+
+    // References to a headword that no entry has.
+    size_t UnresolvedCount() const { return m_cUnresolved; }
+
+    bool Empty() const { return m_linkStarts.empty(); }
+
+    // Memory held by the graph.
+    size_t Bytes() const
+    {
+        return (m_linkStarts.capacity() + m_links.capacity() + m_backlinkStarts.capacity()
+            + m_backlinks.capacity()) * sizeof(UINT32);
+    }
+
+    static const int kLinkKindShift = 30;
+    static const UINT32 kLinkEntryMask = (1u << kLinkKindShift) - 1;
+    static const size_t kMinPiece = 4096;   // entries per task of Build()
+
+private:
+    std::vector<UINT32> m_linkStarts;       // entry count + 1 offsets into m_links
+    std::vector<UINT32> m_links;            // kind << kLinkKindShift | linked entry id
+    std::vector<UINT32> m_backlinkStarts;
+    std::vector<UINT32> m_backlinks;        // kind << kLinkKindShift | referring entry id
+    size_t m_cReferences;
+    size_t m_cUnresolved;
+};
+
+
+template <typename Char> const int CrossReferenceGraph<Char>::kLinkKindShift;
+template <typename Char> const UINT32 CrossReferenceGraph<Char>::kLinkEntryMask;
+template <typename Char> const size_t CrossReferenceGraph<Char>::kMinPiece;
+
+
+template <typename Char>
+template <typename TextFunction>
+void CrossReferenceGraph<Char>::Build(const std::vector<Key>& trad, const std::vector<Key>& pinyin,
+    TextFunction text, bool fToneMarks, TaskScheduler* pScheduler)
+{
+    const size_t cEntries = trad.size();
+
+    // The references name headwords, which are looked up in an index of
+    // the graph's own, freed once they are resolved.
+    TraceScope traceIndex("index headwords");
+    HeadwordIndex<Char> index;
+    index.Build(trad, pScheduler);
+    traceIndex.End();
+
+    // Each piece lists the links of its entries, in entry order, and how
+    // many each entry has.
+    struct Piece
+    {
+        std::vector<UINT32> counts;
+        std::vector<UINT32> links;
+        size_t cReferences;
+        size_t cUnresolved;
+    };
+    const size_t cPieces = PieceCount(pScheduler, cEntries, kMinPiece);
+    std::vector<Piece> pieces(cPieces);
+    ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+        TraceScope trace("resolve references");
+        std::vector<Char> buffer;
+        std::vector<Char> converted;
+        std::vector<UINT32> entryLinks;
+        for (size_t k = kBegin; k < kEnd; ++k) {
+            Piece& piece = pieces[k];
+            piece.cReferences = piece.cUnresolved = 0;
+            const size_t iEnd = PieceStart(cEntries, cPieces, k + 1);
+            for (size_t i = PieceStart(cEntries, cPieces, k); i < iEnd; ++i) {
+                entryLinks.clear();
+                ForEachCrossReference(text(i, buffer), [&](const CrossReference<Char>& ref) {
+                    piece.cReferences++;
+                    Key refPinyin = ref.pinyin;
+                    if (fToneMarks && refPinyin.Length() > 0) {
+                        converted.resize(refPinyin.Length());
+                        Char* pchConverted = converted.data();
+                        size_t cch = ConvertPinyin(refPinyin.pchBegin, refPinyin.pchEnd, pchConverted);
+                        refPinyin = MakeSpan(pchConverted, pchConverted + cch);
+                    }
+                    // The entries of the headword with that pinyin, else all
+                    // of them.
+                    UINT32 first = index.Find(ref.trad);
+                    if (first == kNoEntry) {
+                        piece.cUnresolved++;
+                        return;
+                    }
+                    bool fPinyinMatch = false;
+                    if (refPinyin.Length() > 0) {
+                        for (UINT32 id = first; id != kNoEntry && !fPinyinMatch; id = index.Next(id)) {
+                            fPinyinMatch = pinyin[id] == refPinyin;
+                        }
+                    }
+                    const UINT32 kind = static_cast<UINT32>(ref.kind) << kLinkKindShift;
+                    for (UINT32 id = first; id != kNoEntry; id = index.Next(id)) {
+                        if (id != i && (!fPinyinMatch || pinyin[id] == refPinyin)) {
+                            entryLinks.push_back(kind | id);
+                        }
+                    }
+                });
+                std::sort(entryLinks.begin(), entryLinks.end());
+                entryLinks.erase(std::unique(entryLinks.begin(), entryLinks.end()), entryLinks.end());
+                piece.counts.push_back(static_cast<UINT32>(entryLinks.size()));
+                piece.links.insert(piece.links.end(), entryLinks.begin(), entryLinks.end());
+            }
+        }
+    });
+
+    // The rows are the links of the pieces end to end.
+    TraceScope traceRows("lay out links");
+    m_cReferences = m_cUnresolved = 0;
+    m_linkStarts.resize(cEntries + 1);
+    m_linkStarts[0] = 0;
+    for (size_t k = 0, i = 0; k < cPieces; ++k) {
+        for (UINT32 count : pieces[k].counts) {
+            m_linkStarts[i + 1] = m_linkStarts[i] + count;
+            ++i;
+        }
+        m_cReferences += pieces[k].cReferences;
+        m_cUnresolved += pieces[k].cUnresolved;
+    }
+    m_links.resize(m_linkStarts[cEntries]);
+    ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+        for (size_t k = kBegin; k < kEnd; ++k) {
+            std::copy(pieces[k].links.begin(), pieces[k].links.end(),
+                m_links.begin() + m_linkStarts[PieceStart(cEntries, cPieces, k)]);
+        }
+    });
+
+    // The reverse links by a counting sort on the linked entries: the
+    // entries that refer to each one come in ascending order.
+    m_backlinkStarts.assign(cEntries + 1, 0);
+    for (UINT32 link : m_links) m_backlinkStarts[LinkedEntry(link) + 1]++;
+    for (size_t i = 0; i < cEntries; ++i) m_backlinkStarts[i + 1] += m_backlinkStarts[i];
+    m_backlinks.resize(m_links.size());
+    std::vector<UINT32> next(m_backlinkStarts.begin(), m_backlinkStarts.end() - 1);
+    for (UINT32 i = 0; i < cEntries; ++i) {
+        for (UINT32 l = m_linkStarts[i]; l < m_linkStarts[i + 1]; ++l) {
+            UINT32 link = m_links[l];
+            m_backlinks[next[LinkedEntry(link)]++] = (link & ~kLinkEntryMask) | i;
+        }
+    }
+}
+
+
+} // namespace cedict
@@ -0,0 +1,685 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Dictionary.h -- Policy-based loader for the CEDICT Chinese/English
+//                 dictionary.
+//
+// The loader variants of the original blog series differ in how the file is
+// read, how UTF-8 is converted and how the strings are stored. Each of these
+// dimensions is a template parameter here (see InputPolicies.h,
+// TranscodePolicies.h and StoragePolicies.h), while line splitting, comment
+// skipping and parsing are shared by all the variants.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <xmmintrin.h>  // for _mm_prefetch
+#include <algorithm>
+#include <cstring>      // for memchr
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "CompressedGlossStore.h"
+#include "CrossReferenceGraph.h"
+#include "DictionaryOptions.h"
+#include "FieldIndex.h"
+#include "FuzzyGlossIndex.h"
+#include "FuzzyPinyinIndex.h"
+#include "HeadwordFilter.h"
+#include "HeadwordIndex.h"
+#include "LargePages.h"
+#include "LoadTrace.h"
+#include "Pinyin.h"
+#include "ScriptConverter.h"
+#include "SortedHeadwordIndex.h"
+#include "TaskScheduler.h"
+#include "TextScan.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+//------------------------------------------------------------------------------
+// The fields found by ParseEntry() in a dictionary line:
+//
+//     Traditional Simplified [pin1 yin1] /English 1/English 2/
+//------------------------------------------------------------------------------
+template <typename Char>
+struct EntryFields
+{
+    TextSpan<Char> trad;
+    TextSpan<Char> simp;
+    TextSpan<Char> pinyin;
+    TextSpan<Char> english;
+};
+
+
+//------------------------------------------------------------------------------
+// Split a (transcoded) dictionary line in its fields.
+// The spans point into [begin, end); returns false if the line is malformed.
+//------------------------------------------------------------------------------
+template <typename Char>
+bool ParseEntry(const Char* begin, const Char* end, EntryFields<Char>& fields)
+{
+    const Char* pch = std::find(begin, end, static_cast<Char>(' '));
+    if (pch >= end) return false;
+    fields.trad.pchBegin = begin;
+    fields.trad.pchEnd = pch;
+    begin = pch + 1;
+    pch = std::find(begin, end, static_cast<Char>('['));
+    if (pch >= end) return false;
+    fields.simp.pchBegin = begin;
+    for (fields.simp.pchEnd = pch; fields.simp.pchEnd > begin
+        && fields.simp.pchEnd[-1] == static_cast<Char>(' '); --fields.simp.pchEnd) {}
+    begin = pch + 1;
+    pch = std::find(begin, end, static_cast<Char>(']'));
+    if (pch >= end) return false;
+    fields.pinyin.pchBegin = begin;
+    fields.pinyin.pchEnd = pch;
+    pch = std::find(pch, end, static_cast<Char>('/'));
+    if (pch >= end) return false;
+    begin = pch + 1;
+    for (pch = end; *--pch != static_cast<Char>('/'); ) {}
+    if (begin >= pch) return false;
+    fields.english.pchBegin = begin;
+    fields.english.pchEnd = pch;
+    return true;
+}
+
+
+// What ReadEntryLine() found in a line of the file.
+enum LineKind
+{
+    kBlankOrCommentLine,
+    kEntryLine,
+    kInvalidUtf8Line,
+    kUnparsableLine,
+};
+
+
+//------------------------------------------------------------------------------
+// Transcode a line of the file (UTF-8, without its '\n') into buf, grown as
+// needed, and split it in its fields, which then point into buf.
+//------------------------------------------------------------------------------
+template <typename TranscodePolicy>
+LineKind ReadEntryLine(TranscodePolicy& transcoder, const CHAR* pchBegin, const CHAR* pchEnd,
+    std::vector<typename TranscodePolicy::CharType>& buf,
+    EntryFields<typename TranscodePolicy::CharType>& fields)
+{
+    typedef typename TranscodePolicy::CharType Char;
+
+    if (pchBegin == pchEnd || *pchBegin == '#') return kBlankOrCommentLine;
+
+    // The C-style string storages cannot hold a null character: no variant
+    // takes such a line, so that they all load the same entries.
+    if (memchr(pchBegin, 0, pchEnd - pchBegin)) return kUnparsableLine;
+
+    size_t cchBuf = pchEnd - pchBegin;
+    if (buf.size() < cchBuf) buf.resize(cchBuf);
+
+    TraceScope traceTranscode("transcode");
+    size_t cchResult = transcoder.Transcode(pchBegin, pchEnd, &buf[0]);
+    traceTranscode.End();
+    if (!cchResult) return kInvalidUtf8Line;
+
+    TraceScope traceParse("parse");
+    const Char* pchLine = &buf[0];
+    return ParseEntry(pchLine, pchLine + cchResult, fields) ? kEntryLine : kUnparsableLine;
+}
+
+
+template <typename String>
+struct DictionaryEntry
+{
+    DictionaryEntry()
+        : trad()
+        , simp()
+        , pinyin()
+        , english()
+    {}
+
+    String trad;
+    String simp;
+    String pinyin;
+    String english;
+};
+
+
+struct LoadStatistics
+{
+    LoadStatistics()
+        : cEntryReallocations(0), cStorageChunks(0), cLargePageChunks(0)
+        , cInvalidUtf8Lines(0), cUnparsableLines(0), fRejected(false)
+    {}
+
+    size_t cEntryReallocations; // times the entry vector grew while loading
+    size_t cStorageChunks;      // chunks allocated by the storage policy
+    size_t cLargePageChunks;    // ... of which backed by large pages
+    size_t cInvalidUtf8Lines;   // lines skipped as they are not valid UTF-8
+    size_t cUnparsableLines;    // lines skipped as they are not entries
+    bool fRejected;             // validateUtf8 found invalid lines: nothing loaded
+};
+
+
+// Memory held by a dictionary, in bytes (see Dictionary::MemoryUsage()).
+// Heap block headers are not included: they depend on the heap, and the
+// allocations are counted by the benchmark instead.
+struct MemoryBreakdown
+{
+    MemoryBreakdown()
+        : cbEntries(0), cbEntrySlack(0), cbStrings(0), cbStringSlack(0), cbPoolWaste(0)
+        , cbGlosses(0), cbIndexes(0), cbScriptConverters(0), cbBuffers(0)
+    {}
+
+    size_t Total() const
+    {
+        return cbEntries + cbEntrySlack + cbStrings + cbStringSlack + cbPoolWaste
+            + cbGlosses + cbIndexes + cbScriptConverters + cbBuffers;
+    }
+
+    size_t cbEntries;           // the entries, strings stored in them included
+    size_t cbEntrySlack;        // unused capacity of the entry vector
+    size_t cbStrings;           // characters and terminators stored out of the entries
+    size_t cbStringSlack;       // rest of the per-string allocations (capacity, headers)
+    size_t cbPoolWaste;         // storage chunk bytes that hold no string
+    size_t cbGlosses;           // compressed English glosses
+    size_t cbIndexes;           // indexes, headword filter, cross references
+    size_t cbScriptConverters;  // traditional <-> simplified tables
+    size_t cbBuffers;           // line buffers and malformed lines kept from loading
+};
+
+
+// A line of the file that did not make it into the dictionary.
+struct MalformedLine
+{
+    enum Reason { InvalidUtf8, Unparsable };
+
+    MalformedLine(size_t ibOffset_, size_t iLine_, Reason reason_)
+        : ibOffset(ibOffset_), iLine(iLine_), reason(reason_)
+    {}
+
+    size_t ibOffset;    // byte offset of the line in the file
+    size_t iLine;       // line number, starting from 1
+    Reason reason;
+};
+
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+class Dictionary
+{
+public:
+    typedef typename TranscodePolicy::CharType CharType;
+    typedef typename StoragePolicy::String String;
+    typedef DictionaryEntry<String> Entry;
+    typedef std::vector<Entry, PageAllocator<Entry>> EntryVector;
+
+    static_assert(std::is_same<CharType, typename StoragePolicy::CharType>::value,
+        "The transcoder must produce the character type of the storage policy");
+
+    // Whether each character of the headwords and tone marks fits in one
+    // code unit, as the pinyin conversion and the script converters need;
+    // not with UTF-8, which ignores those options.
+    static const bool kWholeCharacters = sizeof(CharType) > 1;
+
+    explicit Dictionary(LPCTSTR pszFile = TEXT("cedict.u8"),
+        const DictionaryOptions& options = DictionaryOptions());
+    ~Dictionary();
+    int Length() const { return static_cast<int>(v.size()); }
+    const Entry& Item(int i) const { return v[i]; }
+    const LoadStatistics& Statistics() const { return m_stats; }
+
+    // Where the memory of the dictionary goes. Walks all the strings.
+    MemoryBreakdown MemoryUsage() const;
+
+    // Lines skipped while loading, in file order (see also Statistics()).
+    const std::vector<MalformedLine>& MalformedLines() const { return m_malformed; }
+
+    static TextSpan<CharType> View(const String& s) { return StoragePolicy::View(s); }
+
+    // Build what options asks for after loading: the indexes, the filter
+    // and the script converters, as tasks on DictionaryOptions::buildThreads
+    // threads (see TaskScheduler.h). Done by the constructor.
+    //
+    // Each Build method below can also be called on its own, later. Given a
+    // scheduler, it splits its work into tasks on the threads of the
+    // scheduler; without one, it runs on the calling thread alone.
+    void BuildIndexes(const DictionaryOptions& options);
+
+    // Index the entries by traditional headword.
+    // Done by the constructor if DictionaryOptions::buildIndex is set.
+    void BuildIndex(TaskScheduler* pScheduler = nullptr);
+
+    // Id of the first entry with the given traditional headword, or kNoEntry
+    // (also if the index was not built). Index().Next() gives the others.
+    // With the headword filter, most keys that are not headwords are
+    // rejected without probing the index.
+    UINT32 Find(const CharType* pchBegin, const CharType* pchEnd) const
+    {
+        TextSpan<CharType> key = MakeSpan(pchBegin, pchEnd);
+        if (m_filter.Empty()) return m_index.Find(key);
+        UINT32 hash = HashSpan(key);
+        if (!m_filter.MayContain(hash)) return kNoEntry;
+        return m_index.Find(key, hash);
+    }
+
+    // Build the Bloom filter over the hashes of the traditional headwords
+    // (see HeadwordFilter.h) that Find() checks first. Done by the
+    // constructor if DictionaryOptions::headwordFilter is set.
+    void BuildHeadwordFilter(TaskScheduler* pScheduler = nullptr);
+
+    const HeadwordFilter& Filter() const { return m_filter; }
+
+    // Find() for count headwords at once (see HeadwordIndex::FindBatch).
+    // The records of the entries found are prefetched as well, for the
+    // caller to read next.
+    void FindBatch(const TextSpan<CharType>* keys, size_t count, UINT32* ids) const
+    {
+        m_index.FindBatch(keys, count, ids);
+        for (size_t i = 0; i < count; ++i) {
+            if (ids[i] != kNoEntry) {
+                _mm_prefetch(reinterpret_cast<const char*>(&v[ids[i]]), _MM_HINT_T0);
+            }
+        }
+    }
+
+    const HeadwordIndex<CharType>& Index() const { return m_index; }
+
+    // Order the entries by traditional headword, for lower bound, range and
+    // nearest-key queries (see SortedHeadwordIndex.h). Done by the
+    // constructor if DictionaryOptions::buildSortedIndex is set.
+    void BuildSortedIndex(TaskScheduler* pScheduler = nullptr);
+
+    const SortedHeadwordIndex<CharType>& SortedIndex() const { return m_sortedIndex; }
+
+    // The same, by pinyin as stored (tone numbers or marks). Done by the
+    // constructor if DictionaryOptions::buildSortedPinyinIndex is set.
+    void BuildSortedPinyinIndex(TaskScheduler* pScheduler = nullptr);
+
+    const SortedHeadwordIndex<CharType>& SortedPinyinIndex() const { return m_sortedPinyinIndex; }
+
+    // Index the entries by simplified headword, by pinyin and by English
+    // gloss (see FieldIndex.h). Done by the constructor if
+    // DictionaryOptions::buildFieldIndexes is set. Compressed glosses are
+    // decoded one entry at a time, so they are not indexed.
+    void BuildFieldIndexes(TaskScheduler* pScheduler = nullptr);
+
+    const FieldIndex<CharType>& SimplifiedIndex() const { return m_simpIndex; }
+    const FieldIndex<CharType>& PinyinIndex() const { return m_pinyinIndex; }
+    const FieldIndex<CharType>& EnglishIndex() const { return m_englishIndex; }
+
+    // Index the words of the English glosses for fuzzy search (see
+    // FuzzyGlossIndex.h). Done by the constructor if
+    // DictionaryOptions::buildFuzzyGlossIndex is set. The index keeps its
+    // own copy of the words, so compressed glosses are indexed too.
+    void BuildFuzzyGlossIndex(TaskScheduler* pScheduler = nullptr);
+
+    const FuzzyGlossIndex<CharType>& FuzzyEnglish() const { return m_fuzzyEnglishIndex; }
+
+    // Spell the pinyin of the entries for fuzzy search (see
+    // FuzzyPinyinIndex.h). Done by the constructor if
+    // DictionaryOptions::buildFuzzyPinyinIndex is set.
+    void BuildFuzzyPinyinIndex(TaskScheduler* pScheduler = nullptr);
+
+    const FuzzyPinyinIndex<CharType>& FuzzyPinyin() const { return m_fuzzyPinyinIndex; }
+
+    // Resolve the references of the glosses to other entries into links
+    // (see CrossReferenceGraph.h). Done by the constructor if
+    // DictionaryOptions::buildCrossReferences is set. Compressed glosses
+    // are decoded for it.
+    void BuildCrossReferences(TaskScheduler* pScheduler = nullptr);
+
+    const CrossReferenceGraph<CharType>& CrossReferences() const { return m_crossReferences; }
+
+    // Learn the traditional <-> simplified conversion from the headwords.
+    // Done by the constructor if DictionaryOptions::buildScriptConverters
+    // is set; until then, the converters are empty. Does nothing unless
+    // kWholeCharacters.
+    void BuildScriptConverters(TaskScheduler* pScheduler = nullptr);
+
+    const ScriptConverter<CharType>& TradToSimp() const { return m_tradToSimp; }
+    const ScriptConverter<CharType>& SimpToTrad() const { return m_simpToTrad; }
+
+    // English glosses of entry i. When they are compressed
+    // (DictionaryOptions::compressGlosses), they are decoded into pchBuf,
+    // which must hold EnglishBufferLength() characters; otherwise pchBuf
+    // is not used and the stored string is returned.
+    TextSpan<CharType> English(int i, CharType* pchBuf) const
+    {
+        if (!m_fCompressGlosses) return View(v[i].english);
+        return MakeSpan(pchBuf, pchBuf + m_glosses.Decode(i, pchBuf));
+    }
+
+    size_t EnglishBufferLength() const { return m_glosses.BufferLength(); }
+
+    bool HasCompressedGlosses() const { return m_fCompressGlosses; }
+    const CompressedGlossStore<CharType>& Glosses() const { return m_glosses; }
+
+private:
+    Dictionary(const Dictionary&) = delete;
+    Dictionary& operator=(const Dictionary&) = delete;
+
+    void AddLine(const CHAR* pchBegin, const CHAR* pchEnd, size_t ibOffset, size_t iLine);
+
+    // BuildScriptConverters(), chosen by kWholeCharacters.
+    void BuildScriptConverters(TaskScheduler* pScheduler, std::true_type);
+    void BuildScriptConverters(TaskScheduler*, std::false_type) {}
+
+    // Entries per task when the builds split the entries.
+    static const size_t kBuildPiece = 4096;
+
+    // Spans of a field of all the entries (e.g. &Entry::trad), in id order.
+    std::vector<TextSpan<CharType>> Spans(String Entry::*field, TaskScheduler* pScheduler) const;
+
+    // The English field of entry i, decoded into buf if the glosses are
+    // compressed: the text() of the builds that read the glosses.
+    auto EnglishText() const
+    {
+        return [this](size_t i, std::vector<CharType>& buf) {
+            buf.resize(EnglishBufferLength() + 1);
+            return English(static_cast<int>(i), buf.data());
+        };
+    }
+
+    EntryVector v;
+    std::vector<CharType> m_buf;    // transcoding buffer, reused for each line
+    std::vector<CharType> m_pinyinBuf;
+    bool m_fPinyinToneMarks;
+    TranscodePolicy m_transcoder;
+    StoragePolicy m_storage;
+    HeadwordIndex<CharType> m_index;
+    HeadwordFilter m_filter;
+    SortedHeadwordIndex<CharType> m_sortedIndex;
+    SortedHeadwordIndex<CharType> m_sortedPinyinIndex;
+    FieldIndex<CharType> m_simpIndex;
+    FieldIndex<CharType> m_pinyinIndex;
+    FieldIndex<CharType> m_englishIndex;
+    FuzzyGlossIndex<CharType> m_fuzzyEnglishIndex;
+    FuzzyPinyinIndex<CharType> m_fuzzyPinyinIndex;
+    CrossReferenceGraph<CharType> m_crossReferences;
+    ScriptConverter<CharType> m_tradToSimp;
+    ScriptConverter<CharType> m_simpToTrad;
+    CompressedGlossStore<CharType> m_glosses;
+    bool m_fCompressGlosses;
+    LoadStatistics m_stats;
+    std::vector<MalformedLine> m_malformed;
+};
+
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::Dictionary(
+    LPCTSTR pszFile, const DictionaryOptions& options)
+    : v(PageAllocator<Entry>(options.largePages))
+    , m_fPinyinToneMarks(options.pinyinToneMarks && kWholeCharacters)
+    , m_storage(options)
+    , m_fCompressGlosses(options.compressGlosses)
+{
+    TraceScope traceLoad("load");
+    TraceScope traceOpen("open");
+    InputPolicy input(pszFile);
+    traceOpen.End();
+
+    if (options.validateUtf8) {
+        TraceScope trace("validate UTF-8");
+        input.ValidateUtf8([this](size_t ibOffset, size_t iLine) {
+            m_malformed.push_back(MalformedLine(ibOffset, iLine, MalformedLine::InvalidUtf8));
+        });
+        if (!m_malformed.empty()) {
+            m_stats.cInvalidUtf8Lines = m_malformed.size();
+            m_stats.fRejected = true;
+            return;
+        }
+    }
+
+    TextScanResult scan;
+    if (options.presize) {
+        TraceScope trace("scan");
+        if (input.Scan(scan)) {
+            v.reserve(scan.cLines - scan.cCommentLines);
+            m_storage.Reserve(scan.TranscodedLength<CharType>());
+        }
+    }
+
+    TraceScope traceLines("lines");
+    size_t ibOffset = 0;
+    size_t iLine = 1;
+    input.ForEachLine([this, &ibOffset, &iLine](const CHAR* pchBegin, const CHAR* pchEnd) {
+        AddLine(pchBegin, pchEnd, ibOffset, iLine);
+        ibOffset += (pchEnd - pchBegin) + 1;
+        iLine++;
+    });
+    traceLines.End();
+    if (m_fCompressGlosses) {
+        TraceScope trace("compress glosses");
+        m_glosses.Compress();
+    }
+    m_stats.cStorageChunks = m_storage.ChunkCount();
+    m_stats.cLargePageChunks = m_storage.LargePageChunkCount();
+
+    BuildIndexes(options);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::~Dictionary()
+{
+    for (auto i = v.begin(); i != v.end(); ++i) {
+        m_storage.Free(i->trad);
+        m_storage.Free(i->simp);
+        m_storage.Free(i->pinyin);
+        m_storage.Free(i->english);
+    }
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+MemoryBreakdown Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::MemoryUsage() const
+{
+    MemoryBreakdown mb;
+    mb.cbEntries = v.size() * sizeof(Entry);
+    mb.cbEntrySlack = (v.capacity() - v.size()) * sizeof(Entry);
+    for (auto i = v.begin(); i != v.end(); ++i) {
+        StoragePolicy::CountBytes(i->trad, &mb.cbStrings, &mb.cbStringSlack);
+        StoragePolicy::CountBytes(i->simp, &mb.cbStrings, &mb.cbStringSlack);
+        StoragePolicy::CountBytes(i->pinyin, &mb.cbStrings, &mb.cbStringSlack);
+        StoragePolicy::CountBytes(i->english, &mb.cbStrings, &mb.cbStringSlack);
+    }
+    size_t cbChunks = m_storage.ChunkBytes();
+    if (cbChunks > mb.cbStrings) mb.cbPoolWaste = cbChunks - mb.cbStrings;
+    if (m_fCompressGlosses) mb.cbGlosses = m_glosses.Bytes();
+    mb.cbIndexes = m_index.Bytes() + m_filter.Bytes() + m_sortedIndex.Bytes() + m_sortedPinyinIndex.Bytes()
+        + m_simpIndex.Bytes() + m_pinyinIndex.Bytes() + m_englishIndex.Bytes()
+        + m_fuzzyEnglishIndex.Bytes() + m_fuzzyPinyinIndex.Bytes() + m_crossReferences.Bytes();
+    mb.cbScriptConverters = m_tradToSimp.Bytes() + m_simpToTrad.Bytes();
+    mb.cbBuffers = (m_buf.capacity() + m_pinyinBuf.capacity()) * sizeof(CharType)
+        + m_malformed.capacity() * sizeof(MalformedLine);
+    return mb;
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildIndexes(const DictionaryOptions& options)
+{
+    // The structures are independent of each other: they are built at the
+    // same time, each splitting its own work further. With one thread, no
+    // worker is started, and they are built one after the other by Wait().
+    TaskScheduler scheduler(options.buildThreads);
+    TaskScheduler* pScheduler = &scheduler;
+    TaskGroup group;
+    if (options.buildIndex) scheduler.Spawn(group, [=]() { BuildIndex(pScheduler); });
+    if (options.headwordFilter) scheduler.Spawn(group, [=]() { BuildHeadwordFilter(pScheduler); });
+    if (options.buildSortedIndex) scheduler.Spawn(group, [=]() { BuildSortedIndex(pScheduler); });
+    if (options.buildSortedPinyinIndex) scheduler.Spawn(group, [=]() { BuildSortedPinyinIndex(pScheduler); });
+    if (options.buildScriptConverters) scheduler.Spawn(group, [=]() { BuildScriptConverters(pScheduler); });
+    if (options.buildFieldIndexes) scheduler.Spawn(group, [=]() { BuildFieldIndexes(pScheduler); });
+    if (options.buildFuzzyGlossIndex) scheduler.Spawn(group, [=]() { BuildFuzzyGlossIndex(pScheduler); });
+    if (options.buildFuzzyPinyinIndex) scheduler.Spawn(group, [=]() { BuildFuzzyPinyinIndex(pScheduler); });
+    if (options.buildCrossReferences) scheduler.Spawn(group, [=]() { BuildCrossReferences(pScheduler); });
+    scheduler.Wait(group);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+std::vector<TextSpan<typename Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::CharType>>
+Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::Spans(String Entry::*field, TaskScheduler* pScheduler) const
+{
+    std::vector<TextSpan<CharType>> spans(v.size());
+    ParallelFor(pScheduler, 0, v.size(), kBuildPiece, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) spans[i] = View(v[i].*field);
+    });
+    return spans;
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildIndex(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build index");
+    m_index.Build(Spans(&Entry::trad, pScheduler), pScheduler);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildSortedIndex(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build sorted index");
+    m_sortedIndex.Build(Spans(&Entry::trad, pScheduler), pScheduler);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildSortedPinyinIndex(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build sorted pinyin index");
+    m_sortedPinyinIndex.Build(Spans(&Entry::pinyin, pScheduler), pScheduler);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildFieldIndexes(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build field indexes");
+    std::vector<UINT32> ids(v.size());
+    for (size_t i = 0; i < ids.size(); ++i) ids[i] = static_cast<UINT32>(i);
+    ParallelInvoke(pScheduler,
+        [&]() { m_simpIndex.Build(Spans(&Entry::simp, pScheduler), ids, pScheduler); },
+        [&]() { m_pinyinIndex.Build(Spans(&Entry::pinyin, pScheduler), ids, pScheduler); });
+
+    if (m_fCompressGlosses) return;
+    // The glosses of pieces of the entries are split in parallel, then put
+    // end to end, so that the postings are in entry order.
+    TraceScope traceGlosses("split glosses");
+    const size_t cPieces = PieceCount(pScheduler, v.size(), kBuildPiece);
+    std::vector<std::vector<TextSpan<CharType>>> pieceGlosses(cPieces);
+    std::vector<std::vector<UINT32>> pieceIds(cPieces);
+    ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+        for (size_t k = kBegin; k < kEnd; ++k) {
+            for (size_t i = PieceStart(v.size(), cPieces, k); i < PieceStart(v.size(), cPieces, k + 1); ++i) {
+                ForEachGloss(View(v[i].english), [&](const CharType* pchBegin, const CharType* pchEnd) {
+                    pieceGlosses[k].push_back(MakeSpan(pchBegin, pchEnd));
+                    pieceIds[k].push_back(static_cast<UINT32>(i));
+                });
+            }
+        }
+    });
+    std::vector<TextSpan<CharType>> glosses;
+    std::vector<UINT32> glossIds;
+    for (size_t k = 0; k < cPieces; ++k) {
+        glosses.insert(glosses.end(), pieceGlosses[k].begin(), pieceGlosses[k].end());
+        glossIds.insert(glossIds.end(), pieceIds[k].begin(), pieceIds[k].end());
+    }
+    traceGlosses.End();
+    m_englishIndex.Build(std::move(glosses), std::move(glossIds), pScheduler);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildFuzzyGlossIndex(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build fuzzy gloss index");
+    m_fuzzyEnglishIndex.Build(v.size(), EnglishText(), pScheduler);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildFuzzyPinyinIndex(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build fuzzy pinyin index");
+    m_fuzzyPinyinIndex.Build(v.size(), [this](size_t i) { return View(v[i].pinyin); }, pScheduler);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildCrossReferences(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build cross references");
+    m_crossReferences.Build(Spans(&Entry::trad, pScheduler), Spans(&Entry::pinyin, pScheduler),
+        EnglishText(), m_fPinyinToneMarks, pScheduler);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildHeadwordFilter(TaskScheduler* pScheduler)
+{
+    TraceScope trace("build headword filter");
+    std::vector<UINT32> hashes(v.size());
+    ParallelFor(pScheduler, 0, v.size(), kBuildPiece, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) hashes[i] = HashSpan(View(v[i].trad));
+    });
+    m_filter.Build(hashes);
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildScriptConverters(TaskScheduler* pScheduler)
+{
+    BuildScriptConverters(pScheduler, std::integral_constant<bool, kWholeCharacters>());
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::BuildScriptConverters(
+    TaskScheduler* pScheduler, std::true_type)
+{
+    TraceScope trace("build script converters");
+    std::vector<TextSpan<CharType>> trad = Spans(&Entry::trad, pScheduler);
+    std::vector<TextSpan<CharType>> simp = Spans(&Entry::simp, pScheduler);
+    ParallelInvoke(pScheduler,
+        [&]() { m_tradToSimp.Build(trad, simp); },
+        [&]() { m_simpToTrad.Build(simp, trad); });
+}
+
+template <typename InputPolicy, typename TranscodePolicy, typename StoragePolicy>
+void Dictionary<InputPolicy, TranscodePolicy, StoragePolicy>::AddLine(
+    const CHAR* pchBegin, const CHAR* pchEnd, size_t ibOffset, size_t iLine)
+{
+    EntryFields<CharType> fields;
+    switch (ReadEntryLine(m_transcoder, pchBegin, pchEnd, m_buf, fields)) {
+    case kEntryLine:
+        break;
+    case kBlankOrCommentLine:
+        return;
+    case kInvalidUtf8Line:
+        m_malformed.push_back(MalformedLine(ibOffset, iLine, MalformedLine::InvalidUtf8));
+        m_stats.cInvalidUtf8Lines++;
+        return;
+    case kUnparsableLine:
+        m_malformed.push_back(MalformedLine(ibOffset, iLine, MalformedLine::Unparsable));
+        m_stats.cUnparsableLines++;
+        return;
+    }
+
+    Entry de;
+    de.trad = m_storage.Alloc(fields.trad.pchBegin, fields.trad.pchEnd);
+    de.simp = m_storage.Alloc(fields.simp.pchBegin, fields.simp.pchEnd);
+    if (m_fPinyinToneMarks) {
+        if (m_pinyinBuf.size() < fields.pinyin.Length()) m_pinyinBuf.resize(fields.pinyin.Length());
+        size_t cch = ConvertPinyin(fields.pinyin.pchBegin, fields.pinyin.pchEnd, m_pinyinBuf.data());
+        de.pinyin = m_storage.Alloc(m_pinyinBuf.data(), m_pinyinBuf.data() + cch);
+    } else {
+        de.pinyin = m_storage.Alloc(fields.pinyin.pchBegin, fields.pinyin.pchEnd);
+    }
+    if (m_fCompressGlosses) {
+        m_glosses.Append(fields.english.pchBegin, fields.english.pchEnd);
+    } else {
+        de.english = m_storage.Alloc(fields.english.pchBegin, fields.english.pchEnd);
+    }
+    if (v.size() == v.capacity()) {
+        TraceScope trace("grow entries");
+        m_stats.cEntryReallocations++;
+        v.reserve(v.capacity() + v.capacity() / 2 + 1);     // the growth of push_back in VS2015
+    }
+    v.push_back(std::move(de));
+}
+
+
+} // namespace cedict
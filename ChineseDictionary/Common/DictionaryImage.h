@@ -0,0 +1,317 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// DictionaryImage.h -- Read-only image of a loaded dictionary in a named
+//                      shared memory section, for processes to attach to.
+//
+// Worker processes that each load the dictionary each pay the load time and
+// hold a private copy of the entries and strings. Instead, one process
+// loads it and builds its image in a section backed by the paging file;
+// the workers open the section by name and map it read-only, which takes
+// constant time, and the physical pages of the image are shared by all of
+// them.
+//
+// A section may be mapped at a different address in each process, so the
+// image holds no pointers: everything in it is an offset from its start.
+//
+//     ImageHeader
+//     UINT32 fields[4 * cEntries + 1]     field f of entry i is the characters
+//                                         [fields[4 * i + f], fields[4 * i + f + 1])
+//     ImageSlot slots[cSlots]             hash index of the traditional
+//     UINT32 next[cEntries]               headwords, as in HeadwordIndex.h
+//     Char chars[]                        the fields, one after the other
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <cstring>      // for memcpy
+#include <type_traits>
+#include <vector>
+#include "Dictionary.h"
+#include "HeadwordIndex.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+const UINT32 kImageMagic = 0x49444543;     // "CEDI"
+const UINT32 kImageVersion = 1;
+
+// Field order of the image offsets.
+enum ImageField { kImageTrad, kImageSimp, kImagePinyin, kImageEnglish, kImageFieldCount };
+
+struct ImageHeader
+{
+    UINT32 magic;       // written last, once the image is complete
+    UINT32 version;
+    UINT32 cbChar;      // sizeof(Char)
+    UINT32 cEntries;
+    UINT32 cSlots;      // a power of 2
+    UINT32 reserved;
+    UINT64 cbImage;
+    UINT64 ibFields;
+    UINT64 ibSlots;
+    UINT64 ibNext;
+    UINT64 ibChars;
+};
+
+struct ImageSlot
+{
+    UINT32 hash;
+    UINT32 id;          // kNoEntry for empty slots
+};
+
+
+template <typename Char>
+class DictionaryImage
+{
+public:
+    typedef TextSpan<Char> Key;
+
+    // Builds the image of dict in a new section named pszName (e.g.
+    // "Local\\cedict-image"), which lives as long as a process has it open.
+    // Fails if a section of that name already exists.
+    template <typename Dictionary>
+    DictionaryImage(const Dictionary& dict, LPCTSTR pszName);
+
+    // Attaches, read-only, to the image built under pszName by another
+    // process.
+    explicit DictionaryImage(LPCTSTR pszName);
+
+    ~DictionaryImage();
+
+    bool IsOpen() const { return m_pHeader != nullptr; }
+
+    int Length() const { return m_pHeader ? static_cast<int>(m_pHeader->cEntries) : 0; }
+
+    EntryFields<Char> Item(int i) const
+    {
+        const UINT32* ich = m_pFields + kImageFieldCount * i;
+        EntryFields<Char> fields;
+        fields.trad = MakeSpan(m_pChars + ich[kImageTrad], m_pChars + ich[kImageTrad + 1]);
+        fields.simp = MakeSpan(m_pChars + ich[kImageSimp], m_pChars + ich[kImageSimp + 1]);
+        fields.pinyin = MakeSpan(m_pChars + ich[kImagePinyin], m_pChars + ich[kImagePinyin + 1]);
+        fields.english = MakeSpan(m_pChars + ich[kImageEnglish], m_pChars + ich[kImageEnglish + 1]);
+        return fields;
+    }
+
+    // Id of the first entry with the given traditional headword, or kNoEntry.
+    UINT32 Find(const Key& key) const;
+
+    // Id of the next entry with the same headword as entry id, or kNoEntry.
+    UINT32 Next(UINT32 id) const { return m_pNext[id]; }
+
+    // Size of the section.
+    size_t Bytes() const { return m_pHeader ? static_cast<size_t>(m_pHeader->cbImage) : 0; }
+
+private:
+    DictionaryImage(const DictionaryImage&) = delete;
+    DictionaryImage& operator=(const DictionaryImage&) = delete;
+
+    Key Headword(UINT32 id) const
+    {
+        const UINT32* ich = m_pFields + kImageFieldCount * id;
+        return MakeSpan(m_pChars + ich[kImageTrad], m_pChars + ich[kImageTrad + 1]);
+    }
+
+    // Points the members into the view; false if it is not a complete image
+    // of this character type.
+    bool Attach(const BYTE* pbView, size_t cbView);
+    void SetView(const BYTE* pbView);
+    void Close();
+
+    HANDLE m_hSection;
+    const BYTE* m_pbView;
+    const ImageHeader* m_pHeader;
+    const UINT32* m_pFields;
+    const ImageSlot* m_pSlots;
+    const UINT32* m_pNext;
+    const Char* m_pChars;
+    UINT32 m_mask;
+};
+
+
+template <typename Char>
+template <typename Dictionary>
+DictionaryImage<Char>::DictionaryImage(const Dictionary& dict, LPCTSTR pszName)
+    : m_hSection(NULL), m_pbView(nullptr), m_pHeader(nullptr)
+{
+    static_assert(std::is_same<Char, typename Dictionary::CharType>::value,
+        "The image must have the character type of the dictionary");
+
+    const UINT32 cEntries = static_cast<UINT32>(dict.Length());
+    std::vector<Char> englishBuf(dict.EnglishBufferLength() + 1);
+
+    // Size the section: the characters first, as their offsets are 32-bit.
+    UINT64 cch = 0;
+    for (int i = 0; i < dict.Length(); ++i) {
+        const typename Dictionary::Entry& e = dict.Item(i);
+        cch += Dictionary::View(e.trad).Length() + Dictionary::View(e.simp).Length()
+            + Dictionary::View(e.pinyin).Length() + dict.English(i, englishBuf.data()).Length();
+    }
+    if (cch > 0xFFFFFFFF) return;
+
+    // Keep the load factor of the index at or below 50%.
+    UINT32 cSlots = 16;
+    while (cSlots < 2 * static_cast<UINT64>(cEntries)) cSlots *= 2;
+
+    ImageHeader header = {};
+    header.version = kImageVersion;
+    header.cbChar = sizeof(Char);
+    header.cEntries = cEntries;
+    header.cSlots = cSlots;
+    header.ibFields = sizeof(ImageHeader);
+    header.ibSlots = header.ibFields + (kImageFieldCount * static_cast<UINT64>(cEntries) + 1) * sizeof(UINT32);
+    header.ibNext = header.ibSlots + static_cast<UINT64>(cSlots) * sizeof(ImageSlot);
+    header.ibChars = header.ibNext + static_cast<UINT64>(cEntries) * sizeof(UINT32);
+    header.cbImage = header.ibChars + cch * sizeof(Char);
+
+    m_hSection = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        static_cast<DWORD>(header.cbImage >> 32), static_cast<DWORD>(header.cbImage), pszName);
+    if (m_hSection == NULL) return;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        Close();
+        return;
+    }
+    BYTE* pbView = static_cast<BYTE*>(MapViewOfFile(m_hSection, FILE_MAP_WRITE, 0, 0, 0));
+    if (!pbView) {
+        Close();
+        return;
+    }
+
+    UINT32* pFields = reinterpret_cast<UINT32*>(pbView + header.ibFields);
+    ImageSlot* pSlots = reinterpret_cast<ImageSlot*>(pbView + header.ibSlots);
+    UINT32* pNext = reinterpret_cast<UINT32*>(pbView + header.ibNext);
+    Char* pChars = reinterpret_cast<Char*>(pbView + header.ibChars);
+
+    UINT32 ich = 0;
+    auto append = [&](const TextSpan<Char>& field) {
+        *pFields++ = ich;
+        if (!field.Empty()) memcpy(pChars + ich, field.pchBegin, field.Length() * sizeof(Char));
+        ich += static_cast<UINT32>(field.Length());
+    };
+    for (int i = 0; i < dict.Length(); ++i) {
+        const typename Dictionary::Entry& e = dict.Item(i);
+        append(Dictionary::View(e.trad));
+        append(Dictionary::View(e.simp));
+        append(Dictionary::View(e.pinyin));
+        append(dict.English(i, englishBuf.data()));
+    }
+    *pFields = ich;
+
+    // The index, as HeadwordIndex::Build() does it.
+    const ImageSlot empty = { 0, kNoEntry };
+    std::fill(pSlots, pSlots + cSlots, empty);
+    std::fill(pNext, pNext + cEntries, kNoEntry);
+    memcpy(pbView, &header, sizeof(header));
+    SetView(pbView);
+    for (UINT32 id = cEntries; id-- > 0; ) {
+        Key key = Headword(id);
+        UINT32 hash = HashSpan(key);
+        for (UINT32 s = hash & m_mask; ; s = (s + 1) & m_mask) {
+            ImageSlot& slot = pSlots[s];
+            if (slot.id == kNoEntry) {
+                slot.hash = hash;
+                slot.id = id;
+                break;
+            }
+            if (slot.hash == hash && Headword(slot.id) == key) {
+                pNext[id] = slot.id;
+                slot.id = id;
+                break;
+            }
+        }
+    }
+
+    // Publish the image, then keep a read-only view of it, as the other
+    // processes have.
+    InterlockedExchange(reinterpret_cast<volatile LONG*>(pbView), static_cast<LONG>(kImageMagic));
+    UnmapViewOfFile(pbView);
+    m_pbView = nullptr;
+    m_pHeader = nullptr;
+    const BYTE* pbReadView = static_cast<const BYTE*>(MapViewOfFile(m_hSection, FILE_MAP_READ, 0, 0, 0));
+    if (!pbReadView || !Attach(pbReadView, static_cast<size_t>(header.cbImage))) {
+        m_pbView = pbReadView;
+        Close();
+    }
+}
+
+template <typename Char>
+DictionaryImage<Char>::DictionaryImage(LPCTSTR pszName)
+    : m_hSection(NULL), m_pbView(nullptr), m_pHeader(nullptr)
+{
+    m_hSection = OpenFileMapping(FILE_MAP_READ, FALSE, pszName);
+    if (m_hSection == NULL) return;
+    const BYTE* pbView = static_cast<const BYTE*>(MapViewOfFile(m_hSection, FILE_MAP_READ, 0, 0, 0));
+    MEMORY_BASIC_INFORMATION mbi = {};
+    if (!pbView || !VirtualQuery(pbView, &mbi, sizeof(mbi)) || !Attach(pbView, mbi.RegionSize)) {
+        m_pbView = pbView;
+        Close();
+    }
+}
+
+template <typename Char>
+DictionaryImage<Char>::~DictionaryImage()
+{
+    Close();
+}
+
+template <typename Char>
+bool DictionaryImage<Char>::Attach(const BYTE* pbView, size_t cbView)
+{
+    const ImageHeader* pHeader = reinterpret_cast<const ImageHeader*>(pbView);
+    if (cbView < sizeof(ImageHeader)) return false;
+    // The magic is written last: once it is there, so is the rest.
+    if (*reinterpret_cast<const volatile UINT32*>(&pHeader->magic) != kImageMagic) return false;
+    MemoryBarrier();
+    if (pHeader->version != kImageVersion || pHeader->cbChar != sizeof(Char)
+        || pHeader->cbImage > cbView) {
+        return false;
+    }
+    SetView(pbView);
+    return true;
+}
+
+template <typename Char>
+void DictionaryImage<Char>::SetView(const BYTE* pbView)
+{
+    const ImageHeader* pHeader = reinterpret_cast<const ImageHeader*>(pbView);
+    m_pbView = pbView;
+    m_pHeader = pHeader;
+    m_pFields = reinterpret_cast<const UINT32*>(pbView + pHeader->ibFields);
+    m_pSlots = reinterpret_cast<const ImageSlot*>(pbView + pHeader->ibSlots);
+    m_pNext = reinterpret_cast<const UINT32*>(pbView + pHeader->ibNext);
+    m_pChars = reinterpret_cast<const Char*>(pbView + pHeader->ibChars);
+    m_mask = pHeader->cSlots - 1;
+}
+
+template <typename Char>
+void DictionaryImage<Char>::Close()
+{
+    if (m_pbView) UnmapViewOfFile(m_pbView);
+    if (m_hSection) CloseHandle(m_hSection);
+    m_hSection = NULL;
+    m_pbView = nullptr;
+    m_pHeader = nullptr;
+}
+
+template <typename Char>
+UINT32 DictionaryImage<Char>::Find(const Key& key) const
+{
+    if (!m_pHeader) return kNoEntry;
+
+    UINT32 hash = HashSpan(key);
+    for (UINT32 s = hash & m_mask; ; s = (s + 1) & m_mask) {
+        const ImageSlot& slot = m_pSlots[s];
+        if (slot.id == kNoEntry) return kNoEntry;
+        if (slot.hash == hash && Headword(slot.id) == key) return slot.id;
+    }
+}
+
+
+} // namespace cedict
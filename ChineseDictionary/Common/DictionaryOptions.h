@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// DictionaryOptions.h -- Run-time options of the dictionary loader.
+//
+// The policies (see Dictionary.h) pick what is benchmarked at compile time;
+// these options switch load modes that apply to any combination of them.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+
+namespace cedict
+{
+
+
+struct DictionaryOptions
+{
+    DictionaryOptions()
+        : presize(false)
+        , largePages(false)
+        , buildIndex(false)
+        , headwordFilter(false)
+        , buildSortedIndex(false)
+        , buildSortedPinyinIndex(false)
+        , compressGlosses(false)
+        , validateUtf8(false)
+        , pinyinToneMarks(false)
+        , buildScriptConverters(false)
+        , buildFieldIndexes(false)
+        , buildFuzzyGlossIndex(false)
+        , buildFuzzyPinyinIndex(false)
+        , buildCrossReferences(false)
+        , buildThreads(1)
+    {}
+
+    // Two-pass load: count lines and characters first (when the input
+    // policy supports it), then reserve the entry vector and the string
+    // storage once, so that parsing never reallocates.
+    bool presize;
+
+    // Back the entry vector and the string pool chunks with large pages
+    // (see LargePages.h). Falls back to regular pages when unavailable.
+    bool largePages;
+
+    // Build the headword index right after loading (see Dictionary::Find).
+    bool buildIndex;
+
+    // Put a Bloom filter of the headwords in front of the index, so that
+    // Find() rejects most non-headwords without probing it. Only useful
+    // with the index.
+    bool headwordFilter;
+
+    // Build the ordered headword index too (see Dictionary::SortedIndex).
+    bool buildSortedIndex;
+
+    // Build an ordered index of the entries by pinyin as well (see
+    // Dictionary::SortedPinyinIndex).
+    bool buildSortedPinyinIndex;
+
+    // Keep the English glosses compressed with a symbol table learnt while
+    // loading (see CompressedGlossStore.h) instead of in the string storage.
+    // Read them with Dictionary::English().
+    bool compressGlosses;
+
+    // Check the whole file for invalid UTF-8 (see Utf8Validation.h) before
+    // parsing it, when the input policy supports it. If any line is invalid
+    // nothing is loaded: LoadStatistics::fRejected is set, and
+    // Dictionary::MalformedLines() lists the invalid lines. Otherwise,
+    // invalid lines are just skipped and listed as they are met.
+    bool validateUtf8;
+
+    // Store the pinyin with tone marks ("zhong1" becomes "zh\u014Dng", see
+    // Pinyin.h) instead of tone numbers, converting every entry at load.
+    // Ignored with UTF-8 storage (see UtfTranscoder).
+    bool pinyinToneMarks;
+
+    // Learn the traditional <-> simplified conversion tables from the
+    // headwords after loading (see Dictionary::TradToSimp, ScriptConverter.h).
+    // Ignored with UTF-8 storage, like pinyinToneMarks.
+    bool buildScriptConverters;
+
+    // Also index the entries by simplified headword, by pinyin and by each
+    // of their English glosses (see Dictionary::SimplifiedIndex).
+    bool buildFieldIndexes;
+
+    // Index the words of the English glosses by trigrams, for searches
+    // that tolerate misspellings (see Dictionary::FuzzyEnglish).
+    bool buildFuzzyGlossIndex;
+
+    // Keep the pinyin of the entries spelled for searches that tolerate
+    // typos and confusions (see Dictionary::FuzzyPinyin).
+    bool buildFuzzyPinyinIndex;
+
+    // Extract the references of the glosses to other entries ("variant of",
+    // "see", "CL:") and resolve them into links between the entries (see
+    // Dictionary::CrossReferences).
+    bool buildCrossReferences;
+
+    // Threads that build the structures above after loading, the loading
+    // thread included (see Dictionary::BuildIndexes): 1 builds them one
+    // after the other on the loading thread, 0 uses every logical
+    // processor.
+    unsigned buildThreads;
+};
+
+
+} // namespace cedict
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// EntryReader.h -- One pass over the entries of the dictionary file, without
+//                  loading them.
+//
+// Jobs that read every entry once do not need a Dictionary: EntryReader maps
+// the file and parses one line at a time, as the loader does (it shares
+// ReadEntryLine() with it), when its input iterator is incremented. The
+// entry it yields is a set of spans into a single transcoding buffer, reused
+// for every line, so it is only valid until the iterator moves on; nothing
+// else is allocated per entry.
+//
+//     cedict::EntryReader<> reader(TEXT("cedict.u8"));
+//     for (const auto& entry : reader) {
+//         Use(entry.trad, entry.pinyin);
+//     }
+//
+// The lines skipped are reported by MalformedLines(), as by the Dictionary.
+// The pinyin is the one of the file: ConvertPinyin() (see Pinyin.h) gives
+// the tone marks.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <cstddef>      // for std::ptrdiff_t
+#include <iterator>
+#include <vector>
+#include "Dictionary.h"
+#include "MappedTextFile.h"
+#include "TranscodePolicies.h"
+
+
+namespace cedict
+{
+
+
+template <typename TranscodePolicy = Win32Transcoder>
+class EntryReader
+{
+public:
+    typedef typename TranscodePolicy::CharType CharType;
+
+    // The fields of an entry line, and where the line is in the file.
+    struct Entry : EntryFields<CharType>
+    {
+        size_t ibOffset;    // byte offset of the line in the file
+        size_t iLine;       // line number, starting from 1
+    };
+
+    class Iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef Entry value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Entry* pointer;
+        typedef const Entry& reference;
+
+        const Entry& operator*() const { return m_pReader->m_entry; }
+        const Entry* operator->() const { return &m_pReader->m_entry; }
+
+        Iterator& operator++()
+        {
+            if (!m_pReader->Next()) m_pReader = nullptr;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return m_pReader == other.m_pReader; }
+        bool operator!=(const Iterator& other) const { return m_pReader != other.m_pReader; }
+
+    private:
+        friend class EntryReader;
+        explicit Iterator(EntryReader* pReader) : m_pReader(pReader) {}
+
+        EntryReader* m_pReader;     // nullptr at the end
+    };
+
+    explicit EntryReader(LPCTSTR pszFile = TEXT("cedict.u8"));
+
+    bool IsOpen() const { return m_mtf.Buffer() != nullptr; }
+
+    // Reads the first entry. The reader is an input range: it is read once,
+    // and begin() must only be called once.
+    Iterator begin() { return Iterator(Next() ? this : nullptr); }
+    Iterator end() { return Iterator(nullptr); }
+
+    // Lines skipped so far, in file order.
+    const std::vector<MalformedLine>& MalformedLines() const { return m_malformed; }
+
+private:
+    EntryReader(const EntryReader&) = delete;
+    EntryReader& operator=(const EntryReader&) = delete;
+
+    // Parse the lines up to the next entry; false at the end of the file.
+    bool Next();
+
+    MappedTextFile m_mtf;
+    const CHAR* m_pch;              // start of the next line
+    const CHAR* m_pchEnd;
+    size_t m_iLine;                 // number of the next line
+    TranscodePolicy m_transcoder;
+    std::vector<CharType> m_buf;    // transcoding buffer, reused for each line
+    Entry m_entry;
+    std::vector<MalformedLine> m_malformed;
+};
+
+
+template <typename TranscodePolicy>
+EntryReader<TranscodePolicy>::EntryReader(LPCTSTR pszFile)
+    : m_mtf(pszFile)
+    , m_pch(m_mtf.Buffer())
+    , m_pchEnd(m_mtf.Buffer() + m_mtf.Length())
+    , m_iLine(1)
+    , m_entry()
+{}
+
+template <typename TranscodePolicy>
+bool EntryReader<TranscodePolicy>::Next()
+{
+    while (m_pch < m_pchEnd) {
+        const CHAR* pchBegin = m_pch;
+        const CHAR* pchEOL = std::find(pchBegin, m_pchEnd, '\n');
+        size_t ibOffset = pchBegin - m_mtf.Buffer();
+        size_t iLine = m_iLine++;
+        m_pch = pchEOL + 1;
+
+        switch (ReadEntryLine(m_transcoder, pchBegin, pchEOL, m_buf, m_entry)) {
+        case kEntryLine:
+            m_entry.ibOffset = ibOffset;
+            m_entry.iLine = iLine;
+            return true;
+        case kBlankOrCommentLine:
+            break;
+        case kInvalidUtf8Line:
+            m_malformed.push_back(MalformedLine(ibOffset, iLine, MalformedLine::InvalidUtf8));
+            break;
+        case kUnparsableLine:
+            m_malformed.push_back(MalformedLine(ibOffset, iLine, MalformedLine::Unparsable));
+            break;
+        }
+    }
+    return false;
+}
+
+
+} // namespace cedict
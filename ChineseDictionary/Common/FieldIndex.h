@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// FieldIndex.h -- Hash index of the entries by a field other than the
+//                 traditional headword: the simplified headword, the pinyin,
+//                 or each of the English glosses.
+//
+// An entry may have several keys (one per gloss), so the index does not map
+// keys to entry ids directly, as HeadwordIndex does, but to postings: the
+// pairs (key, entry id) in the order given to Build(). The postings of the
+// same key are chained, in order, by a HeadwordIndex over the posting keys:
+//
+//     for (UINT32 p = index.Find(key); p != kNoEntry; p = index.Next(p)) {
+//         Use(dict.Item(index.EntryId(p)));
+//     }
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "HeadwordIndex.h"
+#include "TaskScheduler.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+template <typename Char>
+class FieldIndex
+{
+public:
+    typedef TextSpan<Char> Key;
+
+    // keys[p] is a key of entry entryIds[p]. The characters of the keys must
+    // outlive the index. With a scheduler, see HeadwordIndex::Build().
+    void Build(std::vector<Key> keys, std::vector<UINT32> entryIds, TaskScheduler* pScheduler = nullptr)
+    {
+        m_entryIds.swap(entryIds);
+        m_postings.Build(std::move(keys), pScheduler);
+    }
+
+    // First posting of key, or kNoEntry.
+    UINT32 Find(const Key& key) const { return m_postings.Find(key); }
+
+    // Next posting of the same key, or kNoEntry.
+    UINT32 Next(UINT32 posting) const { return m_postings.Next(posting); }
+
+    UINT32 EntryId(UINT32 posting) const { return m_entryIds[posting]; }
+
+    size_t PostingCount() const { return m_entryIds.size(); }
+    bool Empty() const { return m_postings.Empty(); }
+
+    // Memory held by the index (not counting the key characters).
+    size_t Bytes() const { return m_postings.Bytes() + m_entryIds.capacity() * sizeof(UINT32); }
+
+private:
+    HeadwordIndex<Char> m_postings;
+    std::vector<UINT32> m_entryIds;     // entry id of each posting
+};
+
+
+// Calls handler(glossBegin, glossEnd) for each '/' separated gloss of the
+// English field of an entry (the field read by ParseEntry(), without its
+// outer slashes). Empty glosses are skipped.
+template <typename Char, typename GlossHandler>
+void ForEachGloss(const TextSpan<Char>& english, GlossHandler handler)
+{
+    const Char* pch = english.pchBegin;
+    while (pch < english.pchEnd) {
+        const Char* pchSlash = std::find(pch, english.pchEnd, static_cast<Char>('/'));
+        if (pch < pchSlash) handler(pch, pchSlash);
+        pch = pchSlash + 1;
+    }
+}
+
+
+} // namespace cedict
@@ -0,0 +1,428 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// FuzzyGlossIndex.h -- Misspelling tolerant search of the English glosses,
+//                      with a trigram index of their words.
+//
+// The glosses are split into words (runs of ASCII letters and digits,
+// lowercased). Each distinct word of the dictionary is stored once, with
+// the ids of the entries that use it, and indexed by its trigrams: the
+// 3-character windows of the word padded with a boundary mark at each end,
+// so that a word of n characters has n trigrams ("tea" has ^te, tea, ea$).
+//
+// A query word matches a word of the dictionary within k edits (insertions,
+// deletions or substitutions), fewer for short words (see FuzzyEditsFor).
+// An edit changes at most 3 trigrams, so such a word shares at least t - 3k
+// of the t distinct trigrams of the query word: counting the shared
+// trigrams through the index gives the candidates, and only they are
+// verified with a bounded edit distance. When t - 3k < 1 (a short query
+// word, or many edits), every word of a close enough length is verified
+// instead.
+//
+// An entry matches a query when each word of the query matches one of its
+// words; the entries are ranked by the sum of the edits, then by entry id.
+// Searches go through a Searcher, which holds the buffers of one thread:
+//
+//     FuzzyGlossIndex<WCHAR>::Searcher searcher(dict.FuzzyEnglish());
+//     searcher.Search(query, 1, 10, matches);
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "LoadTrace.h"
+#include "TaskScheduler.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+// An entry found by a fuzzy search, and the edits that it took.
+struct FuzzyMatch
+{
+    UINT32 entryId;
+    UINT32 distance;
+};
+
+// Calls handler(pchWord, cchWord) for each word of [pchBegin, pchEnd), as
+// the index splits them: runs of ASCII letters and digits, lowercased into
+// a buffer. Longer words are cut to kMaxFuzzyWordLength characters.
+const size_t kMaxFuzzyWordLength = 64;
+
+template <typename Char, typename WordHandler>
+void ForEachWord(const Char* pchBegin, const Char* pchEnd, WordHandler handler)
+{
+    char word[kMaxFuzzyWordLength];
+    size_t cch = 0;
+    for (const Char* pch = pchBegin; ; ++pch) {
+        UINT32 u = pch < pchEnd ? static_cast<UINT32>(*pch) : 0;
+        if (u >= 'A' && u <= 'Z') u += 'a' - 'A';
+        if ((u >= 'a' && u <= 'z') || (u >= '0' && u <= '9')) {
+            if (cch < kMaxFuzzyWordLength) word[cch++] = static_cast<char>(u);
+        } else if (cch > 0) {
+            handler(static_cast<const char*>(word), cch);
+            cch = 0;
+        }
+        if (pch >= pchEnd) break;
+    }
+}
+
+// The edits allowed for a query word of cchWord characters: at most
+// maxEdits, and fewer for short words, which would match too many others
+// (as the AUTO fuzziness of Lucene): none up to 2 characters, 1 up to 5.
+inline UINT32 FuzzyEditsFor(size_t cchWord, UINT32 maxEdits)
+{
+    UINT32 cEdits = cchWord <= 2 ? 0 : cchWord <= 5 ? 1 : 2 + static_cast<UINT32>(cchWord - 6) / 4;
+    return (std::min)(cEdits, maxEdits);
+}
+
+// Levenshtein distance of a and b, or maxDistance + 1 if it is larger.
+// Only the band of the matrix within maxDistance of the diagonal is
+// computed, one row at a time, and the computation stops as soon as a row
+// of the band exceeds maxDistance. row must hold cchB + 1 elements.
+inline UINT32 BoundedEditDistance(const char* a, size_t cchA, const char* b, size_t cchB,
+    UINT32 maxDistance, UINT32* row)
+{
+    const UINT32 kOver = maxDistance + 1;
+    size_t cchDiff = cchA > cchB ? cchA - cchB : cchB - cchA;
+    if (cchDiff > maxDistance) return kOver;
+
+    // The cells right of the band are never written: they keep kOver.
+    for (size_t j = 0; j <= cchB; ++j) row[j] = (std::min)(static_cast<UINT32>(j), kOver);
+    for (size_t i = 1; i <= cchA; ++i) {
+        size_t jFirst = i > maxDistance ? i - maxDistance : 1;
+        size_t jLast = (std::min)(cchB, i + maxDistance);
+        UINT32 diagonal = row[jFirst - 1];
+        row[jFirst - 1] = jFirst == 1 ? (std::min)(static_cast<UINT32>(i), kOver) : kOver;
+        UINT32 rowMin = row[jFirst - 1];
+        for (size_t j = jFirst; j <= jLast; ++j) {
+            UINT32 d = (std::min)({ row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1]) });
+            diagonal = row[j];
+            row[j] = (std::min)(d, kOver);
+            rowMin = (std::min)(rowMin, row[j]);
+        }
+        if (rowMin == kOver) return kOver;
+    }
+    return row[cchB];
+}
+
+
+template <typename Char>
+class FuzzyGlossIndex
+{
+public:
+    class Searcher;
+
+    FuzzyGlossIndex() : m_cEntries(0) {}
+
+    // Indexes the words of text(i, buffer), the English glosses of entry i,
+    // for the entries 0 to cEntries - 1. The words are copied: the text may
+    // be in buffer, a std::vector<Char> that text() may resize and reuse
+    // for each entry. With a scheduler, pieces of the entries are split into
+    // words in parallel, each piece with a buffer of its own, and text()
+    // must be safe to call from several threads.
+    template <typename TextFunction>
+    void Build(size_t cEntries, TextFunction text, TaskScheduler* pScheduler = nullptr)
+    {
+        m_cEntries = cEntries;
+
+        // Each piece numbers its words in the order they first appear, and
+        // lists its uses of them as (word, entry) pairs, once per entry.
+        struct Piece
+        {
+            std::unordered_map<std::string, UINT32> wordIds;
+            std::vector<const std::string*> words;              // by id in the piece
+            std::vector<std::pair<UINT32, UINT32>> uses;        // (word id, entry id)
+        };
+        const size_t cPieces = PieceCount(pScheduler, cEntries, kMinPiece);
+        std::vector<Piece> pieces(cPieces);
+        ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+            TraceScope trace("split words");
+            std::vector<Char> buffer;
+            std::vector<UINT32> entryWords;
+            for (size_t k = kBegin; k < kEnd; ++k) {
+                Piece& piece = pieces[k];
+                for (size_t i = PieceStart(cEntries, cPieces, k); i < PieceStart(cEntries, cPieces, k + 1); ++i) {
+                    TextSpan<Char> english = text(i, buffer);
+                    entryWords.clear();
+                    ForEachWord(english.pchBegin, english.pchEnd, [&](const char* pchWord, size_t cchWord) {
+                        auto inserted = piece.wordIds.emplace(std::string(pchWord, cchWord),
+                            static_cast<UINT32>(piece.wordIds.size()));
+                        if (inserted.second) piece.words.push_back(&inserted.first->first);
+                        entryWords.push_back(inserted.first->second);
+                    });
+                    std::sort(entryWords.begin(), entryWords.end());
+                    entryWords.erase(std::unique(entryWords.begin(), entryWords.end()), entryWords.end());
+                    for (UINT32 w : entryWords) piece.uses.push_back(std::make_pair(w, static_cast<UINT32>(i)));
+                }
+            }
+        });
+
+        // Merge the words of the pieces, in order, so that the ids are the
+        // same as if one thread had split all the entries.
+        TraceScope traceMerge("merge words");
+        std::unordered_map<std::string, UINT32> wordIds;
+        std::vector<const std::string*> words;
+        std::vector<std::vector<UINT32>> pieceToGlobal(cPieces);
+        for (size_t k = 0; k < cPieces; ++k) {
+            for (const std::string* pWord : pieces[k].words) {
+                auto inserted = wordIds.emplace(*pWord, static_cast<UINT32>(wordIds.size()));
+                if (inserted.second) words.push_back(pWord);
+                pieceToGlobal[k].push_back(inserted.first->second);
+            }
+        }
+        const size_t cWords = words.size();
+        m_wordStarts.assign(1, 0);
+        m_chars.clear();
+        for (const std::string* pWord : words) {
+            m_chars.insert(m_chars.end(), pWord->begin(), pWord->end());
+            m_wordStarts.push_back(static_cast<UINT32>(m_chars.size()));
+        }
+        traceMerge.End();
+
+        // Entries of each word, in ascending order, by a counting sort
+        // partitioned by piece: each piece counts its uses of each word,
+        // the counts give where the entries of each piece go in the list of
+        // each word (after those of the pieces before), and each piece puts
+        // its entries there, in the order of its uses.
+        TraceScope traceSort("sort word entries");
+        std::vector<std::vector<UINT32>> pieceNext(cPieces);
+        ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+            for (size_t k = kBegin; k < kEnd; ++k) {
+                pieceNext[k].assign(cWords, 0);
+                for (auto& use : pieces[k].uses) {
+                    use.first = pieceToGlobal[k][use.first];
+                    pieceNext[k][use.first]++;
+                }
+            }
+        });
+        m_entryStarts.assign(cWords + 1, 0);
+        for (size_t w = 0; w < cWords; ++w) {
+            UINT32 start = m_entryStarts[w];
+            for (size_t k = 0; k < cPieces; ++k) {
+                UINT32 count = pieceNext[k][w];
+                pieceNext[k][w] = start;
+                start += count;
+            }
+            m_entryStarts[w + 1] = start;
+        }
+        m_entryIds.resize(m_entryStarts[cWords]);
+        ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+            for (size_t k = kBegin; k < kEnd; ++k) {
+                for (const auto& use : pieces[k].uses) m_entryIds[pieceNext[k][use.first]++] = use.second;
+            }
+        });
+        traceSort.End();
+
+        // Words of each trigram, in ascending order and each once, by a
+        // counting sort on the trigrams.
+        std::vector<UINT32> trigrams;
+        m_trigramStarts.assign(kTrigramCount + 1, 0);
+        for (UINT32 w = 0; w < cWords; ++w) {
+            DistinctTrigrams(Word(w), WordLength(w), trigrams);
+            for (UINT32 t : trigrams) m_trigramStarts[t + 1]++;
+        }
+        for (size_t t = 0; t < kTrigramCount; ++t) m_trigramStarts[t + 1] += m_trigramStarts[t];
+        m_trigramWords.resize(m_trigramStarts[kTrigramCount]);
+        std::vector<UINT32> next(m_trigramStarts.begin(), m_trigramStarts.end() - 1);
+        for (UINT32 w = 0; w < cWords; ++w) {
+            DistinctTrigrams(Word(w), WordLength(w), trigrams);
+            for (UINT32 t : trigrams) m_trigramWords[next[t]++] = w;
+        }
+
+        // Words by length, for the queries that the trigrams cannot filter.
+        m_wordsByLength.resize(cWords);
+        for (UINT32 w = 0; w < cWords; ++w) m_wordsByLength[w] = w;
+        std::stable_sort(m_wordsByLength.begin(), m_wordsByLength.end(), [&](UINT32 a, UINT32 b) {
+            return WordLength(a) < WordLength(b);
+        });
+        m_lengthStarts.assign(kMaxFuzzyWordLength + 2, 0);
+        for (UINT32 w = 0; w < cWords; ++w) m_lengthStarts[WordLength(w) + 1]++;
+        for (size_t cch = 0; cch <= kMaxFuzzyWordLength; ++cch) {
+            m_lengthStarts[cch + 1] += m_lengthStarts[cch];
+        }
+    }
+
+    size_t WordCount() const { return m_wordStarts.empty() ? 0 : m_wordStarts.size() - 1; }
+    bool Empty() const { return WordCount() == 0; }
+
+    // Memory held by the index.
+    size_t Bytes() const
+    {
+        return m_chars.capacity() + (m_wordStarts.capacity() + m_entryStarts.capacity()
+            + m_entryIds.capacity() + m_trigramStarts.capacity() + m_trigramWords.capacity()
+            + m_wordsByLength.capacity() + m_lengthStarts.capacity()) * sizeof(UINT32);
+    }
+
+private:
+    // Trigrams are numbered in base 37: the boundary mark, then a-z and 0-9.
+    static const size_t kSymbolCount = 37;
+    static const size_t kTrigramCount = kSymbolCount * kSymbolCount * kSymbolCount;
+    static const size_t kMinPiece = 4096;       // entries per task of Build()
+
+    static UINT32 Symbol(char ch)
+    {
+        return ch >= 'a' ? ch - 'a' + 1 : ch - '0' + 27;
+    }
+
+    // The distinct trigrams of a word, sorted.
+    static void DistinctTrigrams(const char* pchWord, size_t cchWord, std::vector<UINT32>& trigrams)
+    {
+        trigrams.clear();
+        for (size_t i = 0; i < cchWord; ++i) {
+            UINT32 s0 = i > 0 ? Symbol(pchWord[i - 1]) : 0;
+            UINT32 s1 = Symbol(pchWord[i]);
+            UINT32 s2 = i + 1 < cchWord ? Symbol(pchWord[i + 1]) : 0;
+            trigrams.push_back((s0 * kSymbolCount + s1) * kSymbolCount + s2);
+        }
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    }
+
+    const char* Word(UINT32 w) const { return m_chars.data() + m_wordStarts[w]; }
+    size_t WordLength(UINT32 w) const { return m_wordStarts[w + 1] - m_wordStarts[w]; }
+
+    std::vector<char> m_chars;              // the characters of all the words
+    std::vector<UINT32> m_wordStarts;       // word w is m_chars[m_wordStarts[w], m_wordStarts[w + 1])
+    std::vector<UINT32> m_entryStarts;      // entries of word w, in m_entryIds
+    std::vector<UINT32> m_entryIds;
+    std::vector<UINT32> m_trigramStarts;    // words of trigram t, in m_trigramWords
+    std::vector<UINT32> m_trigramWords;
+    std::vector<UINT32> m_wordsByLength;    // the word ids, by length...
+    std::vector<UINT32> m_lengthStarts;     // ... from m_lengthStarts[length]
+    size_t m_cEntries;
+};
+
+
+template <typename Char>
+class FuzzyGlossIndex<Char>::Searcher
+{
+public:
+    explicit Searcher(const FuzzyGlossIndex& index)
+        : m_index(index), m_counts(index.WordCount()), m_entryEdits(index.m_cEntries, kNoMatch)
+        , m_row(kMaxFuzzyWordLength + 1), m_cVerified(0)
+    {}
+
+    // Entries that have, for each word of query, a word within
+    // FuzzyEditsFor(word, maxEdits) edits of it; the cMaxResults best ones,
+    // fewest edits first. Empty if the query has no words.
+    void Search(const TextSpan<Char>& query, UINT32 maxEdits, size_t cMaxResults,
+        std::vector<FuzzyMatch>& results)
+    {
+        results.clear();
+        m_cVerified = 0;
+        bool fFirst = true;
+        ForEachWord(query.pchBegin, query.pchEnd, [&](const char* pchWord, size_t cchWord) {
+            if (!fFirst && results.empty()) return;
+            FindEntries(pchWord, cchWord, FuzzyEditsFor(cchWord, maxEdits));
+            if (fFirst) {
+                for (UINT32 e : m_hits) {
+                    FuzzyMatch match = { e, m_entryEdits[e] };
+                    results.push_back(match);
+                }
+            } else {
+                // Keep the entries that match this word too.
+                auto kept = results.begin();
+                for (auto r = results.begin(); r != results.end(); ++r) {
+                    if (m_entryEdits[r->entryId] == kNoMatch) continue;
+                    kept->entryId = r->entryId;
+                    kept->distance = r->distance + m_entryEdits[r->entryId];
+                    ++kept;
+                }
+                results.erase(kept, results.end());
+            }
+            for (UINT32 e : m_hits) m_entryEdits[e] = kNoMatch;
+            fFirst = false;
+        });
+
+        auto better = [](const FuzzyMatch& a, const FuzzyMatch& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.entryId < b.entryId;
+        };
+        if (results.size() > cMaxResults) {
+            std::partial_sort(results.begin(), results.begin() + cMaxResults, results.end(), better);
+            results.resize(cMaxResults);
+        } else {
+            std::sort(results.begin(), results.end(), better);
+        }
+    }
+
+    // Words of the index whose edit distance the last search computed.
+    size_t VerifiedWords() const { return m_cVerified; }
+
+private:
+    Searcher(const Searcher&) = delete;
+    Searcher& operator=(const Searcher&) = delete;
+
+    enum { kNoMatch = 0xFF };
+
+    // Sets m_hits to the entries with a word within maxEdits of the query
+    // word, each once, and m_entryEdits to their fewest edits.
+    void FindEntries(const char* pchWord, size_t cchWord, UINT32 maxEdits)
+    {
+        m_hits.clear();
+        FuzzyGlossIndex::DistinctTrigrams(pchWord, cchWord, m_trigrams);
+        size_t cchMin = cchWord > maxEdits ? cchWord - maxEdits : 0;
+        size_t cchMax = (std::min)(cchWord + maxEdits, kMaxFuzzyWordLength);
+
+        if (m_trigrams.size() > 3 * static_cast<size_t>(maxEdits)) {
+            // Count the trigrams that each word shares with the query word.
+            const UINT32 cShared = static_cast<UINT32>(m_trigrams.size() - 3 * maxEdits);
+            m_touched.clear();
+            for (UINT32 t : m_trigrams) {
+                for (UINT32 i = m_index.m_trigramStarts[t]; i < m_index.m_trigramStarts[t + 1]; ++i) {
+                    UINT32 w = m_index.m_trigramWords[i];
+                    if (m_counts[w]++ == 0) m_touched.push_back(w);
+                }
+            }
+            for (UINT32 w : m_touched) {
+                size_t cch = m_index.WordLength(w);
+                if (m_counts[w] >= cShared && cch >= cchMin && cch <= cchMax) {
+                    Verify(pchWord, cchWord, w, maxEdits);
+                }
+                m_counts[w] = 0;
+            }
+        } else {
+            for (UINT32 i = m_index.m_lengthStarts[cchMin]; i < m_index.m_lengthStarts[cchMax + 1]; ++i) {
+                Verify(pchWord, cchWord, m_index.m_wordsByLength[i], maxEdits);
+            }
+        }
+    }
+
+    // Adds the entries of word w to the hits if it is within maxEdits.
+    void Verify(const char* pchWord, size_t cchWord, UINT32 w, UINT32 maxEdits)
+    {
+        m_cVerified++;
+        UINT32 distance = BoundedEditDistance(pchWord, cchWord, m_index.Word(w), m_index.WordLength(w),
+            maxEdits, m_row.data());
+        if (distance > maxEdits) return;
+        for (UINT32 i = m_index.m_entryStarts[w]; i < m_index.m_entryStarts[w + 1]; ++i) {
+            UINT32 e = m_index.m_entryIds[i];
+            if (m_entryEdits[e] == kNoMatch) {
+                m_hits.push_back(e);
+                m_entryEdits[e] = static_cast<UINT8>(distance);
+            } else if (distance < m_entryEdits[e]) {
+                m_entryEdits[e] = static_cast<UINT8>(distance);
+            }
+        }
+    }
+
+    const FuzzyGlossIndex& m_index;
+    std::vector<UINT32> m_counts;       // shared trigrams of each word, 0 between queries
+    std::vector<UINT32> m_touched;      // the words with a count
+    std::vector<UINT8> m_entryEdits;    // edits of each entry for a word, kNoMatch between words
+    std::vector<UINT32> m_hits;         // the entries with edits
+    std::vector<UINT32> m_trigrams;
+    std::vector<UINT32> m_row;
+    size_t m_cVerified;
+};
+
+
+} // namespace cedict
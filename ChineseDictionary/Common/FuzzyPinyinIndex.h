@@ -0,0 +1,434 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// FuzzyPinyinIndex.h -- Typo tolerant search of the pinyin field, with a
+//                       bit-parallel edit distance.
+//
+// The pinyin of each entry is kept in two spellings, without the spaces
+// between syllables, so that "zhongguo" finds "zhong1 guo2":
+//
+//  - as written: lowercase letters and tone digits ("u:" becomes 'v');
+//  - folded: without the tones, and with the usual confusions merged, the
+//    initials zh, ch, sh into z, c, s and the final ng into n, so that
+//    "zong guo" and "zhong1 guo2" both fold to "zonguo". Before a vowel,
+//    ng is left as it is, as the g may be the next initial.
+//
+// A query matches the entries whose folded pinyin is within k edits of its
+// own: the confusions and the missing or wrong tones cost nothing, any
+// other letter inserted, deleted or replaced costs one. The matches are
+// ranked by that distance, then by the distance of the spellings as
+// written, so that the right tones and initials come first.
+//
+// The distances are computed with the bit-parallel algorithm of Myers, as
+// formulated by Hyyrö: the query (up to 64 letters) is a bit mask per
+// letter, and each letter of an entry updates the whole column of the
+// dynamic programming matrix with a few 64-bit operations. Before that,
+// three filters discard most entries without looking at their letters:
+//
+//  - syllables: the entries are sorted by their count of vowel groups, one
+//    per syllable (the nucleus), and an edit changes that count by one at
+//    most, so only the entries within k of the query are scanned;
+//  - length: within a syllable count they are sorted by folded length,
+//    which an edit changes by one at most too;
+//  - letters: an edit brings at most one letter that the other side lacks,
+//    so at most k letters of the query may be absent from the entry, and
+//    the other way round (compared as masks of the letters present).
+//
+// Pinyin with tone marks (DictionaryOptions::pinyinToneMarks) is read
+// without its tones.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <vector>
+#include "FuzzyGlossIndex.h"    // for FuzzyMatch
+#include "Pinyin.h"
+#include "TaskScheduler.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+// Longest query, in letters; longer ones are cut.
+const size_t kMaxFuzzyPinyinLength = 64;
+
+// The letters and tone digits of the spellings (see SpellPinyin).
+const size_t kPinyinSymbolCount = 31;
+
+namespace detail
+{
+
+// The letter of a tone-marked vowel of Pinyin.h ('v' for u with diaeresis),
+// or 0.
+template <typename Char>
+char PinyinBaseVowel(Char ch)
+{
+    static const char kBaseVowels[] = "aeiouvAEIOUV";
+    for (int v = 0; v < 12; ++v) {
+        for (int tone = 0; tone < 4; ++tone) {
+            if (static_cast<UINT32>(ch) == static_cast<UINT32>(kToneMarks[v][tone])) return kBaseVowels[v];
+        }
+    }
+    return 0;
+}
+
+inline int CountBits(UINT32 x)
+{
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return static_cast<int>((((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+}
+
+// Letters 'a' to 'z', then the tone digits '1' to '5'.
+inline UINT32 PinyinSymbol(char ch)
+{
+    return ch >= 'a' ? ch - 'a' : ch - '1' + 26;
+}
+
+inline bool IsPinyinVowel(char ch)
+{
+    return ch == 'a' || ch == 'e' || ch == 'i' || ch == 'o' || ch == 'u' || ch == 'v';
+}
+
+} // namespace detail
+
+
+// Writes the pinyin of [pchBegin, pchEnd) as written (fFold false) or
+// folded (fFold true) to pchDest, at most cchMax letters, and returns its
+// length. See the top of the file.
+template <typename Char>
+size_t SpellPinyin(const Char* pchBegin, const Char* pchEnd, bool fFold, char* pchDest, size_t cchMax)
+{
+    size_t cch = 0;
+    for (const Char* pch = pchBegin; pch < pchEnd && cch < cchMax; ++pch) {
+        UINT32 u = static_cast<UINT32>(*pch);
+        char ch = 0;
+        if (u >= 'A' && u <= 'Z') {
+            ch = static_cast<char>(u - 'A' + 'a');
+        } else if (u >= 'a' && u <= 'z') {
+            ch = static_cast<char>(u);
+        } else if (u >= '1' && u <= '5') {
+            ch = fFold ? 0 : static_cast<char>(u);
+        } else if (u == 0xFC || u == 0xDC) {
+            ch = 'v';
+        } else if (u >= 0x80) {
+            ch = detail::PinyinBaseVowel(*pch);
+            if (ch >= 'A' && ch <= 'Z') ch += 'a' - 'A';
+        }
+        if (ch == 'u' && pch + 1 < pchEnd && static_cast<UINT32>(pch[1]) == ':') {
+            ch = 'v';
+            ++pch;
+        }
+        if (ch) pchDest[cch++] = ch;
+    }
+    if (!fFold) return cch;
+
+    // zh, ch, sh -> z, c, s, and ng -> n unless a vowel follows: then the
+    // g may start the next syllable ("xin gan" and "xing an" both spell
+    // "xingan"). The initials need no syllable boundaries.
+    size_t cchFolded = 0;
+    for (size_t i = 0; i < cch; ++i) {
+        char ch = pchDest[i];
+        pchDest[cchFolded++] = ch;
+        if (i + 1 < cch && ((pchDest[i + 1] == 'h' && (ch == 'z' || ch == 'c' || ch == 's'))
+            || (pchDest[i + 1] == 'g' && ch == 'n' && (i + 2 == cch || !detail::IsPinyinVowel(pchDest[i + 2]))))) {
+            ++i;
+        }
+    }
+    return cchFolded;
+}
+
+// The bit masks of a spelling of up to 64 letters for MyersDistance():
+// peq[s] has bit i set if letter i is symbol s.
+inline void MakePinyinPattern(const char* pch, size_t cch, UINT64 (&peq)[kPinyinSymbolCount])
+{
+    std::fill(peq, peq + kPinyinSymbolCount, 0);
+    for (size_t i = 0; i < cch; ++i) peq[detail::PinyinSymbol(pch[i])] |= 1ULL << i;
+}
+
+// Levenshtein distance between a pattern of up to 64 letters, given by
+// MakePinyinPattern(), and a text, with the bit-parallel algorithm of
+// Myers (see the top of the file), or maxDistance + 1 if it is larger.
+inline UINT32 MyersDistance(const UINT64* peq, size_t cchPattern, const char* pchText, size_t cchText,
+    UINT32 maxDistance)
+{
+    const UINT32 kOver = maxDistance + 1;
+    if (cchPattern == 0) return cchText <= maxDistance ? static_cast<UINT32>(cchText) : kOver;
+
+    const UINT64 high = 1ULL << (cchPattern - 1);
+    UINT64 pv = ~0ULL;      // vertical deltas of the column: +1...
+    UINT64 mv = 0;          // ... or -1
+    size_t score = cchPattern;
+    for (size_t j = 0; j < cchText; ++j) {
+        UINT64 eq = peq[detail::PinyinSymbol(pchText[j])];
+        UINT64 xv = eq | mv;
+        UINT64 xh = (((eq & pv) + pv) ^ pv) | eq;
+        UINT64 ph = mv | ~(xh | pv);
+        UINT64 mh = pv & xh;
+        if (ph & high) {
+            score++;
+        } else if (mh & high) {
+            score--;
+        }
+        // The first row is 0, 1, 2...: its horizontal deltas are all +1.
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        // The score drops by one per letter at most.
+        if (score > maxDistance + (cchText - 1 - j)) return kOver;
+    }
+    return score <= maxDistance ? static_cast<UINT32>(score) : kOver;
+}
+
+
+template <typename Char>
+class FuzzyPinyinIndex
+{
+public:
+    class Searcher;
+
+    // Indexes pinyin(i), the pinyin of entry i, for the entries 0 to
+    // cEntries - 1. The spellings are copied. With a scheduler, pieces of
+    // the entries are spelled in parallel, and pinyin() must be safe to
+    // call from several threads.
+    template <typename TextFunction>
+    void Build(size_t cEntries, TextFunction pinyin, TaskScheduler* pScheduler = nullptr)
+    {
+        struct Item
+        {
+            UINT32 entryId;
+            UINT32 ichFolded;
+            UINT32 ichWritten;
+            UINT32 mask;
+            UINT16 cchFolded;
+            UINT16 cchWritten;
+            UINT8 cSyllables;
+        };
+        struct Piece
+        {
+            std::vector<char> folded;
+            std::vector<char> written;
+        };
+        std::vector<Item> items(cEntries);
+        const size_t cPieces = PieceCount(pScheduler, cEntries, kMinPiece);
+        std::vector<Piece> pieces(cPieces);
+        ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+            char buf[kMaxSpelling];
+            for (size_t k = kBegin; k < kEnd; ++k) {
+                Piece& piece = pieces[k];
+                for (size_t i = PieceStart(cEntries, cPieces, k); i < PieceStart(cEntries, cPieces, k + 1); ++i) {
+                    TextSpan<Char> text = pinyin(i);
+                    Item& item = items[i];
+                    item.entryId = static_cast<UINT32>(i);
+                    size_t cch = SpellPinyin(text.pchBegin, text.pchEnd, true, buf, kMaxSpelling);
+                    item.ichFolded = static_cast<UINT32>(piece.folded.size());
+                    item.cchFolded = static_cast<UINT16>(cch);
+                    item.mask = LetterMask(buf, cch);
+                    item.cSyllables = static_cast<UINT8>(CountSyllables(buf, cch));
+                    piece.folded.insert(piece.folded.end(), buf, buf + cch);
+                    cch = SpellPinyin(text.pchBegin, text.pchEnd, false, buf, kMaxSpelling);
+                    item.ichWritten = static_cast<UINT32>(piece.written.size());
+                    item.cchWritten = static_cast<UINT16>(cch);
+                    piece.written.insert(piece.written.end(), buf, buf + cch);
+                }
+            }
+        });
+
+        // The spellings of the pieces end to end; their items are moved
+        // along.
+        std::vector<char> folded;
+        std::vector<char> written;
+        for (size_t k = 0; k < cPieces; ++k) {
+            const UINT32 ichFolded = static_cast<UINT32>(folded.size());
+            const UINT32 ichWritten = static_cast<UINT32>(written.size());
+            if (k > 0) {
+                for (size_t i = PieceStart(cEntries, cPieces, k); i < PieceStart(cEntries, cPieces, k + 1); ++i) {
+                    items[i].ichFolded += ichFolded;
+                    items[i].ichWritten += ichWritten;
+                }
+            }
+            folded.insert(folded.end(), pieces[k].folded.begin(), pieces[k].folded.end());
+            written.insert(written.end(), pieces[k].written.begin(), pieces[k].written.end());
+            std::vector<char>().swap(pieces[k].folded);
+            std::vector<char>().swap(pieces[k].written);
+        }
+
+        ParallelStableSort(pScheduler, items.begin(), items.end(), [](const Item& a, const Item& b) {
+            return a.cSyllables != b.cSyllables ? a.cSyllables < b.cSyllables
+                : Bucket(a.cchFolded) < Bucket(b.cchFolded);
+        });
+
+        // Lay the spellings out in scan order too: the starts first, then
+        // the letters, copied in parallel.
+        m_entryIds.resize(cEntries);
+        m_masks.resize(cEntries);
+        m_foldedStarts.resize(cEntries + 1);
+        m_writtenStarts.resize(cEntries + 1);
+        m_bucketStarts.assign(kSyllableBuckets * kLengthBuckets + 1, 0);
+        m_foldedStarts[0] = 0;
+        m_writtenStarts[0] = 0;
+        for (size_t i = 0; i < cEntries; ++i) {
+            const Item& item = items[i];
+            m_entryIds[i] = item.entryId;
+            m_masks[i] = item.mask;
+            m_foldedStarts[i + 1] = m_foldedStarts[i] + item.cchFolded;
+            m_writtenStarts[i + 1] = m_writtenStarts[i] + item.cchWritten;
+            m_bucketStarts[item.cSyllables * kLengthBuckets + Bucket(item.cchFolded) + 1]++;
+        }
+        for (size_t b = 0; b < kSyllableBuckets * kLengthBuckets; ++b) {
+            m_bucketStarts[b + 1] += m_bucketStarts[b];
+        }
+        m_folded.resize(folded.size());
+        m_written.resize(written.size());
+        ParallelFor(pScheduler, 0, cEntries, kMinPiece, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const Item& item = items[i];
+                std::copy(folded.data() + item.ichFolded, folded.data() + item.ichFolded + item.cchFolded,
+                    m_folded.data() + m_foldedStarts[i]);
+                std::copy(written.data() + item.ichWritten, written.data() + item.ichWritten + item.cchWritten,
+                    m_written.data() + m_writtenStarts[i]);
+            }
+        });
+    }
+
+    size_t Length() const { return m_entryIds.size(); }
+
+    // Memory held by the index.
+    size_t Bytes() const
+    {
+        return m_folded.capacity() + m_written.capacity() + (m_entryIds.capacity() + m_masks.capacity()
+            + m_foldedStarts.capacity() + m_writtenStarts.capacity() + m_bucketStarts.capacity())
+            * sizeof(UINT32);
+    }
+
+private:
+    // Spellings are cut to kMaxSpelling letters; the entries are sorted by
+    // syllables and length up to kSyllableBuckets - 1 and kLengthBuckets - 1.
+    static const size_t kMaxSpelling = 1024;
+    static const size_t kSyllableBuckets = 32;
+    static const size_t kMinPiece = 4096;       // entries per task of Build()
+    static const size_t kLengthBuckets = 128;
+
+    static size_t Bucket(size_t cch) { return (std::min)(cch, kLengthBuckets - 1); }
+
+    static UINT32 LetterMask(const char* pch, size_t cch)
+    {
+        UINT32 mask = 0;
+        for (size_t i = 0; i < cch; ++i) mask |= 1u << detail::PinyinSymbol(pch[i]);
+        return mask;
+    }
+
+    // The vowel groups of a folded spelling, capped at kSyllableBuckets - 1.
+    static size_t CountSyllables(const char* pch, size_t cch)
+    {
+        size_t c = 0;
+        for (size_t i = 0; i < cch; ++i) {
+            c += detail::IsPinyinVowel(pch[i]) && (i == 0 || !detail::IsPinyinVowel(pch[i - 1]));
+        }
+        return (std::min)(c, kSyllableBuckets - 1);
+    }
+
+    // In scan order: by syllables, then by folded length.
+    std::vector<UINT32> m_entryIds;
+    std::vector<UINT32> m_masks;            // letters of the folded spelling
+    std::vector<char> m_folded;
+    std::vector<UINT32> m_foldedStarts;
+    std::vector<char> m_written;
+    std::vector<UINT32> m_writtenStarts;
+    std::vector<UINT32> m_bucketStarts;     // first entry of each (syllables, length)
+};
+
+
+template <typename Char>
+class FuzzyPinyinIndex<Char>::Searcher
+{
+public:
+    explicit Searcher(const FuzzyPinyinIndex& index) : m_index(index), m_cCompared(0) {}
+
+    // Entries whose folded pinyin is within maxEdits edits of the query;
+    // the cMaxResults best ones (see the top of the file).
+    void Search(const TextSpan<Char>& query, UINT32 maxEdits, size_t cMaxResults,
+        std::vector<FuzzyMatch>& results)
+    {
+        char folded[kMaxFuzzyPinyinLength];
+        char written[kMaxFuzzyPinyinLength];
+        size_t cchFolded = SpellPinyin(query.pchBegin, query.pchEnd, true, folded, kMaxFuzzyPinyinLength);
+        size_t cchWritten = SpellPinyin(query.pchBegin, query.pchEnd, false, written, kMaxFuzzyPinyinLength);
+        UINT64 peqFolded[kPinyinSymbolCount];
+        UINT64 peqWritten[kPinyinSymbolCount];
+        MakePinyinPattern(folded, cchFolded, peqFolded);
+        MakePinyinPattern(written, cchWritten, peqWritten);
+        const UINT32 mask = FuzzyPinyinIndex::LetterMask(folded, cchFolded);
+        const size_t cSyllables = FuzzyPinyinIndex::CountSyllables(folded, cchFolded);
+
+        m_candidates.clear();
+        m_cCompared = 0;
+        size_t cSyllablesMin = cSyllables > maxEdits ? cSyllables - maxEdits : 0;
+        size_t cSyllablesMax = (std::min)(cSyllables + maxEdits, kSyllableBuckets - 1);
+        size_t cchMin = cchFolded > maxEdits ? cchFolded - maxEdits : 0;
+        size_t cchMax = cchFolded + maxEdits;
+        for (size_t s = cSyllablesMin; s <= cSyllablesMax; ++s) {
+            const UINT32* pStarts = &m_index.m_bucketStarts[s * kLengthBuckets];
+            UINT32 iEnd = pStarts[FuzzyPinyinIndex::Bucket(cchMax) + 1];
+            for (UINT32 i = pStarts[FuzzyPinyinIndex::Bucket(cchMin)]; i < iEnd; ++i) {
+                UINT32 entryMask = m_index.m_masks[i];
+                if (static_cast<UINT32>(detail::CountBits(mask & ~entryMask)) > maxEdits
+                    || static_cast<UINT32>(detail::CountBits(entryMask & ~mask)) > maxEdits) {
+                    continue;
+                }
+                m_cCompared++;
+                const char* pch = m_index.m_folded.data() + m_index.m_foldedStarts[i];
+                size_t cch = m_index.m_foldedStarts[i + 1] - m_index.m_foldedStarts[i];
+                UINT32 distance = MyersDistance(peqFolded, cchFolded, pch, cch, maxEdits);
+                if (distance > maxEdits) continue;
+
+                const char* pchWritten = m_index.m_written.data() + m_index.m_writtenStarts[i];
+                size_t cchEntryWritten = m_index.m_writtenStarts[i + 1] - m_index.m_writtenStarts[i];
+                Candidate candidate = { m_index.m_entryIds[i], distance,
+                    MyersDistance(peqWritten, cchWritten, pchWritten, cchEntryWritten, kMaxFuzzyPinyinLength) };
+                m_candidates.push_back(candidate);
+            }
+        }
+
+        auto better = [](const Candidate& a, const Candidate& b) {
+            return a.distance != b.distance ? a.distance < b.distance
+                : a.writtenDistance != b.writtenDistance ? a.writtenDistance < b.writtenDistance
+                : a.entryId < b.entryId;
+        };
+        size_t cResults = (std::min)(cMaxResults, m_candidates.size());
+        std::partial_sort(m_candidates.begin(), m_candidates.begin() + cResults, m_candidates.end(), better);
+        results.clear();
+        for (size_t i = 0; i < cResults; ++i) {
+            FuzzyMatch match = { m_candidates[i].entryId, m_candidates[i].distance };
+            results.push_back(match);
+        }
+    }
+
+    // Entries of the last search that passed the filters and whose
+    // distance was computed.
+    size_t ComparedEntries() const { return m_cCompared; }
+
+private:
+    Searcher(const Searcher&) = delete;
+    Searcher& operator=(const Searcher&) = delete;
+
+    struct Candidate
+    {
+        UINT32 entryId;
+        UINT32 distance;            // folded
+        UINT32 writtenDistance;
+    };
+
+    const FuzzyPinyinIndex& m_index;
+    std::vector<Candidate> m_candidates;
+    size_t m_cCompared;
+};
+
+
+} // namespace cedict
@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// HeadwordIndex.h -- Hash index from a key string (e.g. the traditional
+//                    headword) to the ids of the entries that have it.
+//
+// Open addressing with linear probing: each slot keeps the hash of its key
+// next to the id of the first entry with that key, so that most probes of
+// other keys are rejected without touching the strings. Entries sharing the
+// same key (e.g. one headword with several readings) are chained by id.
+//
+// FindBatch() resolves many keys at once by group prefetching: each stage
+// (slot, key span, key characters) is done for the whole group before the
+// next one, after prefetching what the next stage reads, so that the cache
+// misses of the group overlap instead of being paid one after the other.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <xmmintrin.h>  // for _mm_prefetch
+#include <algorithm>
+#include <vector>
+#include "TaskScheduler.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+const UINT32 kNoEntry = 0xFFFFFFFF;
+
+
+template <typename Char>
+class HeadwordIndex
+{
+public:
+    typedef TextSpan<Char> Key;
+
+    HeadwordIndex() : m_mask(0) {}
+
+    // keys[id] is the key of entry id. Their characters must outlive the
+    // index. With a scheduler, the keys are hashed in parallel; the slots
+    // are then filled by the calling thread.
+    void Build(std::vector<Key> keys, TaskScheduler* pScheduler = nullptr);
+
+    // Id of the first entry whose key is key, or kNoEntry.
+    UINT32 Find(const Key& key) const;
+
+    // Same, for a key whose HashSpan() is already known.
+    UINT32 Find(const Key& key, UINT32 hash) const
+    {
+        return m_slots.empty() ? kNoEntry : FindFrom(key, hash, hash & m_mask);
+    }
+
+    // ids[i] = Find(keys[i]) for the count keys, with the memory accesses of
+    // up to kBatchGroup lookups overlapped.
+    void FindBatch(const Key* keys, size_t count, UINT32* ids) const;
+
+    static const size_t kBatchGroup = 128;
+    static const size_t kMinBatchGroup = 4;
+    static const size_t kHashPiece = 16 * 1024;     // keys per task of Build()
+
+    // Id of the next entry with the same key as entry id, or kNoEntry.
+    UINT32 Next(UINT32 id) const { return m_next[id]; }
+
+    bool Empty() const { return m_slots.empty(); }
+
+    // Memory held by the index (not counting the key characters).
+    size_t Bytes() const
+    {
+        return m_slots.capacity() * sizeof(Slot) + m_keys.capacity() * sizeof(Key)
+            + m_next.capacity() * sizeof(UINT32);
+    }
+
+private:
+    // Find() from slot s on, for a key of the given hash.
+    UINT32 FindFrom(const Key& key, UINT32 hash, UINT32 s) const;
+
+    struct Slot
+    {
+        UINT32 hash;
+        UINT32 id;      // kNoEntry for empty slots
+    };
+
+    std::vector<Slot> m_slots;
+    UINT32 m_mask;              // m_slots.size() - 1
+    std::vector<Key> m_keys;
+    std::vector<UINT32> m_next;
+};
+
+
+template <typename Char>
+void HeadwordIndex<Char>::Build(std::vector<Key> keys, TaskScheduler* pScheduler)
+{
+    m_keys.swap(keys);
+    m_next.assign(m_keys.size(), kNoEntry);
+
+    // Hashing reads the characters of every key, scattered over the string
+    // storage: that is most of the misses of the build, and it splits.
+    std::vector<UINT32> hashes(m_keys.size());
+    ParallelFor(pScheduler, 0, m_keys.size(), kHashPiece, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) hashes[i] = HashSpan(m_keys[i]);
+    });
+
+    // Keep the load factor at or below 50%.
+    size_t cSlots = 16;
+    while (cSlots < 2 * m_keys.size()) cSlots *= 2;
+    Slot empty = { 0, kNoEntry };
+    m_slots.assign(cSlots, empty);
+    m_mask = static_cast<UINT32>(cSlots - 1);
+
+    // Walk the entries backwards, so that each chain ends up in id order.
+    for (size_t i = m_keys.size(); i-- > 0; ) {
+        UINT32 id = static_cast<UINT32>(i);
+        UINT32 hash = hashes[i];
+        for (UINT32 s = hash & m_mask; ; s = (s + 1) & m_mask) {
+            Slot& slot = m_slots[s];
+            if (slot.id == kNoEntry) {
+                slot.hash = hash;
+                slot.id = id;
+                break;
+            }
+            if (slot.hash == hash && m_keys[slot.id] == m_keys[i]) {
+                m_next[id] = slot.id;
+                slot.id = id;
+                break;
+            }
+        }
+    }
+}
+
+template <typename Char>
+UINT32 HeadwordIndex<Char>::Find(const Key& key) const
+{
+    if (m_slots.empty()) return kNoEntry;
+
+    UINT32 hash = HashSpan(key);
+    return FindFrom(key, hash, hash & m_mask);
+}
+
+template <typename Char>
+UINT32 HeadwordIndex<Char>::FindFrom(const Key& key, UINT32 hash, UINT32 s) const
+{
+    for (; ; s = (s + 1) & m_mask) {
+        const Slot& slot = m_slots[s];
+        if (slot.id == kNoEntry) return kNoEntry;
+        if (slot.hash == hash && m_keys[slot.id] == key) return slot.id;
+    }
+}
+
+template <typename Char>
+const size_t HeadwordIndex<Char>::kBatchGroup;
+
+template <typename Char>
+const size_t HeadwordIndex<Char>::kMinBatchGroup;
+
+template <typename Char>
+void HeadwordIndex<Char>::FindBatch(const Key* keys, size_t count, UINT32* ids) const
+{
+    // With a few keys, there is little to overlap, and the out-of-order
+    // core already runs ahead into the next Find(): the stages would only
+    // add work.
+    if (count < kMinBatchGroup || m_slots.empty()) {
+        for (size_t i = 0; i < count; ++i) ids[i] = Find(keys[i]);
+        return;
+    }
+
+    UINT32 hashes[kBatchGroup];
+    UINT32 slots[kBatchGroup];
+    for (size_t iGroup = 0; iGroup < count; iGroup += kBatchGroup) {
+        const size_t c = (std::min)(kBatchGroup, count - iGroup);
+        const Key* groupKeys = keys + iGroup;
+        UINT32* groupIds = ids + iGroup;
+
+        // Hash the keys and prefetch their home slots.
+        for (size_t i = 0; i < c; ++i) {
+            hashes[i] = HashSpan(groupKeys[i]);
+            _mm_prefetch(reinterpret_cast<const char*>(&m_slots[hashes[i] & m_mask]), _MM_HINT_T0);
+        }
+
+        // Find the first slot with the same hash (or the empty slot that ends
+        // the probe) and prefetch the key span of its entry.
+        for (size_t i = 0; i < c; ++i) {
+            UINT32 s = hashes[i] & m_mask;
+            while (m_slots[s].id != kNoEntry && m_slots[s].hash != hashes[i]) s = (s + 1) & m_mask;
+            slots[i] = s;
+            groupIds[i] = m_slots[s].id;
+            if (groupIds[i] != kNoEntry) {
+                _mm_prefetch(reinterpret_cast<const char*>(&m_keys[groupIds[i]]), _MM_HINT_T0);
+            }
+        }
+
+        // Prefetch the characters of the candidate keys.
+        for (size_t i = 0; i < c; ++i) {
+            if (groupIds[i] != kNoEntry) {
+                _mm_prefetch(reinterpret_cast<const char*>(m_keys[groupIds[i]].pchBegin), _MM_HINT_T0);
+            }
+        }
+
+        // Compare; on a hash collision, go on probing the usual way.
+        for (size_t i = 0; i < c; ++i) {
+            if (groupIds[i] != kNoEntry && m_keys[groupIds[i]] != groupKeys[i]) {
+                groupIds[i] = FindFrom(groupKeys[i], hashes[i], (slots[i] + 1) & m_mask);
+            }
+        }
+    }
+}
+
+
+} // namespace cedict
@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// InputPolicies.h -- How the dictionary file is read.
+//
+// An input policy is constructed from the dictionary file name and hands
+// every line of the file, still UTF-8 encoded and without the trailing '\n',
+// to a callback:
+//
+//     template <typename LineHandler>
+//     void ForEachLine(LineHandler handler);  // handler(pchBegin, pchEnd)
+//
+// Policies that can look at the whole file before reading it also run the
+// counting pass used by the two-pass load (see TextScan.h):
+//
+//     bool Scan(TextScanResult& result);      // false if not supported
+//
+// and the UTF-8 validation of the whole file (see Utf8Validation.h), which
+// calls handler(ibOffset, iLine) for each line holding invalid UTF-8:
+//
+//     template <typename InvalidLineHandler>
+//     bool ValidateUtf8(InvalidLineHandler handler);  // false if not supported
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include "MappedTextFile.h"
+#include "TextScan.h"
+#include "Utf8Validation.h"
+
+
+namespace cedict
+{
+
+
+//------------------------------------------------------------------------------
+// Reads the file line by line with C++ standard I/O streams (V1).
+//------------------------------------------------------------------------------
+class StreamInput
+{
+public:
+    explicit StreamInput(LPCTSTR pszFile)
+        : m_src(pszFile, std::ios::in | std::ios::binary)
+    {}
+
+    template <typename LineHandler>
+    void ForEachLine(LineHandler handler)
+    {
+        std::string s;
+        while (std::getline(m_src, s)) {
+            handler(s.data(), s.data() + s.length());
+        }
+    }
+
+    bool Scan(TextScanResult&) { return false; }
+
+    template <typename InvalidLineHandler>
+    bool ValidateUtf8(InvalidLineHandler) { return false; }
+
+private:
+    std::ifstream m_src;
+};
+
+
+//------------------------------------------------------------------------------
+// Maps the whole file in memory and splits it at '\n' (V2 and later).
+//------------------------------------------------------------------------------
+class MappedFileInput
+{
+public:
+    explicit MappedFileInput(LPCTSTR pszFile)
+        : m_mtf(pszFile)
+    {}
+
+    template <typename LineHandler>
+    void ForEachLine(LineHandler handler)
+    {
+        const CHAR* pchBuf = m_mtf.Buffer();
+        const CHAR* pchEnd = pchBuf + m_mtf.Length();
+        while (pchBuf < pchEnd) {
+            const CHAR* pchEOL = std::find(pchBuf, pchEnd, '\n');
+            handler(pchBuf, pchEOL);
+            pchBuf = pchEOL + 1;
+        }
+    }
+
+    bool Scan(TextScanResult& result)
+    {
+        result = ScanText(m_mtf.Buffer(), m_mtf.Length());
+        return true;
+    }
+
+    template <typename InvalidLineHandler>
+    bool ValidateUtf8(InvalidLineHandler handler)
+    {
+        // Invalid lines are rare: count the line numbers only for them.
+        const CHAR* pchBuf = m_mtf.Buffer();
+        const CHAR* pchCounted = pchBuf;
+        size_t iLine = 1;
+        ValidateUtf8Lines(pchBuf, m_mtf.Length(),
+            [&](const CHAR* pchBegin, const CHAR*) {
+                iLine += std::count(pchCounted, pchBegin, '\n');
+                pchCounted = pchBegin;
+                handler(static_cast<size_t>(pchBegin - pchBuf), iLine);
+            });
+        return true;
+    }
+
+private:
+    MappedTextFile m_mtf;
+};
+
+
+} // namespace cedict
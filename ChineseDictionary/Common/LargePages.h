@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// LargePages.h -- Page-granular allocations, optionally backed by large
+//                 (2 MB on x86/x64) pages to cut TLB misses on random access.
+//
+// Large pages need the "Lock pages in memory" user right (SeLockMemoryPrivilege):
+// when it is missing, or no large pages are left, the allocations silently
+// fall back to regular pages.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <cstddef>
+#include <new>      // for std::bad_alloc
+
+
+namespace cedict
+{
+
+
+namespace detail
+{
+
+inline bool EnableLockMemoryPrivilege()
+{
+    HANDLE hToken = NULL;
+    if (!OpenProcessToken(GetCurrentProcess(),
+            TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken)) {
+        return false;
+    }
+
+    TOKEN_PRIVILEGES tp = {};
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool fEnabled = false;
+    if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid)) {
+        // AdjustTokenPrivileges succeeds even if the privilege is not held:
+        // ERROR_NOT_ALL_ASSIGNED tells the difference.
+        fEnabled = AdjustTokenPrivileges(hToken, FALSE, &tp, 0, NULL, NULL)
+            && GetLastError() == ERROR_SUCCESS;
+    }
+    CloseHandle(hToken);
+    return fEnabled;
+}
+
+} // namespace detail
+
+
+// True if the process can allocate large pages.
+// The privilege is enabled the first time this is called.
+inline bool LargePagesAvailable()
+{
+    static const bool fAvailable =
+        GetLargePageMinimum() != 0 && detail::EnableLockMemoryPrivilege();
+    return fAvailable;
+}
+
+
+// Commit at least cb bytes of read/write memory, on large pages if
+// fLargePages is set and they are available, on regular pages otherwise.
+// Returns NULL on failure; *pcbAlloc receives the size actually committed
+// and *pfLarge whether large pages were used.
+inline void* AllocPages(SIZE_T cb, bool fLargePages, SIZE_T* pcbAlloc, bool* pfLarge)
+{
+    if (fLargePages && LargePagesAvailable()) {
+        SIZE_T cbLarge = GetLargePageMinimum();
+        SIZE_T cbAlloc = (cb + cbLarge - 1) / cbLarge * cbLarge;
+        void* p = VirtualAlloc(NULL, cbAlloc,
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p) {
+            *pcbAlloc = cbAlloc;
+            *pfLarge = true;
+            return p;
+        }
+    }
+
+    void* p = VirtualAlloc(NULL, cb, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    *pcbAlloc = cb;
+    *pfLarge = false;
+    return p;
+}
+
+inline void FreePages(void* p)
+{
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
+
+//------------------------------------------------------------------------------
+// STL allocator that puts big blocks (e.g. the entry vector) on large pages.
+// With large pages off, or for blocks smaller than kMinPageBlock, it just
+// forwards to operator new.
+//------------------------------------------------------------------------------
+template <typename T>
+class PageAllocator
+{
+public:
+    typedef T value_type;
+
+    enum { kMinPageBlock = 1024 * 1024 };
+
+    explicit PageAllocator(bool fLargePages = false) noexcept
+        : m_fLargePages(fLargePages)
+    {}
+
+    template <typename U>
+    PageAllocator(const PageAllocator<U>& other) noexcept
+        : m_fLargePages(other.LargePages())
+    {}
+
+    T* allocate(size_t n)
+    {
+        size_t cb = n * sizeof(T);
+        if (!UsePages(cb)) {
+            return static_cast<T*>(::operator new(cb));
+        }
+
+        SIZE_T cbAlloc;
+        bool fLarge;
+        void* p = AllocPages(cb, true, &cbAlloc, &fLarge);
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (UsePages(n * sizeof(T))) {
+            FreePages(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    bool LargePages() const noexcept { return m_fLargePages; }
+
+private:
+    // The same test picks the allocation and the deallocation path.
+    bool UsePages(size_t cb) const { return m_fLargePages && cb >= kMinPageBlock; }
+
+    bool m_fLargePages;
+};
+
+template <typename T, typename U>
+bool operator==(const PageAllocator<T>& a, const PageAllocator<U>& b)
+{
+    return a.LargePages() == b.LargePages();
+}
+
+template <typename T, typename U>
+bool operator!=(const PageAllocator<T>& a, const PageAllocator<U>& b)
+{
+    return !(a == b);
+}
+
+
+} // namespace cedict
@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// LoadTrace.h -- Per-thread timeline of the loader phases, written in the
+//                Chrome trace event format (chrome://tracing, Perfetto).
+//
+// The loader marks its phases with TraceScope objects: opening the file,
+// UTF-8 validation, the scan of the two-pass load, the transcoding and the
+// parsing of each line, the growth of the entry vector, the string pool
+// chunks, and the structures built after loading. While the Tracer is
+// stopped (the default), a scope costs a load and a branch. Once started,
+// each thread appends its events to a ring buffer of its own, without any
+// lock or shared write; the buffers are only read by WriteChromeTrace().
+//
+//     cedict::Tracer::Start();
+//     Dictionary dict(TEXT("cedict.u8"));
+//     cedict::Tracer::Stop();
+//     cedict::Tracer::WriteChromeTrace("cedict-trace.json");
+//
+// Start(), Stop() and WriteChromeTrace() must not run while traced code
+// does on other threads.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace cedict
+{
+
+
+struct TraceEvent
+{
+    const char* pszName;    // a string literal: only the pointer is kept
+    LONGLONG qpcBegin;
+    LONGLONG qpcEnd;
+};
+
+
+inline LONGLONG TraceClock()
+{
+    LARGE_INTEGER li;
+    QueryPerformanceCounter(&li);
+    return li.QuadPart;
+}
+
+
+// The last kCapacity events of a thread.
+class TraceBuffer
+{
+public:
+    enum { kCapacity = 256 * 1024 };    // a power of 2
+
+    TraceBuffer(DWORD tid, const char* pszThreadName)
+        : m_events(kCapacity), m_cAdded(0), m_tid(tid), m_pszThreadName(pszThreadName)
+    {}
+
+    void Add(const char* pszName, LONGLONG qpcBegin, LONGLONG qpcEnd)
+    {
+        TraceEvent& e = m_events[m_cAdded++ & (kCapacity - 1)];
+        e.pszName = pszName;
+        e.qpcBegin = qpcBegin;
+        e.qpcEnd = qpcEnd;
+    }
+
+    size_t Size() const { return (std::min)(m_cAdded, static_cast<size_t>(kCapacity)); }
+    size_t Dropped() const { return m_cAdded - Size(); }
+
+    // Event i, oldest first.
+    const TraceEvent& At(size_t i) const
+    {
+        return m_events[(m_cAdded - Size() + i) & (kCapacity - 1)];
+    }
+
+    DWORD ThreadId() const { return m_tid; }
+    const char* ThreadName() const { return m_pszThreadName; }
+
+private:
+    std::vector<TraceEvent> m_events;
+    size_t m_cAdded;
+    DWORD m_tid;
+    const char* m_pszThreadName;
+};
+
+
+namespace detail
+{
+
+// State of the Tracer, in a class template so that the header can define it.
+template <typename T>
+struct TraceState
+{
+    static std::atomic<bool> s_fEnabled;
+    static unsigned s_generation;
+    static LONGLONG s_qpcStart;
+    static std::mutex s_mutex;                              // guards s_buffers
+    static std::vector<std::unique_ptr<TraceBuffer>> s_buffers;
+    static thread_local TraceBuffer* t_pBuffer;        // valid if t_generation is current
+    static thread_local unsigned t_generation;
+    static thread_local const char* t_pszThreadName;
+};
+
+template <typename T> std::atomic<bool> TraceState<T>::s_fEnabled(false);
+template <typename T> unsigned TraceState<T>::s_generation = 0;
+template <typename T> LONGLONG TraceState<T>::s_qpcStart = 0;
+template <typename T> std::mutex TraceState<T>::s_mutex;
+template <typename T> std::vector<std::unique_ptr<TraceBuffer>> TraceState<T>::s_buffers;
+template <typename T> thread_local TraceBuffer* TraceState<T>::t_pBuffer = nullptr;
+template <typename T> thread_local unsigned TraceState<T>::t_generation = 0;
+template <typename T> thread_local const char* TraceState<T>::t_pszThreadName = nullptr;
+
+} // namespace detail
+
+
+class Tracer
+{
+public:
+    // Drop the events of the previous trace, if any, and start recording.
+    static void Start()
+    {
+        {
+            std::lock_guard<std::mutex> lock(State::s_mutex);
+            State::s_buffers.clear();
+            State::s_generation++;
+            State::s_qpcStart = TraceClock();
+        }
+        State::s_fEnabled.store(true, std::memory_order_release);
+    }
+
+    static void Stop() { State::s_fEnabled.store(false, std::memory_order_release); }
+
+    static bool Enabled() { return State::s_fEnabled.load(std::memory_order_relaxed); }
+
+    static void Record(const char* pszName, LONGLONG qpcBegin, LONGLONG qpcEnd)
+    {
+        ThreadBuffer().Add(pszName, qpcBegin, qpcEnd);
+    }
+
+    // Name of the calling thread in the trace (a string literal). Takes
+    // effect at the first event of the thread in a trace, so it may be
+    // called before the Tracer is started.
+    static void SetThreadName(const char* pszName) { State::t_pszThreadName = pszName; }
+
+    // Events recorded, and dropped as their buffer wrapped around.
+    static size_t EventCount() { return Count(&TraceBuffer::Size); }
+    static size_t DroppedCount() { return Count(&TraceBuffer::Dropped); }
+
+    // Write the events as complete ("X") events, one track per thread, with
+    // the times in microseconds from Start().
+    static bool WriteChromeTrace(const char* pszFile);
+
+private:
+    typedef detail::TraceState<void> State;
+
+    static TraceBuffer& ThreadBuffer()
+    {
+        // Start() frees the buffers of the previous trace.
+        if (State::t_generation != State::s_generation) {
+            std::lock_guard<std::mutex> lock(State::s_mutex);
+            State::s_buffers.emplace_back(new TraceBuffer(GetCurrentThreadId(), State::t_pszThreadName));
+            State::t_pBuffer = State::s_buffers.back().get();
+            State::t_generation = State::s_generation;
+        }
+        return *State::t_pBuffer;
+    }
+
+    static size_t Count(size_t (TraceBuffer::*pfn)() const)
+    {
+        std::lock_guard<std::mutex> lock(State::s_mutex);
+        size_t c = 0;
+        for (const auto& pBuffer : State::s_buffers) c += ((*pBuffer).*pfn)();
+        return c;
+    }
+};
+
+
+inline bool Tracer::WriteChromeTrace(const char* pszFile)
+{
+    std::lock_guard<std::mutex> lock(State::s_mutex);
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double usPerTick = 1e6 / static_cast<double>(frequency.QuadPart);
+    const DWORD pid = GetCurrentProcessId();
+
+    std::ofstream out(pszFile, std::ios::out | std::ios::binary);
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const char* pszSeparator = "\n";
+    for (const auto& pBuffer : State::s_buffers) {
+        if (pBuffer->ThreadName()) {
+            out << pszSeparator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << pBuffer->ThreadId()
+                << ",\"args\":{\"name\":\"" << pBuffer->ThreadName() << "\"}}";
+            pszSeparator = ",\n";
+        }
+        for (size_t i = 0; i < pBuffer->Size(); ++i) {
+            const TraceEvent& e = pBuffer->At(i);
+            out << pszSeparator << "{\"name\":\"" << e.pszName << "\",\"ph\":\"X\",\"pid\":" << pid
+                << ",\"tid\":" << pBuffer->ThreadId()
+                << ",\"ts\":" << (e.qpcBegin - State::s_qpcStart) * usPerTick
+                << ",\"dur\":" << (e.qpcEnd - e.qpcBegin) * usPerTick << '}';
+            pszSeparator = ",\n";
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+
+// Records an event from its construction to End() or its destruction,
+// if the Tracer is started when it is constructed.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* pszName)
+        : m_pszName(Tracer::Enabled() ? pszName : nullptr)
+        , m_qpcBegin(m_pszName ? TraceClock() : 0)
+    {}
+
+    ~TraceScope() { End(); }
+
+    void End()
+    {
+        if (!m_pszName) return;
+        Tracer::Record(m_pszName, m_qpcBegin, TraceClock());
+        m_pszName = nullptr;
+    }
+
+private:
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    const char* m_pszName;
+    LONGLONG m_qpcBegin;
+};
+
+
+} // namespace cedict
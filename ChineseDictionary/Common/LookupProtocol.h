@@ -0,0 +1,166 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// LookupProtocol.h -- Binary protocol of the dictionary server (see
+//                     DictionaryServer), over a local named pipe.
+//
+// The server loads the dictionary once, and the processes that used to
+// embed it send it their lookups. A client writes requests and reads the
+// responses in the same order; it may write many requests before reading
+// (pipelining), and the server answers all the requests it has read at
+// once in one batch, with a single write.
+//
+// Both ends are on the same machine, so the integers are in its byte
+// order, and the text is in UTF-16 code units, as in the dictionary:
+//
+//     request:   RequestHeader, then cchKey code units of the key
+//     response:  ResponseHeader, then cEntries entries of 4 fields
+//                (traditional, simplified, pinyin, English), each a
+//                UINT16 length followed by the code units
+//
+// A request with an unknown field gets an empty response; a key longer
+// than kMaxKeyLength ends the connection.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <cstring>      // for memcpy
+#include <vector>
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+const WCHAR kLookupPipeName[] = L"\\\\.\\pipe\\cedict-lookup";
+
+// The field a request looks up (see Dictionary::Find and FieldIndex.h).
+enum LookupField
+{
+    kLookupTraditional,
+    kLookupSimplified,
+    kLookupPinyin,
+    kLookupEnglish,
+    kLookupFieldCount
+};
+
+const size_t kMaxKeyLength = 1024;
+
+// Entries returned per response at most; ResponseHeader::cMatches tells how
+// many there are.
+const size_t kMaxEntriesPerResponse = 8;
+
+#pragma pack(push, 1)
+
+struct RequestHeader
+{
+    UINT8 field;        // a LookupField
+    UINT8 reserved;
+    UINT16 cchKey;
+};
+
+struct ResponseHeader
+{
+    UINT32 cbBody;      // bytes of the entries that follow
+    UINT16 cMatches;    // entries with the key, up to 0xFFFF
+    UINT16 cEntries;    // entries that follow
+};
+
+#pragma pack(pop)
+
+
+// Append a request to a buffer of outgoing bytes.
+inline void AppendRequest(std::vector<BYTE>& out, LookupField field, const TextSpan<WCHAR>& key)
+{
+    RequestHeader header = { static_cast<UINT8>(field), 0, static_cast<UINT16>(key.Length()) };
+    size_t ib = out.size();
+    out.resize(ib + sizeof(header) + key.Length() * sizeof(WCHAR));
+    memcpy(&out[ib], &header, sizeof(header));
+    if (!key.Empty()) memcpy(&out[ib + sizeof(header)], key.pchBegin, key.Length() * sizeof(WCHAR));
+}
+
+// Size of the request (or response) at the start of [pb, pb + cb), or 0 if
+// it is not all there yet.
+inline size_t RequestSize(const BYTE* pb, size_t cb)
+{
+    if (cb < sizeof(RequestHeader)) return 0;
+    RequestHeader header;
+    memcpy(&header, pb, sizeof(header));
+    size_t cbRequest = sizeof(header) + header.cchKey * sizeof(WCHAR);
+    return cb < cbRequest ? 0 : cbRequest;
+}
+
+inline size_t ResponseSize(const BYTE* pb, size_t cb)
+{
+    if (cb < sizeof(ResponseHeader)) return 0;
+    ResponseHeader header;
+    memcpy(&header, pb, sizeof(header));
+    size_t cbResponse = sizeof(header) + header.cbBody;
+    return cb < cbResponse ? 0 : cbResponse;
+}
+
+// The header of the request at pb; key is set to its key, which points
+// into the request (check that it is complete with RequestSize()).
+inline RequestHeader ReadRequest(const BYTE* pb, TextSpan<WCHAR>& key)
+{
+    RequestHeader header;
+    memcpy(&header, pb, sizeof(header));
+    const WCHAR* pchKey = reinterpret_cast<const WCHAR*>(pb + sizeof(header));
+    key = MakeSpan(pchKey, pchKey + header.cchKey);
+    return header;
+}
+
+// Builds a response in a buffer of outgoing bytes.
+class ResponseWriter
+{
+public:
+    ResponseWriter(std::vector<BYTE>& out, size_t cMatches)
+        : m_out(out), m_ibHeader(out.size()), m_cEntries(0)
+    {
+        m_out.resize(m_ibHeader + sizeof(ResponseHeader));
+        m_header.cbBody = 0;
+        m_header.cMatches = static_cast<UINT16>(cMatches < 0xFFFF ? cMatches : 0xFFFF);
+        m_header.cEntries = 0;
+    }
+
+    ~ResponseWriter()
+    {
+        m_header.cbBody = static_cast<UINT32>(m_out.size() - m_ibHeader - sizeof(ResponseHeader));
+        m_header.cEntries = static_cast<UINT16>(m_cEntries);
+        memcpy(&m_out[m_ibHeader], &m_header, sizeof(m_header));
+    }
+
+    void AddEntry(const TextSpan<WCHAR>& trad, const TextSpan<WCHAR>& simp,
+        const TextSpan<WCHAR>& pinyin, const TextSpan<WCHAR>& english)
+    {
+        AddField(trad);
+        AddField(simp);
+        AddField(pinyin);
+        AddField(english);
+        m_cEntries++;
+    }
+
+private:
+    ResponseWriter(const ResponseWriter&) = delete;
+    ResponseWriter& operator=(const ResponseWriter&) = delete;
+
+    void AddField(const TextSpan<WCHAR>& field)
+    {
+        UINT16 cch = static_cast<UINT16>(field.Length() < 0xFFFF ? field.Length() : 0xFFFF);
+        size_t ib = m_out.size();
+        m_out.resize(ib + sizeof(cch) + cch * sizeof(WCHAR));
+        memcpy(&m_out[ib], &cch, sizeof(cch));
+        if (cch) memcpy(&m_out[ib + sizeof(cch)], field.pchBegin, cch * sizeof(WCHAR));
+    }
+
+    std::vector<BYTE>& m_out;
+    size_t m_ibHeader;
+    ResponseHeader m_header;
+    size_t m_cEntries;
+};
+
+
+} // namespace cedict
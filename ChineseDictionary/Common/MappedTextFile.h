@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// MappedTextFile.h -- Read-only memory-mapped view of a whole text file.
+//
+// Based on:
+//
+// Loading the dictionary, part 3: Breaking the text into lines
+// https://blogs.msdn.microsoft.com/oldnewthing/20050513-26/?p=35643
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+
+
+namespace cedict
+{
+
+
+class MappedTextFile
+{
+public:
+    MappedTextFile(LPCTSTR pszFile);
+    ~MappedTextFile();
+
+    const CHAR *Buffer() const { return m_p; }
+    DWORD Length() const { return m_cb; }
+
+private:
+    MappedTextFile(const MappedTextFile&) = delete;
+    MappedTextFile& operator=(const MappedTextFile&) = delete;
+
+    PCHAR   m_p;
+    DWORD   m_cb;
+    HANDLE  m_hf;
+    HANDLE  m_hfm;
+};
+
+inline MappedTextFile::MappedTextFile(LPCTSTR pszFile)
+    : m_p(NULL), m_cb(0), m_hfm(NULL)
+{
+    m_hf = CreateFile(pszFile, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_hf != INVALID_HANDLE_VALUE) {
+        DWORD cb = GetFileSize(m_hf, NULL);
+        m_hfm = CreateFileMapping(m_hf, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_hfm != NULL) {
+            m_p = reinterpret_cast<PCHAR>
+                (MapViewOfFile(m_hfm, FILE_MAP_READ, 0, 0, cb));
+            if (m_p) {
+                m_cb = cb;
+            }
+        }
+    }
+}
+
+inline MappedTextFile::~MappedTextFile()
+{
+    if (m_p) UnmapViewOfFile(m_p);
+    if (m_hfm) CloseHandle(m_hfm);
+    if (m_hf != INVALID_HANDLE_VALUE) CloseHandle(m_hf);
+}
+
+
+} // namespace cedict
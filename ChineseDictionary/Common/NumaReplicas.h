@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// NumaReplicas.h -- One read-only copy of the dictionary per NUMA node.
+//
+// Each replica is loaded by a thread pinned to its node, so that the entries,
+// the strings and the index land in that node's memory (Windows backs pages
+// with memory of the node of the thread that first touches them). Lookup
+// threads pinned to a node then use the replica of their node, and never pay
+// for remote memory accesses.
+//
+// On single-node machines there is just one replica, loaded on the calling
+// thread as a plain Dictionary would be.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "DictionaryOptions.h"
+#include "LoadTrace.h"
+
+
+namespace cedict
+{
+
+
+// NUMA nodes that have at least one processor, in node number order.
+inline std::vector<USHORT> NumaNodesWithProcessors()
+{
+    std::vector<USHORT> nodes;
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode)) {
+        nodes.push_back(0);
+        return nodes;
+    }
+    for (ULONG node = 0; node <= highestNode; ++node) {
+        GROUP_AFFINITY affinity = {};
+        if (GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)
+                && affinity.Mask != 0) {
+            nodes.push_back(static_cast<USHORT>(node));
+        }
+    }
+    if (nodes.empty()) nodes.push_back(0);
+    return nodes;
+}
+
+// Restrict the calling thread to the processors of a NUMA node.
+inline bool PinThreadToNode(USHORT node)
+{
+    GROUP_AFFINITY affinity = {};
+    if (!GetNumaNodeProcessorMaskEx(node, &affinity)) return false;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != FALSE;
+}
+
+// NUMA node of the processor the calling thread is running on.
+inline USHORT CurrentNumaNode()
+{
+    PROCESSOR_NUMBER processor = {};
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node = 0;
+    if (!GetNumaProcessorNodeEx(&processor, &node)) return 0;
+    return node;
+}
+
+
+template <typename Dictionary>
+class NumaReplicatedDictionary
+{
+public:
+    // Loads one replica per NUMA node with processors, concurrently.
+    NumaReplicatedDictionary(LPCTSTR pszFile, const DictionaryOptions& options);
+
+    size_t ReplicaCount() const { return m_replicas.size(); }
+    const Dictionary& Replica(size_t i) const { return *m_replicas[i]; }
+    USHORT ReplicaNode(size_t i) const { return m_nodes[i]; }
+
+    // Replica of a node; nodes without processors get the first replica.
+    const Dictionary& ForNode(USHORT node) const
+    {
+        size_t i = node < m_nodeToReplica.size() ? m_nodeToReplica[node] : 0;
+        return *m_replicas[i];
+    }
+
+    // Replica of the node the calling thread runs on. Meant to be called
+    // once by a lookup thread pinned to a node (see PinThreadToNode), as it
+    // queries the current processor.
+    const Dictionary& Local() const { return ForNode(CurrentNumaNode()); }
+
+private:
+    NumaReplicatedDictionary(const NumaReplicatedDictionary&) = delete;
+    NumaReplicatedDictionary& operator=(const NumaReplicatedDictionary&) = delete;
+
+    std::vector<std::unique_ptr<Dictionary>> m_replicas;
+    std::vector<USHORT> m_nodes;            // node of each replica
+    std::vector<size_t> m_nodeToReplica;    // replica of each node number
+};
+
+
+template <typename Dictionary>
+NumaReplicatedDictionary<Dictionary>::NumaReplicatedDictionary(
+    LPCTSTR pszFile, const DictionaryOptions& options)
+    : m_nodes(NumaNodesWithProcessors())
+{
+    m_nodeToReplica.assign(m_nodes.back() + 1, 0);
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        m_nodeToReplica[m_nodes[i]] = i;
+    }
+
+    m_replicas.resize(m_nodes.size());
+    if (m_nodes.size() == 1) {
+        m_replicas[0].reset(new Dictionary(pszFile, options));
+        return;
+    }
+
+    // The indexes are built by the pinned loaders too: task workers would
+    // not be pinned, and would put them in the memory of any node.
+    DictionaryOptions replicaOptions(options);
+    replicaOptions.buildThreads = 1;
+    std::vector<std::exception_ptr> errors(m_nodes.size());
+    std::vector<std::thread> loaders;
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        loaders.emplace_back([this, i, pszFile, &replicaOptions, &errors]() {
+            try {
+                Tracer::SetThreadName("replica loader");
+                PinThreadToNode(m_nodes[i]);
+                m_replicas[i].reset(new Dictionary(pszFile, replicaOptions));
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& t : loaders) {
+        t.join();
+    }
+    for (auto& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+}
+
+
+} // namespace cedict
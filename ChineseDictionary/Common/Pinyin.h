@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Pinyin.h -- Numbered pinyin to pinyin with tone marks, e.g. "zhong1 guo2"
+//             to "zh\u014Dng gu\u00F3".
+//
+// The placement rule is the usual one: the mark goes on 'a' or 'e' if the
+// syllable has one, on the 'o' of "ou", else on the last vowel. It is written
+// as C++11 constexpr functions, so that the same code classifies characters
+// at run time and builds (and checks, see the static_asserts below) the
+// tables at compile time: the vowel class of every character below 256 and
+// the tone-marked form of each vowel.
+//
+// ConvertPinyin() never allocates: the converted text is never longer than
+// the numbered one (the tone digit goes away, "u:" becomes one character),
+// so it is written to a caller buffer of the same size.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <utility>      // for std::index_sequence
+
+
+namespace cedict
+{
+
+
+namespace detail
+{
+
+// Index of a vowel in kToneMarks, or -1.
+constexpr int PinyinVowelIndex(unsigned ch)
+{
+    return ch == 'a' ? 0 : ch == 'e' ? 1 : ch == 'i' ? 2 : ch == 'o' ? 3 : ch == 'u' ? 4
+        : ch == 0xFC ? 5        // u with diaeresis
+        : ch == 'A' ? 6 : ch == 'E' ? 7 : ch == 'I' ? 8 : ch == 'O' ? 9 : ch == 'U' ? 10
+        : ch == 0xDC ? 11
+        : -1;
+}
+
+// The vowels with tones 1 to 4, in PinyinVowelIndex() order.
+constexpr WCHAR kToneMarks[12][4] = {
+    { 0x0101, 0x00E1, 0x01CE, 0x00E0 },     // a
+    { 0x0113, 0x00E9, 0x011B, 0x00E8 },     // e
+    { 0x012B, 0x00ED, 0x01D0, 0x00EC },     // i
+    { 0x014D, 0x00F3, 0x01D2, 0x00F2 },     // o
+    { 0x016B, 0x00FA, 0x01D4, 0x00F9 },     // u
+    { 0x01D6, 0x01D8, 0x01DA, 0x01DC },     // u with diaeresis
+    { 0x0100, 0x00C1, 0x01CD, 0x00C0 },     // A
+    { 0x0112, 0x00C9, 0x011A, 0x00C8 },     // E
+    { 0x012A, 0x00CD, 0x01CF, 0x00CC },     // I
+    { 0x014C, 0x00D3, 0x01D1, 0x00D2 },     // O
+    { 0x016A, 0x00DA, 0x01D3, 0x00D9 },     // U
+    { 0x01D5, 0x01D7, 0x01D9, 0x01DB },     // U with diaeresis
+};
+
+// Vowel class of each character below 256, generated at compile time.
+struct PinyinVowelTable
+{
+    signed char index[256];
+};
+
+template <size_t... Ch>
+constexpr PinyinVowelTable MakePinyinVowelTable(std::index_sequence<Ch...>)
+{
+    return PinyinVowelTable{ { static_cast<signed char>(PinyinVowelIndex(Ch))... } };
+}
+
+constexpr PinyinVowelTable kPinyinVowels = MakePinyinVowelTable(std::make_index_sequence<256>());
+
+template <typename Char>
+constexpr int VowelOf(Char ch)
+{
+    return static_cast<unsigned>(ch) < 256 ? kPinyinVowels.index[static_cast<unsigned>(ch)] : -1;
+}
+
+template <typename Char>
+constexpr int FindLetter(const Char* pch, int cch, int i, int vowel)
+{
+    // vowel and vowel + 6 are the lower and upper case forms.
+    return i >= cch ? -1
+        : (VowelOf(pch[i]) == vowel || VowelOf(pch[i]) == vowel + 6) ? i
+        : FindLetter(pch, cch, i + 1, vowel);
+}
+
+template <typename Char>
+constexpr int FindOu(const Char* pch, int cch, int i)
+{
+    return i + 1 >= cch ? -1
+        : (VowelOf(pch[i]) % 6 == 3 && VowelOf(pch[i + 1]) % 6 == 4) ? i
+        : FindOu(pch, cch, i + 1);
+}
+
+template <typename Char>
+constexpr int FindLastVowel(const Char* pch, int i)
+{
+    return i < 0 ? -1 : VowelOf(pch[i]) >= 0 ? i : FindLastVowel(pch, i - 1);
+}
+
+constexpr int FirstFound(int i, int j)
+{
+    return i >= 0 ? i : j;
+}
+
+} // namespace detail
+
+
+//------------------------------------------------------------------------------
+// Position of the tone mark in the letters of a syllable (with 'u:' already
+// turned into u with diaeresis), or -1 if the syllable has no vowel.
+//------------------------------------------------------------------------------
+template <typename Char>
+constexpr int ToneMarkIndex(const Char* pch, int cch)
+{
+    return detail::FirstFound(detail::FindLetter(pch, cch, 0, 0),      // a
+        detail::FirstFound(detail::FindLetter(pch, cch, 0, 1),          // e
+        detail::FirstFound(detail::FindOu(pch, cch, 0),                 // ou
+        detail::FindLastVowel(pch, cch - 1))));
+}
+
+static_assert(ToneMarkIndex(L"zhuang", 6) == 3, "'a' takes the mark");
+static_assert(ToneMarkIndex(L"xue", 3) == 2, "'e' takes the mark");
+static_assert(ToneMarkIndex(L"l\u00FCe", 3) == 2, "'e' takes the mark");
+static_assert(ToneMarkIndex(L"shou", 4) == 2, "the 'o' of 'ou' takes the mark");
+static_assert(ToneMarkIndex(L"gui", 3) == 2, "the last vowel takes the mark");
+static_assert(ToneMarkIndex(L"liu", 3) == 2, "the last vowel takes the mark");
+static_assert(ToneMarkIndex(L"xiong", 5) == 2, "the last vowel takes the mark");
+static_assert(ToneMarkIndex(L"Er", 2) == 0, "upper case vowels take the mark too");
+static_assert(ToneMarkIndex(L"m", 1) == -1, "no vowel, no mark");
+static_assert(detail::kToneMarks[detail::PinyinVowelIndex('o')][2] == 0x01D2, "o, third tone");
+
+
+//------------------------------------------------------------------------------
+// Convert numbered pinyin to pinyin with tone marks. Syllables are separated
+// by spaces; a trailing digit 1 to 4 becomes the mark, 5 (neutral tone) is
+// just dropped. Anything else (punctuation, Latin letters, syllables without
+// vowels such as "r5") is copied, less the tone digit.
+// pchDest must have room for (pchEnd - pchBegin) characters; returns the
+// number of characters written.
+//------------------------------------------------------------------------------
+template <typename Char>
+size_t ConvertPinyin(const Char* pchBegin, const Char* pchEnd, Char* pchDest)
+{
+    Char* pchOut = pchDest;
+    const Char* pch = pchBegin;
+    while (pch < pchEnd) {
+        if (*pch == static_cast<Char>(' ')) {
+            *pchOut++ = *pch++;
+            continue;
+        }
+
+        // Copy the letters of the syllable, then place the mark.
+        Char* pchSyllable = pchOut;
+        for (; pch < pchEnd && *pch != static_cast<Char>(' '); ++pch) {
+            Char ch = *pch;
+            if (ch == static_cast<Char>(':') && pchOut > pchSyllable) {
+                Char& prev = pchOut[-1];
+                if (prev == static_cast<Char>('u')) { prev = static_cast<Char>(0xFC); continue; }
+                if (prev == static_cast<Char>('U')) { prev = static_cast<Char>(0xDC); continue; }
+            }
+            *pchOut++ = ch;
+        }
+
+        Char chTone = pchOut > pchSyllable ? pchOut[-1] : static_cast<Char>(0);
+        if (chTone < static_cast<Char>('1') || chTone > static_cast<Char>('5')) continue;
+        --pchOut;
+
+        int tone = static_cast<int>(chTone - static_cast<Char>('1'));
+        int iMark = ToneMarkIndex(pchSyllable, static_cast<int>(pchOut - pchSyllable));
+        if (tone < 4 && iMark >= 0) {
+            Char& chVowel = pchSyllable[iMark];
+            chVowel = static_cast<Char>(detail::kToneMarks[detail::VowelOf(chVowel)][tone]);
+        }
+    }
+    return pchOut - pchDest;
+}
+
+
+} // namespace cedict
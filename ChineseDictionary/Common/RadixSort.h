@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// RadixSort.h -- MSD radix sort of entry ids by a text key of each entry,
+//                e.g. the traditional headword or the pinyin.
+//
+// The ids are sorted, not the entries: 4 bytes move per entry and pass. The
+// order is that of operator< on the keys, and the sort is stable, so that
+// entries with the same key stay in the order they were given in.
+//
+// The keys are read a byte at a time, most significant byte of each code
+// unit first (in the order of OrderedUnit(), see TextSpan.h): one byte per
+// UTF-8 code unit, two per UTF-16 one. A pass over a range of ids reads the
+// byte at the same position of each of their keys (a digit, with 0 for
+// keys that end before it, and which are done), counts the ids of each of
+// the 257 digits, then distributes the ids into those buckets, in order;
+// each bucket is then sorted the same way from the next byte on. The digits
+// of a pass are read from the keys once, into a buffer, so that the count
+// and the distribution go through arrays and only the reads of the keys
+// are scattered. When all the ids of a range have the same digit (keys
+// sharing a prefix), the distribution is skipped. Small ranges are finished
+// by insertion sort.
+//
+// With a scheduler, large ranges are counted and distributed by pieces in
+// parallel (each piece counts its own digits, then writes its ids after
+// those of the pieces before it in each bucket, so the sort stays stable),
+// and the buckets are sorted as tasks of their own: the first byte of
+// Chinese headwords already splits them in about 80 buckets, and the
+// second in thousands.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <cstring>      // for memcpy
+#include <vector>
+#include "TaskScheduler.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+namespace detail
+{
+
+const size_t kRadixDigits = 257;                    // end of key, then the 256 byte values
+const size_t kRadixInsertionSortLimit = 32;         // ids
+const size_t kRadixParallelLimit = 64 * 1024;       // ids
+const size_t kRadixPiece = 16 * 1024;               // ids per task of a parallel pass
+
+// Digit of key at byte iByte: 0 if the key ends before, else 1 + the byte.
+template <typename Char>
+inline UINT32 RadixDigit(const TextSpan<Char>& key, size_t iByte)
+{
+    size_t iUnit = iByte / sizeof(Char);
+    if (iUnit >= key.Length()) return 0;
+    UINT32 unit = static_cast<UINT32>(OrderedUnit(key.pchBegin[iUnit]));
+    return 1 + ((unit >> (8 * (sizeof(Char) - 1 - iByte % sizeof(Char)))) & 0xFF);
+}
+
+// Stable insertion sort of ids[0, n) whose keys share their first iByte
+// bytes; the rest of the keys is compared whole.
+template <typename Char>
+void InsertionSortIds(const TextSpan<Char>* keys, UINT32* ids, size_t n)
+{
+    for (size_t i = 1; i < n; ++i) {
+        UINT32 id = ids[i];
+        size_t j = i;
+        for (; j > 0 && keys[id] < keys[ids[j - 1]]; --j) ids[j] = ids[j - 1];
+        ids[j] = id;
+    }
+}
+
+// Sorts ids[0, n), whose keys share their first iByte bytes. tmp and
+// digits are buffers of n elements.
+template <typename Char>
+void RadixSortRange(const TextSpan<Char>* keys, UINT32* ids, UINT32* tmp, UINT16* digits, size_t n,
+    size_t iByte, TaskScheduler* pScheduler)
+{
+    size_t starts[kRadixDigits + 1];
+    for (;;) {
+        if (n < kRadixInsertionSortLimit) {
+            InsertionSortIds(keys, ids, n);
+            return;
+        }
+        if (pScheduler && pScheduler->ThreadCount() > 1 && n >= kRadixParallelLimit) break;
+
+        size_t counts[kRadixDigits] = {};
+        for (size_t i = 0; i < n; ++i) {
+            UINT32 d = RadixDigit(keys[ids[i]], iByte);
+            digits[i] = static_cast<UINT16>(d);
+            counts[d]++;
+        }
+        if (counts[0] == n) return;                 // all the keys ended: equal
+        UINT32 dFirst = digits[0];
+        if (counts[dFirst] == n) {                  // one more byte in common
+            iByte++;
+            continue;
+        }
+
+        starts[0] = 0;
+        for (size_t d = 0; d < kRadixDigits; ++d) starts[d + 1] = starts[d] + counts[d];
+        size_t next[kRadixDigits];
+        std::copy(starts, starts + kRadixDigits, next);
+        for (size_t i = 0; i < n; ++i) tmp[next[digits[i]]++] = ids[i];
+        memcpy(ids, tmp, n * sizeof(UINT32));
+
+        // Recurse on all the buckets but the largest, and loop on that one,
+        // so that the stack stays shallow.
+        size_t dLargest = 1;
+        for (size_t d = 1; d < kRadixDigits; ++d) {
+            if (counts[d] > counts[dLargest]) dLargest = d;
+        }
+        for (size_t d = 1; d < kRadixDigits; ++d) {
+            if (d != dLargest && counts[d] > 1) {
+                RadixSortRange(keys, ids + starts[d], tmp + starts[d], digits + starts[d], counts[d],
+                    iByte + 1, pScheduler);
+            }
+        }
+        ids += starts[dLargest];
+        tmp += starts[dLargest];
+        digits += starts[dLargest];
+        n = counts[dLargest];
+        iByte++;
+    }
+
+    // A large range: the same pass, by pieces on the threads, then the
+    // buckets as tasks.
+    const size_t cPieces = PieceCount(pScheduler, n, kRadixPiece);
+    std::vector<size_t> pieceNext(cPieces * kRadixDigits, 0);
+    ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+        for (size_t k = kBegin; k < kEnd; ++k) {
+            size_t* counts = &pieceNext[k * kRadixDigits];
+            for (size_t i = PieceStart(n, cPieces, k); i < PieceStart(n, cPieces, k + 1); ++i) {
+                UINT32 d = RadixDigit(keys[ids[i]], iByte);
+                digits[i] = static_cast<UINT16>(d);
+                counts[d]++;
+            }
+        }
+    });
+    starts[0] = 0;
+    for (size_t d = 0; d < kRadixDigits; ++d) {
+        size_t start = starts[d];
+        for (size_t k = 0; k < cPieces; ++k) {
+            size_t count = pieceNext[k * kRadixDigits + d];
+            pieceNext[k * kRadixDigits + d] = start;
+            start += count;
+        }
+        starts[d + 1] = start;
+    }
+    ParallelFor(pScheduler, 0, cPieces, 1, [&](size_t kBegin, size_t kEnd) {
+        for (size_t k = kBegin; k < kEnd; ++k) {
+            size_t* next = &pieceNext[k * kRadixDigits];
+            for (size_t i = PieceStart(n, cPieces, k); i < PieceStart(n, cPieces, k + 1); ++i) {
+                tmp[next[digits[i]]++] = ids[i];
+            }
+        }
+    });
+    ParallelFor(pScheduler, 0, n, kRadixPiece, [&](size_t begin, size_t end) {
+        memcpy(ids + begin, tmp + begin, (end - begin) * sizeof(UINT32));
+    });
+
+    ParallelFor(pScheduler, 1, kRadixDigits, 1, [&](size_t dBegin, size_t dEnd) {
+        for (size_t d = dBegin; d < dEnd; ++d) {
+            size_t count = starts[d + 1] - starts[d];
+            if (count > 1) {
+                RadixSortRange(keys, ids + starts[d], tmp + starts[d], digits + starts[d], count,
+                    iByte + 1, pScheduler);
+            }
+        }
+    });
+}
+
+} // namespace detail
+
+
+// Sorts ids by their keys, keys[id], in the order of operator< and stably.
+// With a scheduler, the sort runs on its threads.
+template <typename Char>
+void RadixSortIds(const std::vector<TextSpan<Char>>& keys, std::vector<UINT32>& ids,
+    TaskScheduler* pScheduler = nullptr)
+{
+    if (ids.size() < 2) return;
+    std::vector<UINT32> tmp(ids.size());
+    std::vector<UINT16> digits(ids.size());
+    detail::RadixSortRange(keys.data(), ids.data(), tmp.data(), digits.data(), ids.size(), 0,
+        pScheduler);
+}
+
+
+} // namespace cedict
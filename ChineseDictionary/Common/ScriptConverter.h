@@ -0,0 +1,283 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// ScriptConverter.h -- Traditional to simplified Chinese conversion (or the
+//                      reverse), learnt from the headwords of the entries.
+//
+// Build() gets the pairs of headwords (e.g. trad and simp of every entry)
+// and derives two tables from them:
+//
+//  - the character map: for each character, the replacement it has most
+//    often in the pairs, e.g. U+9EBC (trad) -> U+4E48 (simp). It is a flat
+//    array over the code units below 0x10000, so that converting a character
+//    is one load;
+//
+//  - the phrases: the pairs that the character map alone gets wrong, e.g.
+//    when a simplified character stands for several traditional ones. Only
+//    those are kept, in a hash table of their own rather than a
+//    HeadwordIndex: each slot leads straight to a record with the length,
+//    the source and the target of the phrase, so that a match touches two
+//    cache lines instead of four. A second flat array gives the
+//    lengths of the phrases starting with each character, as a bit mask (0
+//    for most of them), so that the phrase lookup is only paid where it may
+//    matter, and only for the lengths that exist. A bit filter, indexed by
+//    hash, holds the first two characters and the whole of each phrase:
+//    most positions are rejected after hashing two characters, and most
+//    lengths that cannot match without probing the index. The hashes of the
+//    candidate prefixes are computed incrementally, once per character.
+//
+// Convert() then goes left to right and replaces the longest phrase that
+// starts at the current position, or else the single character.
+//
+// Pairs whose sides differ in length are ignored, so that the converted
+// text always has the length of the source (both sides of a CEDICT entry
+// have the same number of characters). So are phrases longer than
+// kMaxPhraseLength characters.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+template <typename Char>
+class ScriptConverter
+{
+public:
+    typedef TextSpan<Char> Span;
+
+    ScriptConverter() : m_phraseMask(0), m_cPhrases(0), m_cchLongestPhrase(0), m_cMappedChars(0) {}
+
+    // from[i] converts to to[i]. The phrases are copied: the converter does
+    // not refer to the spans after Build().
+    void Build(const std::vector<Span>& from, const std::vector<Span>& to);
+
+    // Convert [pchBegin, pchEnd) into pchDest, which must have room for
+    // (pchEnd - pchBegin) characters. Returns the number of characters
+    // written, which is always that length.
+    size_t Convert(const Char* pchBegin, const Char* pchEnd, Char* pchDest) const;
+
+    // True until Build() is called; Convert() then copies the text as is.
+    bool Empty() const { return m_charMap.empty(); }
+
+    // Characters that the map changes, and phrases kept as exceptions.
+    size_t MappedCharCount() const { return m_cMappedChars; }
+    size_t PhraseCount() const { return m_cPhrases; }
+    size_t LongestPhrase() const { return m_cchLongestPhrase; }
+
+    // Memory held by the tables.
+    size_t Bytes() const
+    {
+        return m_charMap.capacity() * sizeof(Char) + m_phraseLengths.capacity() * sizeof(UINT32)
+            + m_filter.capacity() * sizeof(UINT32) + m_phraseSlots.capacity() * sizeof(PhraseSlot)
+            + m_phraseText.capacity() * sizeof(Char);
+    }
+
+private:
+    static const UINT32 kMapSize = 0x10000;
+    static const size_t kMaxPhraseLength = 31;  // bits of m_phraseLengths
+    static const int kFilterBits = 21;          // log2 of the filter size in bits
+
+    static bool InMap(Char ch) { return static_cast<UINT32>(ch) < kMapSize; }
+
+    Char MapChar(Char ch) const
+    {
+        return InMap(ch) ? m_charMap[static_cast<UINT32>(ch)] : ch;
+    }
+
+    void AddToFilter(UINT32 hash)
+    {
+        UINT32 i = hash >> (32 - kFilterBits);
+        m_filter[i >> 5] |= 1u << (i & 31);
+    }
+
+    bool InFilter(UINT32 hash) const
+    {
+        UINT32 i = hash >> (32 - kFilterBits);
+        return (m_filter[i >> 5] >> (i & 31)) & 1;
+    }
+
+    // Target of the phrase [pch, pch + cch), whose hash is hash, or null.
+    const Char* FindPhrase(const Char* pch, size_t cch, UINT32 hash) const;
+
+    struct PhraseSlot
+    {
+        UINT32 hash;
+        UINT32 ich;     // record in m_phraseText, kEmptySlot if none
+    };
+
+    static const UINT32 kEmptySlot = 0xFFFFFFFF;
+
+    std::vector<Char> m_charMap;            // kMapSize entries
+    std::vector<UINT32> m_phraseLengths;    // bit n: a phrase of length n starts with it
+    std::vector<UINT32> m_filter;           // hashes of phrases and of their first two characters
+    std::vector<PhraseSlot> m_phraseSlots;
+    UINT32 m_phraseMask;                    // m_phraseSlots.size() - 1
+    std::vector<Char> m_phraseText;         // records: length, source, target
+    size_t m_cPhrases;
+    size_t m_cchLongestPhrase;
+    size_t m_cMappedChars;
+};
+
+
+template <typename Char> const UINT32 ScriptConverter<Char>::kMapSize;
+template <typename Char> const size_t ScriptConverter<Char>::kMaxPhraseLength;
+template <typename Char> const int ScriptConverter<Char>::kFilterBits;
+template <typename Char> const UINT32 ScriptConverter<Char>::kEmptySlot;
+
+
+template <typename Char>
+void ScriptConverter<Char>::Build(const std::vector<Span>& from, const std::vector<Span>& to)
+{
+    // Count how often each character becomes each other one.
+    std::unordered_map<UINT64, UINT32> pairCounts;
+    for (size_t i = 0; i < from.size(); ++i) {
+        if (from[i].Length() != to[i].Length()) continue;
+        for (size_t ich = 0; ich < from[i].Length(); ++ich) {
+            Char chFrom = from[i].pchBegin[ich];
+            Char chTo = to[i].pchBegin[ich];
+            if (!InMap(chFrom)) continue;
+            pairCounts[(static_cast<UINT64>(chFrom) << 32) | static_cast<UINT32>(chTo)]++;
+        }
+    }
+
+    // Keep the most frequent replacement of each character; ties go to the
+    // character itself, then to the lowest one, so that the map does not
+    // depend on the hash table order.
+    std::vector<UINT32> bestCount(kMapSize, 0);
+    m_charMap.resize(kMapSize);
+    for (UINT32 ch = 0; ch < kMapSize; ++ch) {
+        m_charMap[ch] = static_cast<Char>(ch);
+    }
+    for (auto i = pairCounts.begin(); i != pairCounts.end(); ++i) {
+        UINT32 chFrom = static_cast<UINT32>(i->first >> 32);
+        Char chTo = static_cast<Char>(static_cast<UINT32>(i->first));
+        UINT32 count = i->second;
+        Char& chBest = m_charMap[chFrom];
+        bool fBetter = count > bestCount[chFrom]
+            || (count == bestCount[chFrom] && chBest != static_cast<Char>(chFrom)
+                && (chTo == static_cast<Char>(chFrom) || chTo < chBest));
+        if (fBetter) {
+            chBest = chTo;
+            bestCount[chFrom] = count;
+        }
+    }
+    m_cMappedChars = 0;
+    for (UINT32 ch = 0; ch < kMapSize; ++ch) {
+        if (m_charMap[ch] != static_cast<Char>(ch)) m_cMappedChars++;
+    }
+
+    // The phrases are the pairs of two or more characters that the map does
+    // not convert right.
+    std::vector<size_t> phrases;
+    m_phraseLengths.assign(kMapSize, 0);
+    m_filter.assign(static_cast<size_t>(1) << (kFilterBits - 5), 0);
+    m_cchLongestPhrase = 0;
+    for (size_t i = 0; i < from.size(); ++i) {
+        size_t cch = from[i].Length();
+        if (cch < 2 || cch > kMaxPhraseLength || cch != to[i].Length()
+            || !InMap(*from[i].pchBegin)) continue;
+        bool fMapped = true;
+        for (size_t ich = 0; ich < cch && fMapped; ++ich) {
+            fMapped = MapChar(from[i].pchBegin[ich]) == to[i].pchBegin[ich];
+        }
+        if (fMapped) continue;
+
+        phrases.push_back(i);
+        m_phraseLengths[static_cast<UINT32>(*from[i].pchBegin)] |= 1u << cch;
+        AddToFilter(HashSpan(MakeSpan(from[i].pchBegin, from[i].pchBegin + 2)));
+        AddToFilter(HashSpan(from[i]));
+        m_cchLongestPhrase = (std::max)(m_cchLongestPhrase, cch);
+    }
+
+    // Keep the load factor at or below 50%. When a source appears more
+    // than once, the first pair wins.
+    size_t cSlots = 16;
+    while (cSlots < 2 * phrases.size()) cSlots *= 2;
+    PhraseSlot empty = { 0, kEmptySlot };
+    m_phraseSlots.assign(cSlots, empty);
+    m_phraseMask = static_cast<UINT32>(cSlots - 1);
+    m_phraseText.clear();
+    m_cPhrases = 0;
+    for (size_t i : phrases) {
+        size_t cch = from[i].Length();
+        UINT32 hash = HashSpan(from[i]);
+        if (FindPhrase(from[i].pchBegin, cch, hash)) continue;
+
+        UINT32 s = hash & m_phraseMask;
+        while (m_phraseSlots[s].ich != kEmptySlot) s = (s + 1) & m_phraseMask;
+        m_phraseSlots[s].hash = hash;
+        m_phraseSlots[s].ich = static_cast<UINT32>(m_phraseText.size());
+        m_phraseText.push_back(static_cast<Char>(cch));
+        m_phraseText.insert(m_phraseText.end(), from[i].pchBegin, from[i].pchEnd);
+        m_phraseText.insert(m_phraseText.end(), to[i].pchBegin, to[i].pchEnd);
+        m_cPhrases++;
+    }
+}
+
+template <typename Char>
+const Char* ScriptConverter<Char>::FindPhrase(const Char* pch, size_t cch, UINT32 hash) const
+{
+    for (UINT32 s = hash & m_phraseMask; ; s = (s + 1) & m_phraseMask) {
+        const PhraseSlot& slot = m_phraseSlots[s];
+        if (slot.ich == kEmptySlot) return nullptr;
+        if (slot.hash != hash) continue;
+        const Char* pchRecord = &m_phraseText[slot.ich];
+        if (static_cast<size_t>(pchRecord[0]) == cch && std::equal(pch, pch + cch, pchRecord + 1)) {
+            return pchRecord + 1 + cch;
+        }
+    }
+}
+
+template <typename Char>
+size_t ScriptConverter<Char>::Convert(const Char* pchBegin, const Char* pchEnd, Char* pchDest) const
+{
+    if (Empty()) return std::copy(pchBegin, pchEnd, pchDest) - pchDest;
+
+    const Char* pch = pchBegin;
+    Char* pchOut = pchDest;
+    while (pch < pchEnd) {
+        Char ch = *pch;
+        UINT32 lengths = InMap(ch) ? m_phraseLengths[static_cast<UINT32>(ch)] : 0;
+        UINT32 hashes[kMaxPhraseLength + 1];
+        if (lengths && pchEnd - pch >= 2) {
+            hashes[1] = HashStep(kHashBasis, ch);
+            hashes[2] = HashStep(hashes[1], pch[1]);
+            if (!InFilter(hashes[2])) lengths = 0;
+        }
+        if (lengths) {
+            size_t cch = (std::min)(kMaxPhraseLength, static_cast<size_t>(pchEnd - pch));
+            while (cch >= 2 && !(lengths & (1u << cch))) --cch;
+            for (size_t ich = 2; ich < cch; ++ich) {
+                hashes[ich + 1] = HashStep(hashes[ich], pch[ich]);
+            }
+
+            const Char* pchTarget = nullptr;
+            for (; cch >= 2; --cch) {
+                if (!(lengths & (1u << cch)) || !InFilter(hashes[cch])) continue;
+                pchTarget = FindPhrase(pch, cch, hashes[cch]);
+                if (pchTarget) break;
+            }
+            if (pchTarget) {
+                pchOut = std::copy(pchTarget, pchTarget + cch, pchOut);
+                pch += cch;
+                continue;
+            }
+        }
+        *pchOut++ = MapChar(ch);
+        ++pch;
+    }
+    return pchOut - pchDest;
+}
+
+
+} // namespace cedict
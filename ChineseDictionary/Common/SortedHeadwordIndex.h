@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// SortedHeadwordIndex.h -- Read-only ordered index of the headwords, for
+//                          lower bound, range and nearest-key queries.
+//
+// The keys are kept in Eytzinger (breadth-first) order: the root at 1, the
+// children of node k at 2k and 2k + 1. A search goes down the tree without
+// branching on the comparisons (k = 2k + (node < key)), and the nodes it
+// may visit three levels further down, which are 8 consecutive slots in one
+// cache line, are prefetched on the way: the latency of the cache misses is
+// overlapped instead of taken one level after the other, as a binary search
+// over a sorted array does.
+//
+// The nodes do not hold the strings but an order-preserving prefix of the
+// key packed in 64 bits (4 UTF-16 code units, or 3 code points of 21 bits
+// for 32-bit characters, most significant first, zero padded), so most
+// comparisons are one integer compare; only keys that share the whole
+// prefix look at the strings, through a copy of their spans in node order.
+// Each node also has the rank of its key in sorted order, which indexes the
+// ids in sorted order for scans.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <intrin.h>         // for _BitScanForward
+#include <xmmintrin.h>      // for _mm_prefetch
+#include <algorithm>
+#include <numeric>          // for std::iota
+#include <vector>
+#include "RadixSort.h"
+#include "TaskScheduler.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+template <typename Char>
+class SortedHeadwordIndex
+{
+public:
+    typedef TextSpan<Char> Key;
+
+    SortedHeadwordIndex() : m_pPrefixes(nullptr), m_cKeys(0) {}
+
+    // keys[id] is the key of entry id. Their characters must outlive the
+    // index. The ids are put in key order by a radix sort (see RadixSort.h),
+    // on the threads of the scheduler if there is one.
+    void Build(std::vector<Key> keys, TaskScheduler* pScheduler = nullptr);
+
+    size_t Size() const { return m_cKeys; }
+
+    // Rank (position in sorted order) of the first key not less than key,
+    // or Size() if there is none.
+    size_t LowerBound(const Key& key) const;
+
+    // Entry id and key of the given rank, e.g. to scan a range from
+    // LowerBound() on.
+    UINT32 IdAt(size_t rank) const { return m_ids[rank]; }
+    const Key& KeyAt(size_t rank) const { return m_keys[m_ids[rank]]; }
+
+    // Memory held by the index (not counting the key characters).
+    size_t Bytes() const
+    {
+        return m_prefixStorage.capacity() * sizeof(UINT64) + m_ranks.capacity() * sizeof(UINT32)
+            + m_nodeKeys.capacity() * sizeof(Key) + m_ids.capacity() * sizeof(UINT32)
+            + m_keys.capacity() * sizeof(Key);
+    }
+
+private:
+    SortedHeadwordIndex(const SortedHeadwordIndex&) = delete;
+    SortedHeadwordIndex& operator=(const SortedHeadwordIndex&) = delete;
+
+    // Code points need 21 bits: wider characters are packed on 21 bits.
+    static const int kPrefixBits = sizeof(Char) < 4 ? 8 * sizeof(Char) : 21;
+    static const size_t kPrefixChars = 64 / kPrefixBits;
+    static const size_t kNodesPerLine = 64 / sizeof(UINT64);
+
+    static UINT64 Prefix(const Key& key)
+    {
+        const int kBits = kPrefixBits;
+        UINT64 prefix = 0;
+        size_t cch = (std::min)(key.Length(), kPrefixChars);
+        for (size_t i = 0; i < cch; ++i) {
+            // A signed char must not spread its sign over the prefix; wider
+            // code units are never negative.
+            Char ch = key.pchBegin[i];
+            UINT64 unit = sizeof(Char) == 1 ? OrderedUnit(ch) : static_cast<UINT64>(ch);
+            prefix = (prefix << kBits) | unit;
+        }
+        for (size_t i = cch; i < kPrefixChars; ++i) prefix <<= kBits;
+        return prefix;
+    }
+
+    // Fill the nodes of the subtree rooted at k from the sorted ranks,
+    // starting at rank; returns the next rank.
+    size_t Fill(UINT32 k, const std::vector<UINT32>& sorted, size_t rank);
+
+    std::vector<UINT64> m_prefixStorage;
+    UINT64* m_pPrefixes;                // node k at m_pPrefixes[k], 64-byte aligned
+    std::vector<UINT32> m_ranks;        // rank of the key of node k
+    std::vector<Key> m_nodeKeys;        // key of node k
+    std::vector<UINT32> m_ids;          // entry ids in sorted order
+    std::vector<Key> m_keys;
+    size_t m_cKeys;
+};
+
+
+template <typename Char> const int SortedHeadwordIndex<Char>::kPrefixBits;
+template <typename Char> const size_t SortedHeadwordIndex<Char>::kPrefixChars;
+template <typename Char> const size_t SortedHeadwordIndex<Char>::kNodesPerLine;
+
+
+template <typename Char>
+void SortedHeadwordIndex<Char>::Build(std::vector<Key> keys, TaskScheduler* pScheduler)
+{
+    m_keys.swap(keys);
+    m_cKeys = m_keys.size();
+
+    // Stable, so that entries with the same key stay in id order.
+    m_ids.resize(m_cKeys);
+    std::iota(m_ids.begin(), m_ids.end(), 0);
+    RadixSortIds(m_keys, m_ids, pScheduler);
+
+    // Node 0 is unused. The start is aligned so that the 8 descendants of a
+    // node three levels down share a cache line; the prefetches of the last
+    // levels point past the end, which is harmless as prefetches do not
+    // fault.
+    m_prefixStorage.assign(m_cKeys + 1 + kNodesPerLine, 0);
+    UINT_PTR ib = reinterpret_cast<UINT_PTR>(m_prefixStorage.data());
+    m_pPrefixes = reinterpret_cast<UINT64*>((ib + 63) & ~static_cast<UINT_PTR>(63));
+    m_ranks.assign(m_cKeys + 1, 0);
+    m_nodeKeys.assign(m_cKeys + 1, Key());
+    Fill(1, m_ids, 0);
+}
+
+template <typename Char>
+size_t SortedHeadwordIndex<Char>::Fill(UINT32 k, const std::vector<UINT32>& sorted, size_t rank)
+{
+    // In-order walk of the implicit tree; it is at most log2(n) deep.
+    if (k > m_cKeys) return rank;
+    rank = Fill(2 * k, sorted, rank);
+    m_pPrefixes[k] = Prefix(m_keys[sorted[rank]]);
+    m_nodeKeys[k] = m_keys[sorted[rank]];
+    m_ranks[k] = static_cast<UINT32>(rank);
+    return Fill(2 * k + 1, sorted, rank + 1);
+}
+
+template <typename Char>
+size_t SortedHeadwordIndex<Char>::LowerBound(const Key& key) const
+{
+    const UINT64 prefix = Prefix(key);
+    const UINT32 cKeys = static_cast<UINT32>(m_cKeys);
+    UINT32 k = 1;
+    while (k <= cKeys) {
+        _mm_prefetch(reinterpret_cast<const char*>(m_pPrefixes + kNodesPerLine * static_cast<size_t>(k)),
+            _MM_HINT_T0);
+        UINT64 node = m_pPrefixes[k];
+        bool fLess = node < prefix
+            || (node == prefix && m_nodeKeys[k] < key);
+        k = 2 * k + (fLess ? 1 : 0);
+    }
+
+    // The last left turn leads to the answer: drop the trailing right turns
+    // (1 bits) and that left turn.
+    unsigned long iBit = 0;
+    _BitScanForward(&iBit, ~k);
+    k >>= iBit + 1;
+    return k ? m_ranks[k] : m_cKeys;
+}
+
+
+} // namespace cedict
@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// StoragePolicies.h -- How the fields of a dictionary entry are stored.
+//
+// A storage policy is owned by the dictionary and creates (and, if needed,
+// destroys) the strings held by each entry:
+//
+//     typedef ... CharType;
+//     typedef ... String;
+//
+//     explicit XxxStorage(const DictionaryOptions& options);
+//
+//     String Alloc(const CharType* pchBegin, const CharType* pchEnd);
+//     void Free(String& s);
+//     static TextSpan<CharType> View(const String& s);
+//
+//     // Two-pass load: cch characters (terminators included) are about to
+//     // be allocated.
+//     void Reserve(size_t cch);
+//
+//     // Number of bulk chunks allocated, 0 for per-string allocations,
+//     // and how many of them are backed by large pages.
+//     size_t ChunkCount() const;
+//     size_t LargePageChunkCount() const;
+//
+//     // Memory accounting: adds the bytes held for s outside of its String
+//     // object, *pcbUsed for its characters and terminator and *pcbSlack for
+//     // the rest of its own allocation (none for pooled strings), and gives
+//     // the bytes committed for bulk chunks.
+//     static void CountBytes(const String& s, size_t* pcbUsed, size_t* pcbSlack);
+//     size_t ChunkBytes() const;
+//
+// The ATL CStringW policy lives in AtlStringStorage.h, so that only the
+// programs that want it pay for including ATL.
+//
+// The string and pool policies are templates on the code unit type, to go
+// with the transcoders of UtfTranscoder (see TranscodePolicies.h):
+// BasicPoolStringStorage<char> stores UTF-8, <char16_t> UTF-16 and
+// <char32_t> UTF-32, whatever the size of wchar_t.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include "DictionaryOptions.h"
+#include "StringPool.h"
+#include "TextSpan.h"
+
+
+namespace cedict
+{
+
+
+//------------------------------------------------------------------------------
+// STL basic_string; wstring for V1 and V2.
+//------------------------------------------------------------------------------
+template <typename Char>
+class BasicStringStorage
+{
+public:
+    typedef Char CharType;
+    typedef std::basic_string<Char> String;
+
+    explicit BasicStringStorage(const DictionaryOptions&) {}
+
+    String Alloc(const Char* pchBegin, const Char* pchEnd)
+    {
+        return String(pchBegin, pchEnd);
+    }
+
+    void Free(String&) {}
+
+    static TextSpan<Char> View(const String& s)
+    {
+        return MakeSpan(s.data(), s.data() + s.length());
+    }
+
+    static void CountBytes(const String& s, size_t* pcbUsed, size_t* pcbSlack)
+    {
+        // Short strings are stored in the wstring object itself.
+        const BYTE* pb = reinterpret_cast<const BYTE*>(s.data());
+        const BYTE* pbObject = reinterpret_cast<const BYTE*>(&s);
+        if (pb >= pbObject && pb < pbObject + sizeof(s)) return;
+        *pcbUsed += (s.length() + 1) * sizeof(Char);
+        *pcbSlack += (s.capacity() - s.length()) * sizeof(Char);
+    }
+
+    void Reserve(size_t) {}
+    size_t ChunkCount() const { return 0; }
+    size_t LargePageChunkCount() const { return 0; }
+    size_t ChunkBytes() const { return 0; }
+};
+
+typedef BasicStringStorage<WCHAR> WStringStorage;
+
+
+//------------------------------------------------------------------------------
+// Raw C-style strings, one new[] per string (V3).
+//
+// Based on:
+//
+// Loading the dictionary, part 5: Avoiding string copying
+// https://blogs.msdn.microsoft.com/oldnewthing/20050518-42/?p=35613
+//------------------------------------------------------------------------------
+class RawStringStorage
+{
+public:
+    typedef WCHAR CharType;
+    typedef LPWSTR String;
+
+    explicit RawStringStorage(const DictionaryOptions&) {}
+
+    String Alloc(const WCHAR* pchBegin, const WCHAR* pchEnd)
+    {
+        int cch = static_cast<int>(pchEnd - pchBegin + 1);
+        LPWSTR psz = new WCHAR[cch];
+        lstrcpynW(psz, pchBegin, cch);
+        return psz;
+    }
+
+    void Free(String& psz)
+    {
+        delete[] psz;
+        psz = nullptr;
+    }
+
+    static TextSpan<WCHAR> View(const String& psz) { return MakeSpan(psz); }
+
+    static void CountBytes(const String& psz, size_t* pcbUsed, size_t*)
+    {
+        if (psz) *pcbUsed += (View(psz).Length() + 1) * sizeof(WCHAR);
+    }
+
+    void Reserve(size_t) {}
+    size_t ChunkCount() const { return 0; }
+    size_t LargePageChunkCount() const { return 0; }
+    size_t ChunkBytes() const { return 0; }
+};
+
+
+//------------------------------------------------------------------------------
+// Raw C-style strings carved out of a StringPool (V4).
+// Strings are never freed one by one: the pool releases them all at once.
+//------------------------------------------------------------------------------
+template <typename Char>
+class BasicPoolStringStorage
+{
+public:
+    typedef Char CharType;
+    typedef Char* String;
+
+    explicit BasicPoolStringStorage(const DictionaryOptions& options)
+        : m_pool(options.largePages)
+    {}
+
+    String Alloc(const Char* pchBegin, const Char* pchEnd)
+    {
+        return m_pool.AllocString(pchBegin, pchEnd);
+    }
+
+    void Free(String&) {}
+    static TextSpan<Char> View(const String& psz) { return MakeSpan(psz); }
+
+    static void CountBytes(const String& psz, size_t* pcbUsed, size_t*)
+    {
+        if (psz) *pcbUsed += (View(psz).Length() + 1) * sizeof(Char);
+    }
+
+    void Reserve(size_t cch) { m_pool.Reserve(cch); }
+    size_t ChunkCount() const { return m_pool.ChunkCount(); }
+    size_t LargePageChunkCount() const { return m_pool.LargePageChunkCount(); }
+    size_t ChunkBytes() const { return m_pool.ChunkBytes(); }
+
+private:
+    BasicStringPool<Char> m_pool;
+};
+
+typedef BasicPoolStringStorage<WCHAR> PoolStringStorage;
+
+
+} // namespace cedict
@@ -0,0 +1,157 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// StringPool.h -- Grow-only pool of null-terminated strings, carved out of
+//                 VirtualAlloc'ed chunks and released all at once.
+//
+// The pool is a template on the code unit type (char for UTF-8, char16_t or
+// WCHAR for UTF-16, char32_t for UTF-32); StringPool is the pool of WCHAR
+// strings.
+//
+// Based on:
+//
+// Loading the dictionary, part 6: Taking advantage of our memory allocation pattern
+// https://blogs.msdn.microsoft.com/oldnewthing/20050519-00/?p=35603
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <new>      // for std::bad_alloc
+#include "LargePages.h"
+#include "LoadTrace.h"
+
+
+namespace cedict
+{
+
+
+template <typename Char>
+class BasicStringPool
+{
+public:
+    // With fLargePages, chunks are allocated on large pages when possible.
+    explicit BasicStringPool(bool fLargePages = false);
+    ~BasicStringPool();
+    Char* AllocString(const Char* pszBegin, const Char* pszEnd);
+
+    // Make sure that the next cch characters fit in a single chunk.
+    void Reserve(size_t cch);
+
+    // Number of chunks allocated so far.
+    size_t ChunkCount() const { return m_cChunks; }
+    size_t LargePageChunkCount() const { return m_cLargeChunks; }
+
+    // Bytes committed for the chunks, headers and unused tails included.
+    size_t ChunkBytes() const { return m_cbChunks; }
+
+private:
+    BasicStringPool(const BasicStringPool&) = delete;
+    BasicStringPool& operator=(const BasicStringPool&) = delete;
+
+    union HEADER {
+        struct {
+            HEADER* m_phdrPrev;
+            SIZE_T  m_cb;
+        };
+        Char alignment;
+    };
+    enum {
+        MIN_CBCHUNK = 32000,
+        MAX_CHARALLOC = 1024 * 1024
+    };
+
+    void AllocChunk(size_t cch);
+
+private:
+    Char*   m_pchNext;   // first available byte
+    Char*   m_pchLimit;  // one past last available byte
+    HEADER* m_phdrCur;   // current block
+    DWORD   m_dwGranularity;
+    size_t  m_cChunks;   // chunks allocated so far
+    size_t  m_cLargeChunks;  // ... of which on large pages
+    size_t  m_cbChunks;      // bytes committed for them
+    bool    m_fLargePages;
+};
+
+typedef BasicStringPool<WCHAR> StringPool;
+
+inline DWORD RoundUp(DWORD cb, DWORD units)
+{
+    return ((cb + units - 1) / units) * units;
+}
+
+template <typename Char>
+BasicStringPool<Char>::BasicStringPool(bool fLargePages)
+    : m_pchNext(NULL), m_pchLimit(NULL), m_phdrCur(NULL)
+    , m_cChunks(0), m_cLargeChunks(0), m_cbChunks(0), m_fLargePages(fLargePages)
+{
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    m_dwGranularity = RoundUp(sizeof(HEADER) + MIN_CBCHUNK,
+        si.dwAllocationGranularity);
+}
+
+template <typename Char>
+Char* BasicStringPool<Char>::AllocString(const Char* pszBegin, const Char* pszEnd)
+{
+    size_t cch = pszEnd - pszBegin + 1;
+    Char* psz = m_pchNext;
+    if (m_pchNext + cch <= m_pchLimit) {
+        m_pchNext += cch;
+        *std::copy(pszBegin, pszEnd, psz) = 0;
+        return psz;
+    }
+
+    if (cch > MAX_CHARALLOC) throw std::bad_alloc();
+    AllocChunk(cch);
+
+    return AllocString(pszBegin, pszEnd);
+}
+
+template <typename Char>
+void BasicStringPool<Char>::Reserve(size_t cch)
+{
+    if (m_pchNext + cch > m_pchLimit) {
+        AllocChunk(cch);
+    }
+}
+
+template <typename Char>
+void BasicStringPool<Char>::AllocChunk(size_t cch)
+{
+    TraceScope trace("pool chunk");
+    DWORD cbWanted = RoundUp(static_cast<DWORD>(cch * sizeof(Char) + sizeof(HEADER)),
+        m_dwGranularity);
+    SIZE_T cbAlloc;
+    bool fLarge;
+    BYTE* pbNext = reinterpret_cast<BYTE*>(
+        AllocPages(cbWanted, m_fLargePages, &cbAlloc, &fLarge));
+    if (!pbNext) throw std::bad_alloc();
+
+    m_pchLimit = reinterpret_cast<Char*>(pbNext + cbAlloc);
+    HEADER* phdrCur = reinterpret_cast<HEADER*>(pbNext);
+    phdrCur->m_phdrPrev = m_phdrCur;
+    phdrCur->m_cb = cbAlloc;
+    m_phdrCur = phdrCur;
+    m_pchNext = reinterpret_cast<Char*>(phdrCur + 1);
+    m_cChunks++;
+    if (fLarge) m_cLargeChunks++;
+    m_cbChunks += cbAlloc;
+}
+
+template <typename Char>
+BasicStringPool<Char>::~BasicStringPool()
+{
+    HEADER* phdr = m_phdrCur;
+    while (phdr) {
+        HEADER* phdrPrev = phdr->m_phdrPrev;
+        FreePages(phdr);
+        phdr = phdrPrev;
+    }
+}
+
+
+} // namespace cedict
@@ -0,0 +1,360 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// TaskScheduler.h -- Work-stealing thread pool, for building the indexes of
+//                    a dictionary in parallel.
+//
+// Each thread of the pool has a deque of tasks. A task spawned by a thread
+// goes to the back of its own deque, and the thread takes its next task
+// from there too: the most recent one, whose data is still in its cache. A
+// thread that runs out of tasks steals from the front of the deque of
+// another, where the oldest tasks are: with tasks that split their range in
+// two and spawn one half (ParallelFor, ParallelStableSort), those are the
+// largest pieces of work left, so a thief takes a lot at once and steals
+// seldom. Each deque has its own lock, which the tasks, of thousands of
+// entries each, hardly ever contend for.
+//
+// The tasks spawned together form a TaskGroup. Waiting for a group does not
+// block: the waiting thread runs tasks (its own, or stolen) until the group
+// is done, so a task may spawn and wait for subtasks without holding a
+// thread idle, and the thread that waits from outside the pool works as one
+// more thread of it:
+//
+//     TaskScheduler scheduler(0);      // one thread per logical processor
+//     TaskGroup group;
+//     scheduler.Spawn(group, [&]() { BuildThis(); });
+//     scheduler.Spawn(group, [&]() { BuildThat(); });
+//     scheduler.Wait(group);           // rethrows what a task threw, if any
+//
+// The helpers below take a TaskScheduler pointer, and run on the calling
+// thread alone when it is null.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "LoadTrace.h"
+
+
+namespace cedict
+{
+
+
+class TaskScheduler;
+
+
+// Tasks to wait for together (see TaskScheduler::Wait).
+class TaskGroup
+{
+public:
+    TaskGroup() : m_cPending(0) {}
+
+    bool Done() const { return m_cPending.load(std::memory_order_acquire) == 0; }
+
+private:
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    friend class TaskScheduler;
+
+    std::atomic<size_t> m_cPending;     // tasks spawned and not finished
+    std::mutex m_mutex;                 // guards m_exception
+    std::exception_ptr m_exception;     // the first one a task threw
+};
+
+
+namespace detail
+{
+
+// The pool and the deque of the calling thread, in a class template so that
+// the header can define them.
+template <typename T>
+struct TaskSchedulerState
+{
+    static thread_local const TaskScheduler* t_pScheduler;
+    static thread_local size_t t_iQueue;
+};
+
+template <typename T> thread_local const TaskScheduler* TaskSchedulerState<T>::t_pScheduler = nullptr;
+template <typename T> thread_local size_t TaskSchedulerState<T>::t_iQueue = 0;
+
+} // namespace detail
+
+
+class TaskScheduler
+{
+public:
+    // Runs the tasks on cThreads threads, counting the threads that wait for
+    // them: cThreads - 1 workers are started. 0 means one thread per logical
+    // processor; with 1, the tasks run one after the other on the thread
+    // that waits for them.
+    explicit TaskScheduler(unsigned cThreads)
+        : m_cQueued(0)
+        , m_cSleeping(0)
+        , m_fStop(false)
+    {
+        if (cThreads == 0) cThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+        // Deque 0 is shared by the threads outside the pool.
+        for (unsigned i = 0; i < cThreads; ++i) m_queues.emplace_back(new Queue);
+        for (unsigned i = 1; i < cThreads; ++i) {
+            m_workers.push_back(std::thread([this, i]() { Run(i); }));
+        }
+    }
+
+    // The groups spawned on the scheduler must have been waited for.
+    ~TaskScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_fStop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& worker : m_workers) worker.join();
+    }
+
+    size_t ThreadCount() const { return m_queues.size(); }
+
+    // Queue fn() as a task of group.
+    template <typename Function>
+    void Spawn(TaskGroup& group, Function fn)
+    {
+        group.m_cPending.fetch_add(1, std::memory_order_relaxed);
+        Queue& queue = *m_queues[CurrentQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Task(std::function<void()>(std::move(fn)), &group));
+        }
+        // A worker going to sleep counts itself before it looks at
+        // m_cQueued, so one of the two sees the other.
+        m_cQueued.fetch_add(1);
+        if (m_cSleeping.load() > 0) {
+            { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+            m_wake.notify_one();
+        }
+    }
+
+    // Runs tasks, of group or not, until all the tasks of group have run,
+    // then rethrows the first exception that one of them threw.
+    void Wait(TaskGroup& group)
+    {
+        const size_t iQueue = CurrentQueue();
+        while (!group.Done()) {
+            if (!RunOne(iQueue)) std::this_thread::yield();
+        }
+        if (group.m_exception) {
+            std::exception_ptr e;
+            e.swap(group.m_exception);
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    typedef detail::TaskSchedulerState<void> State;
+
+    struct Task
+    {
+        Task() : pGroup(nullptr) {}
+        Task(std::function<void()> f, TaskGroup* p) : fn(std::move(f)), pGroup(p) {}
+
+        std::function<void()> fn;
+        TaskGroup* pGroup;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Deque of the calling thread: its own for a worker of this pool, the
+    // shared one for any other thread.
+    size_t CurrentQueue() const
+    {
+        return State::t_pScheduler == this ? State::t_iQueue : 0;
+    }
+
+    // Runs the newest task of deque iQueue, or else the oldest task of
+    // another deque; false if there was none.
+    bool RunOne(size_t iQueue)
+    {
+        Task task;
+        bool fFound = PopBack(*m_queues[iQueue], task);
+        for (size_t i = 1; !fFound && i < m_queues.size(); ++i) {
+            fFound = PopFront(*m_queues[(iQueue + i) % m_queues.size()], task);
+        }
+        if (!fFound) return false;
+        m_cQueued.fetch_sub(1);
+
+        TaskGroup* pGroup = task.pGroup;
+        try {
+            std::function<void()> fn(std::move(task.fn));
+            fn();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(pGroup->m_mutex);
+            if (!pGroup->m_exception) pGroup->m_exception = std::current_exception();
+        }
+        // The group may be gone as soon as this is done.
+        pGroup->m_cPending.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    static bool PopBack(Queue& queue, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    static bool PopFront(Queue& queue, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    void Run(size_t iQueue)
+    {
+        Tracer::SetThreadName("task worker");
+        State::t_pScheduler = this;
+        State::t_iQueue = iQueue;
+        for (;;) {
+            if (RunOne(iQueue)) continue;
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_cSleeping.fetch_add(1);
+            m_wake.wait(lock, [this]() { return m_fStop || m_cQueued.load() > 0; });
+            m_cSleeping.fetch_sub(1);
+            if (m_fStop) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_queues;   // one per thread
+    std::vector<std::thread> m_workers;
+    std::atomic<size_t> m_cQueued;      // tasks in the deques
+    std::atomic<size_t> m_cSleeping;    // workers waiting for tasks
+    std::mutex m_sleepMutex;            // guards m_fStop
+    std::condition_variable m_wake;     // tasks queued, or stopping
+    bool m_fStop;
+};
+
+
+// Number of pieces to cut n elements into, each of at least minPiece
+// elements: a few per thread, so that a thread that is done early has
+// some left to steal. 1 without a scheduler.
+inline size_t PieceCount(const TaskScheduler* pScheduler, size_t n, size_t minPiece)
+{
+    if (!pScheduler || pScheduler->ThreadCount() == 1 || n <= minPiece) return 1;
+    return (std::min)(n / minPiece, 4 * pScheduler->ThreadCount());
+}
+
+// Piece k of n elements cut into cPieces: [PieceStart(k), PieceStart(k + 1)).
+inline size_t PieceStart(size_t n, size_t cPieces, size_t k)
+{
+    return static_cast<size_t>(static_cast<UINT64>(n) * k / cPieces);
+}
+
+
+namespace detail
+{
+
+template <typename Body>
+void SplitRange(TaskScheduler& scheduler, TaskGroup& group, size_t begin, size_t end, size_t grain,
+    const Body& body)
+{
+    // Spawn the upper halves, for thieves to take, and go down the lower.
+    while (end - begin > grain) {
+        size_t mid = begin + (end - begin) / 2;
+        scheduler.Spawn(group, [&scheduler, &group, mid, end, grain, &body]() {
+            SplitRange(scheduler, group, mid, end, grain, body);
+        });
+        end = mid;
+    }
+    body(begin, end);
+}
+
+} // namespace detail
+
+
+// Calls body(b, e) for pieces [b, e) of [begin, end) of at most grain
+// elements, in parallel, and returns when all are done.
+template <typename Body>
+void ParallelFor(TaskScheduler* pScheduler, size_t begin, size_t end, size_t grain, const Body& body)
+{
+    if (begin >= end) return;
+    if (!pScheduler || pScheduler->ThreadCount() == 1 || end - begin <= grain) {
+        body(begin, end);
+        return;
+    }
+    TaskGroup group;
+    try {
+        detail::SplitRange(*pScheduler, group, begin, end, (std::max)(grain, static_cast<size_t>(1)), body);
+    } catch (...) {
+        pScheduler->Wait(group);    // the tasks refer to group
+        throw;
+    }
+    pScheduler->Wait(group);
+}
+
+// Runs a() and b() at the same time, and returns when both are done.
+template <typename A, typename B>
+void ParallelInvoke(TaskScheduler* pScheduler, const A& a, const B& b)
+{
+    if (!pScheduler || pScheduler->ThreadCount() == 1) {
+        a();
+        b();
+        return;
+    }
+    TaskGroup group;
+    pScheduler->Spawn(group, [&b]() { b(); });
+    try {
+        a();
+    } catch (...) {
+        pScheduler->Wait(group);
+        throw;
+    }
+    pScheduler->Wait(group);
+}
+
+// std::stable_sort of [first, last), as a merge sort: the two halves are
+// sorted in parallel, down to pieces of grain elements, then merged.
+template <typename RandomIt, typename Compare>
+void ParallelStableSort(TaskScheduler* pScheduler, RandomIt first, RandomIt last, Compare comp,
+    size_t grain = 16 * 1024)
+{
+    if (!pScheduler || pScheduler->ThreadCount() == 1 || static_cast<size_t>(last - first) <= grain) {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+    RandomIt mid = first + (last - first) / 2;
+    TaskGroup group;
+    pScheduler->Spawn(group, [=]() { ParallelStableSort(pScheduler, mid, last, comp, grain); });
+    try {
+        ParallelStableSort(pScheduler, first, mid, comp, grain);
+    } catch (...) {
+        pScheduler->Wait(group);
+        throw;
+    }
+    pScheduler->Wait(group);
+    std::inplace_merge(first, mid, last, comp);
+}
+
+
+} // namespace cedict
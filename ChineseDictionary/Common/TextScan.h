@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// TextScan.h -- Fast counting pass over a UTF-8 text buffer.
+//
+// Counts lines, comment lines and the size of the text once transcoded,
+// 16 bytes at a time with SSE2, so that the dictionary can allocate its
+// entries and string storage once before parsing.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <emmintrin.h>  // SSE2
+
+
+namespace cedict
+{
+
+
+struct TextScanResult
+{
+    TextScanResult()
+        : cb(0), cLines(0), cCommentLines(0)
+        , cContinuationBytes(0), cFourByteLeads(0)
+    {}
+
+    // UTF-16 code units needed to transcode the whole text.
+    // This is an upper bound of the characters taken by the parsed fields
+    // (and their terminators), as each line carries at least as many
+    // separators as the fields it holds.
+    size_t Utf16Length() const
+    {
+        return cb - cContinuationBytes + cFourByteLeads;
+    }
+
+    // The same bound in code units of Char: the bytes themselves for UTF-8;
+    // UTF-16 needs at least as many units as UTF-32.
+    template <typename Char>
+    size_t TranscodedLength() const
+    {
+        return sizeof(Char) == 1 ? cb : Utf16Length();
+    }
+
+    size_t cb;                  // bytes scanned
+    size_t cLines;              // lines, including a last one without '\n'
+    size_t cCommentLines;       // lines starting with '#'
+    size_t cContinuationBytes;  // 10xxxxxx bytes
+    size_t cFourByteLeads;      // 11110xxx bytes, i.e. surrogate pairs in UTF-16
+};
+
+
+namespace detail
+{
+
+// Sum the 16 byte counters of acc.
+inline size_t HorizontalSum(__m128i acc)
+{
+    __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+    return static_cast<size_t>(_mm_cvtsi128_si32(sums))
+        + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+}
+
+} // namespace detail
+
+
+inline TextScanResult ScanText(const CHAR* pch, size_t cb)
+{
+    TextScanResult result;
+    result.cb = cb;
+    if (cb == 0) return result;
+
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i hash = _mm_set1_epi8('#');
+    const __m128i maskC0 = _mm_set1_epi8(static_cast<char>(0xC0));
+    const __m128i cont = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i maskF8 = _mm_set1_epi8(static_cast<char>(0xF8));
+    const __m128i lead4 = _mm_set1_epi8(static_cast<char>(0xF0));
+
+    // Byte counters are incremented at most once per block, so they are
+    // folded into the totals before they can overflow.
+    const size_t kMaxBlocksPerRound = 255;
+
+    size_t i = 0;
+    // The comment check reads one byte past the block: keep it in bounds.
+    while (i + 16 < cb) {
+        __m128i accLines = _mm_setzero_si128();
+        __m128i accComments = _mm_setzero_si128();
+        __m128i accCont = _mm_setzero_si128();
+        __m128i accLead4 = _mm_setzero_si128();
+        for (size_t n = 0; n < kMaxBlocksPerRound && i + 16 < cb; ++n, i += 16) {
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pch + i));
+            __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pch + i + 1));
+            __m128i isNewline = _mm_cmpeq_epi8(b, newline);
+            __m128i isComment = _mm_and_si128(isNewline, _mm_cmpeq_epi8(next, hash));
+            __m128i isCont = _mm_cmpeq_epi8(_mm_and_si128(b, maskC0), cont);
+            __m128i isLead4 = _mm_cmpeq_epi8(_mm_and_si128(b, maskF8), lead4);
+            // Comparisons yield 0xFF (-1) for matching bytes.
+            accLines = _mm_sub_epi8(accLines, isNewline);
+            accComments = _mm_sub_epi8(accComments, isComment);
+            accCont = _mm_sub_epi8(accCont, isCont);
+            accLead4 = _mm_sub_epi8(accLead4, isLead4);
+        }
+        result.cLines += detail::HorizontalSum(accLines);
+        result.cCommentLines += detail::HorizontalSum(accComments);
+        result.cContinuationBytes += detail::HorizontalSum(accCont);
+        result.cFourByteLeads += detail::HorizontalSum(accLead4);
+    }
+
+    for (; i < cb; ++i) {
+        BYTE b = static_cast<BYTE>(pch[i]);
+        if (b == '\n') {
+            result.cLines++;
+            if (i + 1 < cb && pch[i + 1] == '#') result.cCommentLines++;
+        }
+        if ((b & 0xC0) == 0x80) result.cContinuationBytes++;
+        if ((b & 0xF8) == 0xF0) result.cFourByteLeads++;
+    }
+
+    // The first line has no '\n' in front of it, the last one may have none
+    // after it.
+    if (pch[0] == '#') result.cCommentLines++;
+    if (pch[cb - 1] != '\n') result.cLines++;
+
+    return result;
+}
+
+
+} // namespace cedict
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// TextSpan.h -- Non-owning [pchBegin, pchEnd) range of characters.
+//
+// Used for the fields of a line being parsed and as a common view of the
+// strings of the different storage policies (see StoragePolicies.h).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <string>   // for std::char_traits
+#include <type_traits>
+
+
+namespace cedict
+{
+
+
+template <typename Char>
+struct TextSpan
+{
+    size_t Length() const { return pchEnd - pchBegin; }
+    bool Empty() const { return pchBegin == pchEnd; }
+
+    const Char* pchBegin;
+    const Char* pchEnd;
+};
+
+template <typename Char>
+TextSpan<Char> MakeSpan(const Char* pchBegin, const Char* pchEnd)
+{
+    TextSpan<Char> span = { pchBegin, pchEnd };
+    return span;
+}
+
+// Span of a null-terminated string; a null pointer gives an empty span.
+template <typename Char>
+TextSpan<Char> MakeSpan(const Char* psz)
+{
+    if (!psz) return MakeSpan<Char>(nullptr, nullptr);
+    return MakeSpan(psz, psz + std::char_traits<Char>::length(psz));
+}
+
+template <typename Char>
+bool operator==(const TextSpan<Char>& a, const TextSpan<Char>& b)
+{
+    return a.Length() == b.Length() && std::equal(a.pchBegin, a.pchEnd, b.pchBegin);
+}
+
+template <typename Char>
+bool operator!=(const TextSpan<Char>& a, const TextSpan<Char>& b)
+{
+    return !(a == b);
+}
+
+// Lexicographic order of the code units.
+template <typename Char>
+bool operator<(const TextSpan<Char>& a, const TextSpan<Char>& b)
+{
+    return std::lexicographical_compare(a.pchBegin, a.pchEnd, b.pchBegin, b.pchEnd);
+}
+
+// A code unit as an unsigned number, in the order that operator< compares
+// them: char may be signed, and then the UTF-8 bytes above 0x7F come before
+// ASCII. Radix sorts and packed prefixes of keys go by this.
+template <typename Char>
+typename std::make_unsigned<Char>::type OrderedUnit(Char ch)
+{
+    typedef typename std::make_unsigned<Char>::type Unit;
+    const Unit kSignBit = static_cast<Unit>(Unit(1) << (8 * sizeof(Char) - 1));
+    Unit unit = static_cast<Unit>(ch);
+    return std::is_signed<Char>::value ? static_cast<Unit>(unit ^ kSignBit) : unit;
+}
+
+// 32-bit FNV-1a over the code units; HashStep() adds one more unit, so that
+// the hashes of all the prefixes of a text cost one step each.
+const UINT32 kHashBasis = 2166136261u;
+
+template <typename Char>
+UINT32 HashStep(UINT32 h, Char ch)
+{
+    return (h ^ static_cast<UINT32>(ch)) * 16777619u;
+}
+
+template <typename Char>
+UINT32 HashSpan(const TextSpan<Char>& span)
+{
+    UINT32 h = kHashBasis;
+    for (const Char* pch = span.pchBegin; pch != span.pchEnd; ++pch) {
+        h = HashStep(h, *pch);
+    }
+    return h;
+}
+
+
+} // namespace cedict
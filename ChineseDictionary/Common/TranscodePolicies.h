@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// TranscodePolicies.h -- How a UTF-8 line is converted to the character type
+//                        stored in the dictionary.
+//
+// A transcode policy exposes the produced character type and converts one
+// line at a time into a caller-provided buffer:
+//
+//     typedef ... CharType;
+//
+//     // pchDest must have room for (pchEnd - pchBegin) characters.
+//     // Returns the number of characters written, 0 on failure.
+//     size_t Transcode(const CHAR* pchBegin, const CHAR* pchEnd, CharType* pchDest);
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <codecvt>
+#include <cwchar>   // for std::mbstate_t
+#include "Utf8Validation.h"
+
+
+namespace cedict
+{
+
+
+//------------------------------------------------------------------------------
+// UTF-8 to UTF-16 with the C++ standard library codecvt facet (V1).
+//------------------------------------------------------------------------------
+class CodecvtTranscoder
+{
+public:
+    typedef WCHAR CharType;
+
+    size_t Transcode(const CHAR* pchBegin, const CHAR* pchEnd, WCHAR* pchDest)
+    {
+        std::mbstate_t state = std::mbstate_t();
+        const CHAR* pchFromNext = pchBegin;
+        WCHAR* pchToNext = pchDest;
+        std::codecvt_base::result res = m_cvt.in(state,
+            pchBegin, pchEnd, pchFromNext,
+            pchDest, pchDest + (pchEnd - pchBegin), pchToNext);
+        if (res != std::codecvt_base::ok) return 0;
+
+        // The facet decodes UTF-8 encoded surrogates (ED A0..BF xx), which
+        // are not valid UTF-8: reject them as MultiByteToWideChar does.
+        for (const CHAR* pch = pchBegin; pch + 1 < pchEnd; ++pch) {
+            pch = std::find(pch, pchEnd - 1, '\xED');
+            if (pch + 1 < pchEnd && static_cast<BYTE>(pch[1]) >= 0xA0) return 0;
+        }
+        return pchToNext - pchDest;
+    }
+
+private:
+    std::codecvt_utf8_utf16<wchar_t> m_cvt;
+};
+
+
+//------------------------------------------------------------------------------
+// UTF-8 to UTF-16 with Win32 MultiByteToWideChar (V2 and later).
+//------------------------------------------------------------------------------
+class Win32Transcoder
+{
+public:
+    typedef WCHAR CharType;
+
+    size_t Transcode(const CHAR* pchBegin, const CHAR* pchEnd, WCHAR* pchDest)
+    {
+        int cch = static_cast<int>(pchEnd - pchBegin);
+        // Fail on invalid UTF-8 rather than silently replacing it with U+FFFD,
+        // so that the dictionary can report the line.
+        return MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, pchBegin, cch, pchDest, cch);
+    }
+};
+
+
+//------------------------------------------------------------------------------
+// UTF-8 to the code units of Char, whatever the size of wchar_t: UTF-8
+// itself for char (checked, then copied), UTF-16 for char16_t and UTF-32
+// for char32_t. Like Win32Transcoder, fails on invalid UTF-8.
+//------------------------------------------------------------------------------
+template <typename Char>
+class UtfTranscoder
+{
+public:
+    typedef Char CharType;
+
+    size_t Transcode(const CHAR* pchBegin, const CHAR* pchEnd, Char* pchDest)
+    {
+        if (FindInvalidUtf8(pchBegin, pchEnd) != pchEnd) return 0;
+
+        // Well-formed: the lead byte gives the length of each sequence.
+        const BYTE* pb = reinterpret_cast<const BYTE*>(pchBegin);
+        const BYTE* pbEnd = reinterpret_cast<const BYTE*>(pchEnd);
+        Char* pch = pchDest;
+        while (pb < pbEnd) {
+            UINT32 cp = *pb++;
+            if (cp >= 0xF0) {
+                cp = ((cp & 0x07) << 18) | ((pb[0] & 0x3F) << 12) | ((pb[1] & 0x3F) << 6) | (pb[2] & 0x3F);
+                pb += 3;
+            } else if (cp >= 0xE0) {
+                cp = ((cp & 0x0F) << 12) | ((pb[0] & 0x3F) << 6) | (pb[1] & 0x3F);
+                pb += 2;
+            } else if (cp >= 0x80) {
+                cp = ((cp & 0x1F) << 6) | (pb[0] & 0x3F);
+                pb += 1;
+            }
+            pch = AppendCodePoint(pch, cp);
+        }
+        return pch - pchDest;
+    }
+
+private:
+    static char16_t* AppendCodePoint(char16_t* pch, UINT32 cp)
+    {
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            *pch++ = static_cast<char16_t>(0xD800 + (cp >> 10));
+            *pch++ = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+        } else {
+            *pch++ = static_cast<char16_t>(cp);
+        }
+        return pch;
+    }
+
+    static char32_t* AppendCodePoint(char32_t* pch, UINT32 cp)
+    {
+        *pch++ = cp;
+        return pch;
+    }
+};
+
+template <>
+inline size_t UtfTranscoder<char>::Transcode(const CHAR* pchBegin, const CHAR* pchEnd, char* pchDest)
+{
+    if (FindInvalidUtf8(pchBegin, pchEnd) != pchEnd) return 0;
+    std::copy(pchBegin, pchEnd, pchDest);
+    return pchEnd - pchBegin;
+}
+
+
+} // namespace cedict
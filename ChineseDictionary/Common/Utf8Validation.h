@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Utf8Validation.h -- UTF-8 validation of a whole text buffer, reporting the
+//                     lines that hold invalid sequences.
+//
+// The buffer is checked 16 bytes at a time with SSSE3, with the lookup
+// algorithm of Keiser and Lemire ("Validating UTF-8 In Less Than One
+// Instruction Per Byte", Software: Practice and Experience, 2021): three
+// table lookups on the nibbles of each byte and of the byte before it
+// classify every 2-byte sequence, and two saturating subtractions check
+// that 3- and 4-byte sequences get their continuation bytes. Blocks of
+// ASCII only take a single test.
+//
+// The vectorized pass only tells which blocks contain errors. The lines
+// around those blocks are then checked again one byte at a time, to report
+// them exactly, so valid text never leaves the fast path.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <intrin.h>     // for __cpuid
+#include <tmmintrin.h>  // SSSE3
+#include <algorithm>
+#include <cstring>      // for memcpy
+
+
+namespace cedict
+{
+
+
+//------------------------------------------------------------------------------
+// Scalar check, following the table of well-formed byte sequences of the
+// Unicode Standard (table 3-7): no overlong forms, no surrogates, nothing
+// above U+10FFFF. Returns the first byte of the first invalid sequence,
+// or pchEnd.
+//------------------------------------------------------------------------------
+inline const CHAR* FindInvalidUtf8(const CHAR* pchBegin, const CHAR* pchEnd)
+{
+    const BYTE* pb = reinterpret_cast<const BYTE*>(pchBegin);
+    const BYTE* pbEnd = reinterpret_cast<const BYTE*>(pchEnd);
+    while (pb < pbEnd) {
+        BYTE b = *pb;
+        if (b < 0x80) {
+            ++pb;
+            continue;
+        }
+
+        size_t cbCont;              // continuation bytes after the lead
+        BYTE bMin = 0x80;           // range of the first continuation byte
+        BYTE bMax = 0xBF;
+        if (b >= 0xC2 && b <= 0xDF) {
+            cbCont = 1;
+        } else if (b == 0xE0) {
+            cbCont = 2; bMin = 0xA0;
+        } else if (b == 0xED) {
+            cbCont = 2; bMax = 0x9F;
+        } else if (b >= 0xE1 && b <= 0xEF) {
+            cbCont = 2;
+        } else if (b == 0xF0) {
+            cbCont = 3; bMin = 0x90;
+        } else if (b == 0xF4) {
+            cbCont = 3; bMax = 0x8F;
+        } else if (b >= 0xF1 && b <= 0xF3) {
+            cbCont = 3;
+        } else {
+            break;
+        }
+
+        if (static_cast<size_t>(pbEnd - pb) <= cbCont) break;
+        if (pb[1] < bMin || pb[1] > bMax) break;
+        if (cbCont > 1 && (pb[2] & 0xC0) != 0x80) break;
+        if (cbCont > 2 && (pb[3] & 0xC0) != 0x80) break;
+        pb += cbCont + 1;
+    }
+    return reinterpret_cast<const CHAR*>(pb);
+}
+
+
+namespace detail
+{
+
+inline bool CpuHasSsse3()
+{
+    static const bool fSsse3 = []() {
+        int info[4] = {};
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+    }();
+    return fSsse3;
+}
+
+// Error classes of a pair of bytes (previous byte, current byte).
+// A pair is invalid when its three lookups have one class in common.
+const BYTE kTooShort = 1 << 0;      // lead followed by ASCII or by another lead
+const BYTE kTooLong = 1 << 1;       // ASCII followed by a continuation
+const BYTE kOverlong3 = 1 << 2;     // E0 80..9F
+const BYTE kTooLarge = 1 << 3;      // F4 90..BF, F5..FF 80..BF
+const BYTE kSurrogate = 1 << 4;     // ED A0..BF
+const BYTE kOverlong2 = 1 << 5;     // C0..C1 80..BF
+const BYTE kTooLarge1000 = 1 << 6;  // F5..FF 80..8F
+const BYTE kOverlong4 = 1 << 6;     // F0 80..8F
+const BYTE kTwoConts = 1 << 7;      // continuation after a continuation
+const BYTE kCarry = kTooShort | kTooLong | kTwoConts;
+
+class Utf8BlockValidator
+{
+public:
+    Utf8BlockValidator()
+        : m_prev(_mm_setzero_si128())
+        , m_prevIncomplete(_mm_setzero_si128())
+    {}
+
+    // Check the next 16 bytes; returns true if they (or the sequence
+    // left open by the previous block) contain an error.
+    bool CheckBlock(__m128i input)
+    {
+        __m128i error;
+        if (_mm_movemask_epi8(input) == 0) {
+            // ASCII only: valid, unless the previous block ended in the
+            // middle of a sequence.
+            error = m_prevIncomplete;
+            m_prevIncomplete = _mm_setzero_si128();
+        } else {
+            error = CheckMultibyteLengths(input, CheckSpecialCases(input));
+            m_prevIncomplete = IsIncomplete(input);
+        }
+        m_prev = input;
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF;
+    }
+
+    // At the end of the text: true if it stops in the middle of a sequence.
+    bool CheckEnd() const
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(m_prevIncomplete, _mm_setzero_si128())) != 0xFFFF;
+    }
+
+private:
+    static __m128i HighNibbles(__m128i v)
+    {
+        return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+    }
+
+    __m128i CheckSpecialCases(__m128i input) const
+    {
+        const __m128i byte1HighTable = _mm_setr_epi8(
+            // 0_______: ASCII
+            kTooLong, kTooLong, kTooLong, kTooLong,
+            kTooLong, kTooLong, kTooLong, kTooLong,
+            // 10______: continuation
+            static_cast<char>(kTwoConts), static_cast<char>(kTwoConts),
+            static_cast<char>(kTwoConts), static_cast<char>(kTwoConts),
+            // 1100____, 1101____: 2-byte lead
+            kTooShort | kOverlong2,
+            kTooShort,
+            // 1110____: 3-byte lead
+            kTooShort | kOverlong3 | kSurrogate,
+            // 1111____: 4-byte lead
+            kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+
+        const __m128i byte1LowTable = _mm_setr_epi8(
+            // ____0000
+            kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+            // ____0001
+            kCarry | kOverlong2,
+            // ____001_
+            kCarry,
+            kCarry,
+            // ____0100
+            kCarry | kTooLarge,
+            // ____0101 .. ____1100
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            // ____1101
+            kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+            // ____111_
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000);
+
+        const __m128i byte2HighTable = _mm_setr_epi8(
+            // 0_______: ASCII
+            kTooShort, kTooShort, kTooShort, kTooShort,
+            kTooShort, kTooShort, kTooShort, kTooShort,
+            // 1000____
+            static_cast<char>(kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4),
+            // 1001____
+            static_cast<char>(kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge),
+            // 101_____
+            static_cast<char>(kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge),
+            static_cast<char>(kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge),
+            // 11______: lead
+            kTooShort, kTooShort, kTooShort, kTooShort);
+
+        __m128i prev1 = _mm_alignr_epi8(input, m_prev, 15);
+        __m128i byte1High = _mm_shuffle_epi8(byte1HighTable, HighNibbles(prev1));
+        __m128i byte1Low = _mm_shuffle_epi8(byte1LowTable,
+            _mm_and_si128(prev1, _mm_set1_epi8(0x0F)));
+        __m128i byte2High = _mm_shuffle_epi8(byte2HighTable, HighNibbles(input));
+        return _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+    }
+
+    // Bytes 2 and 3 after a 3- or 4-byte lead must be continuations, which
+    // the pair classes above flag as kTwoConts: the two must agree.
+    __m128i CheckMultibyteLengths(__m128i input, __m128i special) const
+    {
+        __m128i prev2 = _mm_alignr_epi8(input, m_prev, 14);
+        __m128i prev3 = _mm_alignr_epi8(input, m_prev, 13);
+        __m128i isThirdByte = _mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80));
+        __m128i isFourthByte = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+        __m128i must23 = _mm_and_si128(_mm_or_si128(isThirdByte, isFourthByte),
+            _mm_set1_epi8(static_cast<char>(0x80)));
+        return _mm_xor_si128(must23, special);
+    }
+
+    // Nonzero where a lead in the last 3 bytes needs bytes of the next block.
+    static __m128i IsIncomplete(__m128i input)
+    {
+        const __m128i maxValue = _mm_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+        return _mm_subs_epu8(input, maxValue);
+    }
+
+    __m128i m_prev;
+    __m128i m_prevIncomplete;
+};
+
+} // namespace detail
+
+
+//------------------------------------------------------------------------------
+// Validate a whole text buffer, calling handler(pchLineBegin, pchLineEnd)
+// for each line ('\n' excluded) that holds invalid UTF-8, in text order.
+// Returns true if the whole text is valid.
+//------------------------------------------------------------------------------
+template <typename InvalidLineHandler>
+bool ValidateUtf8Lines(const CHAR* pch, size_t cb, InvalidLineHandler handler)
+{
+    const CHAR* const pchEnd = pch + cb;
+    const CHAR* pchChecked = pch;   // lines before this one are done
+    bool fValid = true;
+
+    // Check one line at a time the lines overlapping [pchFrom, pchTo).
+    auto checkLines = [&](const CHAR* pchFrom, const CHAR* pchTo) {
+        pchFrom = (std::max)(pchFrom, pchChecked);
+        if (pchFrom >= pchTo) return;
+        const CHAR* pchLine = pchFrom;
+        while (pchLine > pchChecked && pchLine[-1] != '\n') --pchLine;
+        while (pchLine < pchTo) {
+            const CHAR* pchEOL = std::find(pchLine, pchEnd, '\n');
+            if (FindInvalidUtf8(pchLine, pchEOL) != pchEOL) {
+                fValid = false;
+                handler(pchLine, pchEOL);
+            }
+            pchLine = pchEOL < pchEnd ? pchEOL + 1 : pchEnd;
+        }
+        pchChecked = pchLine;
+    };
+
+    if (!detail::CpuHasSsse3()) {
+        checkLines(pch, pchEnd);
+        return fValid;
+    }
+
+    // An error found in a block may come from a lead byte up to 3 bytes
+    // before it.
+    detail::Utf8BlockValidator validator;
+    size_t i = 0;
+    for (; i + 16 <= cb; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pch + i));
+        if (validator.CheckBlock(input)) {
+            checkLines(pch + (i < 3 ? 0 : i - 3), pch + i + 16);
+        }
+    }
+    if (i < cb) {
+        // Pad the tail with ASCII zeros, which also flags a sequence cut
+        // by the end of the text.
+        CHAR tail[16] = {};
+        memcpy(tail, pch + i, cb - i);
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+        if (validator.CheckBlock(input)) {
+            checkLines(pch + (i < 3 ? 0 : i - 3), pchEnd);
+        }
+    } else if (validator.CheckEnd()) {
+        checkLines(pch + (cb < 3 ? 0 : cb - 3), pchEnd);
+    }
+    return fValid;
+}
+
+
+} // namespace cedict
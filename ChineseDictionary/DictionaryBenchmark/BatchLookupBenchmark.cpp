@@ -0,0 +1,158 @@
+// Batched headword lookups.
+//
+// Writes a scaled copy of the dictionary (every entry repeated with a
+// numbered headword, 8 times by default or as given on the command line) so
+// that the index, the entries and the strings are well beyond the last
+// level cache, then resolves random headwords and reads their pinyin: one
+// by one with Find(), and with FindBatch() in batches of 1, 8, 32 and 128.
+// The query headwords are copied to a buffer of their own, like the
+// headwords of a request would be.
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdio>   // for std::remove
+#include <cstdlib>  // for atoi
+#include <fstream>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "MappedTextFile.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using bench::BestTime;
+using bench::NextRandom;
+
+
+namespace
+{
+
+const int kRuns = 3;
+const int kDefaultScale = 8;
+const size_t kLookups = 4 * 1000 * 1000;
+const char kScaledFile[] = "cedict-scaled.u8";
+
+typedef cedict::TextSpan<WCHAR> Span;
+
+// Writes the entry lines of the dictionary scale times; copy n > 0 has n
+// appended to its traditional headword, so that all the headwords differ.
+bool WriteScaledCopy(int scale)
+{
+    cedict::MappedTextFile mtf(bench::kDictionaryFile);
+    const CHAR* pch = mtf.Buffer();
+    const CHAR* pchEnd = pch + mtf.Length();
+    if (!pch) return false;
+
+    std::ofstream out(kScaledFile, std::ios::out | std::ios::binary);
+    while (pch < pchEnd) {
+        const CHAR* pchEOL = std::find(pch, pchEnd, '\n');
+        const CHAR* pchSpace = std::find(pch, pchEOL, ' ');
+        if (pch < pchEOL && *pch != '#' && pchSpace < pchEOL) {
+            for (int n = 0; n < scale; ++n) {
+                out.write(pch, pchSpace - pch);
+                if (n > 0) out << n;
+                out.write(pchSpace, pchEOL - pchSpace);
+                out << '\n';
+            }
+        }
+        pch = pchEOL + 1;
+    }
+    return static_cast<bool>(out);
+}
+
+template <typename Lookup>
+double BestNanoseconds(Lookup lookup)
+{
+    return BestTime(kRuns, lookup) * 1e6 / kLookups;
+}
+
+void PrintResult(const char* pszName, double ns, double nsBaseline)
+{
+    cout << "  " << std::left << setw(22) << pszName << std::right
+        << setw(10) << ns << " ns/lookup" << setw(10) << nsBaseline / ns << "x\n";
+}
+
+} // namespace
+
+
+int bench::BatchLookupBenchmark(int argc, char* argv[])
+{
+    int scale = argc > 0 ? atoi(argv[0]) : kDefaultScale;
+    if (scale < 1) scale = kDefaultScale;
+    if (!WriteScaledCopy(scale)) {
+        cout << "Cannot write the scaled dictionary.\n";
+        return 1;
+    }
+
+    cedict::DictionaryOptions options;
+    options.presize = true;
+    options.buildIndex = true;
+    DictionaryV4 dict(TEXT("cedict-scaled.u8"), options);
+    std::remove(kScaledFile);
+
+    // Random headwords, copied out of the dictionary.
+    std::vector<WCHAR> queryText;
+    std::vector<size_t> queryOffsets;
+    UINT32 state = 2463534242u;
+    for (size_t i = 0; i < kLookups; ++i) {
+        Span trad = DictionaryV4::View(dict.Item(NextRandom(state) % dict.Length()).trad);
+        queryOffsets.push_back(queryText.size());
+        queryText.insert(queryText.end(), trad.pchBegin, trad.pchEnd);
+    }
+    queryOffsets.push_back(queryText.size());
+    std::vector<Span> keys;
+    for (size_t i = 0; i < kLookups; ++i) {
+        keys.push_back(cedict::MakeSpan(&queryText[queryOffsets[i]], &queryText[queryOffsets[i + 1]]));
+    }
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "Batched lookups (V4 x" << scale << ", " << dict.Length() << " entries, "
+        << dict.Statistics().cStorageChunks << " pool chunks; "
+        << kLookups << " random headwords, best of " << kRuns << " runs)\n\n";
+
+    size_t checksum = 0;
+    size_t cFound = 0;
+    double nsFind = BestNanoseconds([&]() {
+        cFound = 0;
+        for (size_t i = 0; i < kLookups; ++i) {
+            UINT32 id = dict.Find(keys[i].pchBegin, keys[i].pchEnd);
+            if (id == cedict::kNoEntry) continue;
+            checksum += dict.Item(id).pinyin[0];
+            cFound++;
+        }
+    });
+    PrintResult("Find(), one by one", nsFind, nsFind);
+    if (cFound != kLookups) {
+        cout << "Only " << cFound << " of the headwords were found.\n";
+        return 1;
+    }
+
+    const size_t kBatchSizes[] = { 1, 8, 32, 128 };
+    for (size_t batchSize : kBatchSizes) {
+        std::vector<UINT32> ids(batchSize);
+        size_t cBatchFound = 0;
+        double ns = BestNanoseconds([&]() {
+            cBatchFound = 0;
+            for (size_t i = 0; i < kLookups; i += batchSize) {
+                size_t c = (std::min)(batchSize, kLookups - i);
+                dict.FindBatch(&keys[i], c, ids.data());
+                for (size_t j = 0; j < c; ++j) {
+                    if (ids[j] == cedict::kNoEntry) continue;
+                    checksum += dict.Item(ids[j]).pinyin[0];
+                    cBatchFound++;
+                }
+            }
+        });
+        std::string name = "FindBatch(), " + std::to_string(batchSize);
+        PrintResult(name.c_str(), ns, nsFind);
+        if (cBatchFound != cFound) {
+            cout << "FindBatch() found " << cBatchFound << " headwords, Find() " << cFound << ".\n";
+            return 1;
+        }
+    }
+    return checksum != 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// BenchmarkHelpers.h -- Random numbers, clocks, best-of-runs timing and
+//                       code points, shared by the benchmarks.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <type_traits>
+#include "Stopwatch.h"
+
+
+namespace bench
+{
+
+
+// xorshift32: cheap enough to stay out of the measurements, and the same
+// sequence on every run for a given seed.
+inline UINT32 NextRandom(UINT32& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Performance counter ticks, to time single operations.
+inline LONGLONG Now()
+{
+    LARGE_INTEGER li;
+    QueryPerformanceCounter(&li);
+    return li.QuadPart;
+}
+
+inline double Megabytes(double cb)
+{
+    return cb / (1024 * 1024);
+}
+
+// Best time of cRuns calls of f, in milliseconds; setup is called before
+// each of them, outside of the time.
+template <typename Setup, typename Function>
+double BestTime(int cRuns, Setup setup, Function f)
+{
+    double bestTime = 0;
+    for (int run = 0; run < cRuns; ++run) {
+        setup();
+        win32::Stopwatch sw;
+        sw.Start();
+        f();
+        sw.Stop();
+        if (run == 0 || sw.ElapsedMilliseconds() < bestTime) {
+            bestTime = sw.ElapsedMilliseconds();
+        }
+    }
+    return bestTime;
+}
+
+template <typename Function>
+double BestTime(int cRuns, Function f)
+{
+    return BestTime(cRuns, []() {}, f);
+}
+
+
+namespace detail
+{
+
+inline void AppendCodePoints(const char* pch, const char* pchEnd, std::u32string& out, std::true_type)
+{
+    while (pch < pchEnd) {
+        UINT32 cp = static_cast<BYTE>(*pch++);
+        int cTrail = cp >= 0xF0 ? 3 : cp >= 0xE0 ? 2 : cp >= 0xC0 ? 1 : 0;
+        if (cTrail > 0) cp &= 0x3F >> cTrail;
+        for (; cTrail > 0 && pch < pchEnd; --cTrail) cp = (cp << 6) | (static_cast<BYTE>(*pch++) & 0x3F);
+        out.push_back(static_cast<char32_t>(cp));
+    }
+}
+
+// UTF-16, or UTF-32, which has no surrogates to pair. WCHAR text is UTF-16
+// whatever the size of WCHAR.
+template <typename Char>
+void AppendCodePoints(const Char* pch, const Char* pchEnd, std::u32string& out, std::false_type)
+{
+    while (pch < pchEnd) {
+        UINT32 cp = static_cast<UINT32>(*pch++);
+        UINT32 low = pch < pchEnd ? static_cast<UINT32>(*pch) : 0;
+        if (cp >= 0xD800 && cp < 0xDC00 && low >= 0xDC00 && low < 0xE000) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            ++pch;
+        }
+        out.push_back(static_cast<char32_t>(cp));
+    }
+}
+
+} // namespace detail
+
+// Appends the code points of [pchBegin, pchEnd), UTF-8, UTF-16 or UTF-32
+// by the size of Char, so that text stored in any width compares equal.
+template <typename Char>
+void AppendCodePoints(const Char* pchBegin, const Char* pchEnd, std::u32string& out)
+{
+    detail::AppendCodePoints(pchBegin, pchEnd, out, std::integral_constant<bool, sizeof(Char) == 1>());
+}
+
+
+} // namespace bench
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks.h -- Entry points of the benchmarks run by DictionaryBenchmark.
+//
+// Each benchmark receives the command line arguments that follow its name
+// and returns the process exit code.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+
+namespace bench
+{
+
+
+// Two-pass exact-size load vs. the default one-pass load.
+int PresizeBenchmark(int argc, char* argv[]);
+
+// Random entry reads with the entries and strings on large pages or not.
+int LargePagesBenchmark(int argc, char* argv[]);
+
+// Multi-threaded lookups on a shared dictionary vs. per-NUMA-node replicas.
+int NumaBenchmark(int argc, char* argv[]);
+
+// English glosses compressed with a symbol table vs. plain pool strings.
+int GlossCompressionBenchmark(int argc, char* argv[]);
+
+// Foreground cost of destroying a dictionary in place vs. retiring it.
+int TeardownBenchmark(int argc, char* argv[]);
+
+// UTF-8 validation throughput, and reporting of the invalid lines.
+int Utf8ValidationBenchmark(int argc, char* argv[]);
+
+// Tone number to tone mark conversion of the pinyin.
+int PinyinBenchmark(int argc, char* argv[]);
+
+// Traditional/simplified conversion tables learnt from the headwords.
+int ScriptConversionBenchmark(int argc, char* argv[]);
+
+// Headword lookups one by one vs. batched with prefetching.
+int BatchLookupBenchmark(int argc, char* argv[]);
+
+// Maximum-match segmentation with and without the headword filter.
+int SegmentationBenchmark(int argc, char* argv[]);
+
+// Eytzinger ordered index vs. std::lower_bound on a sorted vector.
+int SortedIndexBenchmark(int argc, char* argv[]);
+
+// Lookup latency percentiles and throughput, uniform and Zipf workloads.
+int LookupBenchmark(int argc, char* argv[]);
+
+// Allocations, peak working set and memory breakdown of each variant.
+int MemoryBenchmark(int argc, char* argv[]);
+
+// Cost of tracing, and Chrome trace of a multi-threaded load session.
+int TraceBenchmark(int argc, char* argv[]);
+
+// One pass over the entries with EntryReader vs. a full load and a pass.
+int EntryReaderBenchmark(int argc, char* argv[]);
+
+// Lookups through DictionaryServer, with pipelined requests.
+int ServerClientBenchmark(int argc, char* argv[]);
+
+// Worker processes attached to a shared dictionary image vs. loading their own.
+int SharedImageBenchmark(int argc, char* argv[]);
+
+// Load time and memory of UTF-8, UTF-16 and UTF-32 code units in storage.
+int StorageWidthBenchmark(int argc, char* argv[]);
+
+// Fuzzy English search with the trigram index vs. brute force.
+int FuzzySearchBenchmark(int argc, char* argv[]);
+
+// Typo tolerant pinyin search, at dictionary and 10 times scale, vs. brute force.
+int FuzzyPinyinBenchmark(int argc, char* argv[]);
+
+// Startup time with the indexes built on 1, 2, 4... threads.
+int ParallelBuildBenchmark(int argc, char* argv[]);
+
+// Sorting the entry ids by headword and pinyin, radix sort vs. std::sort.
+int RadixSortBenchmark(int argc, char* argv[]);
+
+// Load-time cost of the cross-reference graph, and following its links.
+int CrossReferenceBenchmark(int argc, char* argv[]);
+
+// Differential check of the variants on the dictionary and fuzzed files.
+int VerifyBenchmark(int argc, char* argv[]);
+
+// True if all the variants load the same entries from the dictionary file;
+// prints the differences otherwise. Run by the driver before a benchmark.
+bool VerifyVariants();
+
+
+} // namespace bench
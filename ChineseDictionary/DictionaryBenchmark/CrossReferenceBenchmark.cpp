@@ -0,0 +1,174 @@
+// Cross-reference graph: load-time cost and following the links.
+//
+// Loads the dictionary file, or the given one, with and without
+// DictionaryOptions::buildCrossReferences, and reports the references of
+// the glosses to other entries ("variant of X", "see X", "CL:X", see
+// CrossReferenceGraph.h), the links they resolve to and their memory. The
+// links of every entry are checked against its references resolved from
+// its glosses through the headword index, as a request would without the
+// graph, and following the references of random entries is timed both
+// ways. Give a CEDICT file to measure real references.
+//
+// Usage: DictionaryBenchmark crossrefs [file]
+
+#include <windows.h>
+#include <algorithm>
+#include <cstring>      // for strlen
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::vector;
+using bench::BestTime;
+using bench::DictionaryV4;
+using bench::NextRandom;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const int kLookups = 200 * 1000;
+
+typedef cedict::CrossReferenceGraph<WCHAR> Graph;
+
+
+// The links of entry id, resolved as the graph does it, but from the
+// glosses and the headword index on every call: linked entry and kind in
+// each, sorted, without duplicates.
+void ResolveFromGlosses(const DictionaryV4& dict, UINT32 id, vector<UINT32>& links)
+{
+    links.clear();
+    cedict::ForEachCrossReference(DictionaryV4::View(dict.Item(id).english),
+        [&](const cedict::CrossReference<WCHAR>& ref) {
+            UINT32 first = dict.Find(ref.trad.pchBegin, ref.trad.pchEnd);
+            bool fPinyinMatch = false;
+            for (UINT32 e = first; e != cedict::kNoEntry && !fPinyinMatch; e = dict.Index().Next(e)) {
+                fPinyinMatch = DictionaryV4::View(dict.Item(e).pinyin) == ref.pinyin;
+            }
+            const UINT32 kind = static_cast<UINT32>(ref.kind) << Graph::kLinkKindShift;
+            for (UINT32 e = first; e != cedict::kNoEntry; e = dict.Index().Next(e)) {
+                bool fMatch = !fPinyinMatch || DictionaryV4::View(dict.Item(e).pinyin) == ref.pinyin;
+                if (e != id && fMatch) links.push_back(kind | e);
+            }
+        });
+    std::sort(links.begin(), links.end());
+    links.erase(std::unique(links.begin(), links.end()), links.end());
+}
+
+// The entries whose links in the graph are not those resolved from their
+// glosses.
+size_t CountDifferentLinks(const DictionaryV4& dict)
+{
+    const Graph& graph = dict.CrossReferences();
+    vector<UINT32> links;
+    size_t cDifferent = 0;
+    for (UINT32 i = 0; i < static_cast<UINT32>(dict.Length()); ++i) {
+        ResolveFromGlosses(dict, i, links);
+        cDifferent += !std::equal(links.begin(), links.end(), graph.LinksBegin(i), graph.LinksEnd(i));
+    }
+    return cDifferent;
+}
+
+} // namespace
+
+
+int bench::CrossReferenceBenchmark(int argc, char* argv[])
+{
+    const std::basic_string<TCHAR> file = argc > 0
+        ? std::basic_string<TCHAR>(argv[0], argv[0] + strlen(argv[0])) : kDictionaryFile;
+    const LPCTSTR pszFile = file.c_str();
+    cout << std::fixed << std::setprecision(1);
+
+    cedict::DictionaryOptions options;
+    options.buildCrossReferences = true;
+    double loadTime = BestTime(kRuns, [&]() { DictionaryV4 dict(pszFile); });
+    double graphLoadTime = BestTime(kRuns, [&]() { DictionaryV4 dict(pszFile, options); });
+
+    options.buildIndex = true;
+    DictionaryV4 dict(pszFile, options);
+    if (dict.Length() == 0) {
+        cout << "The dictionary is empty.\n";
+        return 1;
+    }
+    const Graph& graph = dict.CrossReferences();
+    double buildTime = BestTime(kRuns, [&]() {
+        Graph rebuilt;
+        vector<cedict::TextSpan<WCHAR>> trad(dict.Length()), pinyin(dict.Length());
+        for (int i = 0; i < dict.Length(); ++i) {
+            trad[i] = DictionaryV4::View(dict.Item(i).trad);
+            pinyin[i] = DictionaryV4::View(dict.Item(i).pinyin);
+        }
+        rebuilt.Build(trad, pinyin, [&](size_t i, vector<WCHAR>&) {
+            return DictionaryV4::View(dict.Item(static_cast<int>(i)).english);
+        }, false);
+    });
+
+    size_t linksByKind[cedict::kCrossReferenceKinds] = {};
+    size_t cLinkedEntries = 0;
+    for (UINT32 i = 0; i < static_cast<UINT32>(dict.Length()); ++i) {
+        for (const UINT32* p = graph.LinksBegin(i); p != graph.LinksEnd(i); ++p) {
+            linksByKind[Graph::LinkKind(*p)]++;
+        }
+        cLinkedEntries += graph.LinksBegin(i) != graph.LinksEnd(i);
+    }
+    size_t cDifferent = CountDifferentLinks(dict);
+    cout << "V4 load, best of " << kRuns << " runs, one thread\n";
+    cout << "  without the graph:  " << setw(7) << loadTime << " ms\n";
+    cout << "  with the graph:     " << setw(7) << graphLoadTime << " ms (+"
+        << (loadTime > 0 ? 100 * (graphLoadTime - loadTime) / loadTime : 0.0) << "%)\n";
+    cout << "  graph build alone:  " << setw(7) << buildTime << " ms\n\n";
+    cout << "  " << graph.ReferenceCount() << " references, " << graph.UnresolvedCount()
+        << " unresolved; " << graph.LinkCount() << " links from " << cLinkedEntries << " entries: "
+        << linksByKind[cedict::kVariantReference] << " variant, " << linksByKind[cedict::kSeeReference]
+        << " see, " << linksByKind[cedict::kClassifierReference] << " classifier\n";
+    cout << "  " << graph.Bytes() / 1024 << " KB with the reverse links, "
+        << static_cast<double>(graph.Bytes()) / dict.Length() << " bytes per entry\n";
+    cout << "  " << cDifferent << " entries with other links than their glosses\n\n";
+
+    // The same random entries both ways.
+    vector<UINT32> ids(kLookups);
+    UINT32 state = 88675123u;
+    for (UINT32& id : ids) id = NextRandom(state) % dict.Length();
+    UINT64 graphChecksum = 0, glossChecksum = 0;
+    size_t cGraphFound = 0, cGlossFound = 0;
+    double graphTime = BestTime(kRuns, [&]() {
+        graphChecksum = 0;
+        cGraphFound = 0;
+        for (UINT32 id : ids) {
+            for (const UINT32* p = graph.LinksBegin(id); p != graph.LinksEnd(id); ++p) {
+                graphChecksum += DictionaryV4::View(dict.Item(Graph::LinkedEntry(*p)).trad).Length();
+                cGraphFound++;
+            }
+        }
+    });
+    vector<UINT32> links;
+    double glossTime = BestTime(kRuns, [&]() {
+        glossChecksum = 0;
+        cGlossFound = 0;
+        for (UINT32 id : ids) {
+            ResolveFromGlosses(dict, id, links);
+            for (UINT32 link : links) {
+                glossChecksum += DictionaryV4::View(dict.Item(Graph::LinkedEntry(link)).trad).Length();
+            }
+            cGlossFound += links.size();
+        }
+    });
+    cout << "Following the references of " << kLookups << " random entries\n";
+    cout << "  through the graph:       " << setw(7) << graphTime * 1e6 / kLookups << " ns per entry, "
+        << cGraphFound << " entries reached\n";
+    cout << "  parsing the glosses:     " << setw(7) << glossTime * 1e6 / kLookups << " ns per entry, "
+        << cGlossFound << " entries reached\n";
+
+    if (cDifferent != 0 || cGraphFound != cGlossFound || graphChecksum != glossChecksum) {
+        cout << "The graph does not link the references of the glosses.\n";
+        return 1;
+    }
+    return 0;
+}
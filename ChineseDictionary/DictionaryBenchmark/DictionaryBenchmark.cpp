@@ -0,0 +1,94 @@
+// DictionaryBenchmark - Runs the benchmarks that go beyond the loading times
+//                       measured by the LoadDictionary programs.
+//
+// Usage: DictionaryBenchmark [--no-verify] <benchmark> [arguments]
+//
+// As for the other programs, the dictionary file (cedict.u8) must be in the
+// current directory. Before running a benchmark, the driver checks that all
+// the loader variants load the same entries from it (see VerifyBenchmark.cpp)
+// and fails if they do not, unless --no-verify is given.
+
+#include <windows.h>
+#include <cstring>
+#include <iostream> // for cin/cout
+#include "Benchmarks.h"
+
+using std::cout;
+
+
+namespace
+{
+
+struct BenchmarkInfo
+{
+    const char* name;
+    const char* description;
+    int (*run)(int argc, char* argv[]);
+};
+
+const BenchmarkInfo g_benchmarks[] = {
+    { "presize", "Two-pass exact-size load vs. one-pass load", bench::PresizeBenchmark },
+    { "largepages", "Random entry reads with and without large pages", bench::LargePagesBenchmark },
+    { "numa", "Multi-threaded lookups, shared dictionary vs. NUMA replicas", bench::NumaBenchmark },
+    { "glosscompression", "Compressed English glosses: ratio, decode and load cost", bench::GlossCompressionBenchmark },
+    { "teardown", "Dictionary destruction in place vs. on a background thread", bench::TeardownBenchmark },
+    { "utf8", "SIMD UTF-8 validation and malformed line reporting", bench::Utf8ValidationBenchmark },
+    { "pinyin", "Compile-time pinyin tables and tone mark conversion", bench::PinyinBenchmark },
+    { "script", "Traditional/simplified conversion with longest-match phrases", bench::ScriptConversionBenchmark },
+    { "batch", "Batched headword lookups with prefetching [scale]", bench::BatchLookupBenchmark },
+    { "segment", "Maximum-match segmentation with a Bloom filter of the headwords", bench::SegmentationBenchmark },
+    { "sorted", "Eytzinger ordered index vs. std::lower_bound [scales]", bench::SortedIndexBenchmark },
+    { "lookup", "Lookup latency histogram and QPS, uniform and Zipf workloads [threads] [s]", bench::LookupBenchmark },
+    { "trace", "Loader phases of each thread as a Chrome trace [file]", bench::TraceBenchmark },
+    { "verify", "Differential check of the variants, on the dictionary and fuzzed files [files]", bench::VerifyBenchmark },
+    { "memory", "Allocations, peak working set and memory breakdown per variant [variant]", bench::MemoryBenchmark },
+    { "reader", "One pass over the entries with EntryReader vs. a full load [way]", bench::EntryReaderBenchmark },
+    { "client", "Lookups through DictionaryServer, pipelined [connections] [depth]", bench::ServerClientBenchmark },
+    { "shared", "Workers attached to a shared memory dictionary image vs. own loads [workers]", bench::SharedImageBenchmark },
+    { "width", "UTF-8, UTF-16 and UTF-32 storage: load time and memory", bench::StorageWidthBenchmark },
+    { "fuzzy", "Misspelled English queries, trigram index vs. brute force [k]", bench::FuzzySearchBenchmark },
+    { "fuzzypinyin", "Typo tolerant pinyin search with Myers distance, 1x and 10x [k]", bench::FuzzyPinyinBenchmark },
+    { "parallelbuild", "Startup time with the indexes built by a work-stealing pool [threads...]", bench::ParallelBuildBenchmark },
+    { "radixsort", "Entry ids sorted by headword and pinyin, radix sort vs. std::sort [threads]", bench::RadixSortBenchmark },
+    { "crossrefs", "Variant, see and classifier references resolved into a link graph at load [file]", bench::CrossReferenceBenchmark },
+};
+
+void PrintUsage()
+{
+    cout << "Usage: DictionaryBenchmark [--no-verify] <benchmark> [arguments]\n\n";
+    cout << "Benchmarks:\n";
+    for (const BenchmarkInfo& b : g_benchmarks) {
+        cout << "  " << b.name << "\t" << b.description << '\n';
+    }
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+    bool fVerify = true;
+    if (argc > 1 && strcmp(argv[1], "--no-verify") == 0) {
+        fVerify = false;
+        argc--;
+        argv++;
+    }
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    for (const BenchmarkInfo& b : g_benchmarks) {
+        if (strcmp(argv[1], b.name) == 0) {
+            if (fVerify && b.run != bench::VerifyBenchmark
+                && !bench::VerifyVariants()) {
+                return 1;
+            }
+            return b.run(argc - 2, argv + 2);
+        }
+    }
+
+    cout << "Unknown benchmark: " << argv[1] << "\n\n";
+    PrintUsage();
+    return 1;
+}
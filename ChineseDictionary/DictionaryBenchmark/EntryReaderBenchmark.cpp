@@ -0,0 +1,129 @@
+// One pass over the entries with EntryReader vs. a full load.
+//
+// A job that reads every entry once (here: count the entries and their
+// characters, and hash the headwords) either loads a Dictionary and then
+// walks its entries, or reads them with an EntryReader, which only keeps
+// the line being parsed. Each way runs in a process of its own (this
+// program, run again with its name), so that its peak working set is its
+// own. The times include the destruction of the dictionary, which the job
+// also pays; both ways map the file, whose pages are in the working set.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <string>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "EntryReader.h"
+#include "ProcessCounters.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::BestTime;
+using bench::Megabytes;
+
+
+namespace
+{
+
+const int kRuns = 5;
+
+// What the job computes; the same whichever way the entries are read.
+struct PassResult
+{
+    PassResult() : cEntries(0), cch(0), hash(0) {}
+
+    template <typename Char>
+    void Add(const cedict::TextSpan<Char>& trad, const cedict::TextSpan<Char>& simp,
+        const cedict::TextSpan<Char>& pinyin, const cedict::TextSpan<Char>& english)
+    {
+        cEntries++;
+        cch += trad.Length() + simp.Length() + pinyin.Length() + english.Length();
+        hash ^= cedict::HashSpan(trad);
+    }
+
+    size_t cEntries;
+    size_t cch;
+    UINT32 hash;
+};
+
+template <typename Dictionary>
+PassResult LoadAndIterate()
+{
+    PassResult result;
+    Dictionary dict(bench::kDictionaryFile);
+    for (int i = 0; i < dict.Length(); ++i) {
+        const typename Dictionary::Entry& e = dict.Item(i);
+        result.Add(Dictionary::View(e.trad), Dictionary::View(e.simp),
+            Dictionary::View(e.pinyin), Dictionary::View(e.english));
+    }
+    return result;
+}
+
+PassResult ReadEntries()
+{
+    PassResult result;
+    cedict::EntryReader<> reader(bench::kDictionaryFile);
+    for (const auto& entry : reader) {
+        result.Add(entry.trad, entry.simp, entry.pinyin, entry.english);
+    }
+    return result;
+}
+
+struct WayInfo
+{
+    const char* name;
+    const char* description;
+    PassResult (*pass)();
+};
+
+const WayInfo g_ways[] = {
+    { "V2", "full load with wstring, then a pass", LoadAndIterate<bench::DictionaryV2> },
+    { "V4", "full load with the string pool, then a pass", LoadAndIterate<bench::DictionaryV4> },
+    { "reader", "EntryReader", ReadEntries },
+};
+
+void MeasureWay(const WayInfo& way)
+{
+    PROCESS_MEMORY_COUNTERS pmcStart = bench::QueryMemoryCounters();
+    PassResult result;
+    double bestTime = BestTime(kRuns, [&]() { result = way.pass(); });
+    PROCESS_MEMORY_COUNTERS pmc = bench::QueryMemoryCounters();
+
+    cout << std::left << std::setw(8) << way.name << std::right
+        << std::setw(9) << bestTime << " ms"
+        << std::setw(10) << result.cEntries / (bestTime ? bestTime : 1) / 1000 << " M entries/s"
+        << std::setw(10) << Megabytes(pmc.PeakWorkingSetSize - pmcStart.WorkingSetSize)
+        << " MB peak working set (" << way.description << ")\n";
+    cout << std::setw(8) << "" << result.cEntries << " entries, " << result.cch
+        << " characters, headword hash " << std::hex << result.hash << std::dec << '\n';
+}
+
+} // namespace
+
+
+int bench::EntryReaderBenchmark(int argc, char* argv[])
+{
+    cout << std::fixed << std::setprecision(1);
+    if (argc > 0) {
+        for (const WayInfo& way : g_ways) {
+            if (_stricmp(argv[0], way.name) == 0) {
+                MeasureWay(way);
+                return 0;
+            }
+        }
+        cout << "Unknown way of reading: " << argv[0] << '\n';
+        return 1;
+    }
+
+    cout << "One pass over the entries, best of " << kRuns << " runs (one process each)\n\n";
+    for (const WayInfo& way : g_ways) {
+        cout.flush();
+        std::string arguments = std::string("reader ") + way.name;
+        if (!bench::RunBenchmarkProcess(arguments.c_str())) {
+            cout << "Cannot measure " << way.name << ".\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+// Typo tolerant pinyin search: filters and Myers distance vs. brute force.
+//
+// Makes queries from the pinyin of random entries, typed as users do: the
+// tones dropped from half of them, some initials and finals confused (zh/z,
+// ch/c, sh/s, ng/n), the spaces left out of half of them, then up to k
+// random letters inserted, deleted or replaced. Searches them with the
+// fuzzy pinyin index of V4 (see FuzzyPinyinIndex.h), on the dictionary and
+// on 10 times as many entries: the dictionary, and 9 copies of it with
+// each syllable replaced by a random syllable of the dictionary. Then
+// searches a sample of them by brute force, with the same ranking, by
+// computing the distance to every entry with the Myers algorithm, and with
+// the usual dynamic programming, to compare with the filters of the index
+// and with the bit-parallel distance.
+//
+// Usage: DictionaryBenchmark fuzzypinyin [k]   (k = 1 and 2 by default)
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdlib>      // for atoi
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::string;
+using std::vector;
+using std::wstring;
+using bench::NextRandom;
+using cedict::FuzzyMatch;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kQueries = 5000;
+const int kBruteForceQueries = 100;
+const size_t kTopResults = 10;
+const int kScale = 10;
+
+typedef cedict::FuzzyPinyinIndex<WCHAR> FuzzyPinyinIndex;
+
+
+vector<wstring> SplitSyllables(const wstring& pinyin)
+{
+    vector<wstring> syllables;
+    size_t i = 0;
+    while (i < pinyin.size()) {
+        size_t j = pinyin.find(L' ', i);
+        if (j == wstring::npos) j = pinyin.size();
+        if (j > i) syllables.push_back(pinyin.substr(i, j - i));
+        i = j + 1;
+    }
+    return syllables;
+}
+
+// Swaps zh/z, ch/c, sh/s at the start of the syllable, or ng/n at its end.
+void Confuse(wstring& syllable, UINT32& state)
+{
+    size_t cch = syllable.size();
+    while (cch > 0 && syllable[cch - 1] >= L'1' && syllable[cch - 1] <= L'5') cch--;
+    if (NextRandom(state) % 2 == 0 && cch >= 2) {
+        WCHAR ch = syllable[0];
+        if (ch == L'z' || ch == L'c' || ch == L's') {
+            if (syllable[1] == L'h') {
+                syllable.erase(1, 1);
+            } else {
+                syllable.insert(1, 1, L'h');
+            }
+        }
+    } else if (cch >= 2 && syllable[cch - 1] == L'g' && syllable[cch - 2] == L'n') {
+        syllable.erase(cch - 1, 1);
+    } else if (cch >= 1 && syllable[cch - 1] == L'n') {
+        syllable.insert(cch, 1, L'g');
+    }
+}
+
+wstring MakeQuery(const wstring& pinyin, UINT32 maxEdits, UINT32& state)
+{
+    vector<wstring> syllables = SplitSyllables(pinyin);
+    bool fDropTones = NextRandom(state) % 2 == 0;
+    bool fSpaces = NextRandom(state) % 2 == 0;
+    wstring query;
+    for (wstring& syllable : syllables) {
+        if (fDropTones && !syllable.empty() && syllable.back() >= L'1' && syllable.back() <= L'5') {
+            syllable.pop_back();
+        }
+        if (NextRandom(state) % 4 == 0) Confuse(syllable, state);
+        if (fSpaces && !query.empty()) query += L' ';
+        query += syllable;
+    }
+    UINT32 cEdits = NextRandom(state) % (maxEdits + 1);
+    for (UINT32 e = 0; e < cEdits && !query.empty(); ++e) {
+        size_t i = NextRandom(state) % query.size();
+        WCHAR ch = static_cast<WCHAR>(L'a' + NextRandom(state) % 26);
+        switch (NextRandom(state) % 3) {
+        case 0: query[i] = ch; break;
+        case 1: query.insert(query.begin() + i, ch); break;
+        default: query.erase(query.begin() + i); break;
+        }
+    }
+    return query;
+}
+
+// The dictionary, and kScale - 1 copies of it with random syllables.
+vector<wstring> MakeScaledPinyin(const vector<wstring>& pinyin, UINT32& state)
+{
+    vector<wstring> pool;
+    for (const wstring& p : pinyin) {
+        vector<wstring> syllables = SplitSyllables(p);
+        pool.insert(pool.end(), syllables.begin(), syllables.end());
+    }
+    vector<wstring> scaled(pinyin);
+    for (int copy = 1; copy < kScale; ++copy) {
+        for (const wstring& p : pinyin) {
+            size_t cSyllables = SplitSyllables(p).size();
+            wstring synthetic;
+            for (size_t s = 0; s < cSyllables; ++s) {
+                if (s > 0) synthetic += L' ';
+                synthetic += pool[NextRandom(state) % pool.size()];
+            }
+            scaled.push_back(synthetic);
+        }
+    }
+    return scaled;
+}
+
+struct Spelling
+{
+    string folded;
+    string written;
+};
+
+struct Candidate
+{
+    UINT32 entryId;
+    UINT32 distance;
+    UINT32 writtenDistance;
+};
+
+// The search of FuzzyPinyinIndex::Searcher, without its filters: the
+// distance to every entry, with the Myers algorithm or the dynamic
+// programming of BoundedEditDistance().
+void BruteForceSearch(const vector<Spelling>& spellings, const wstring& query, UINT32 maxEdits,
+    bool fMyers, vector<FuzzyMatch>& results)
+{
+    char folded[cedict::kMaxFuzzyPinyinLength];
+    char written[cedict::kMaxFuzzyPinyinLength];
+    const WCHAR* pchEnd = query.data() + query.size();
+    size_t cchFolded = cedict::SpellPinyin(query.data(), pchEnd, true, folded, cedict::kMaxFuzzyPinyinLength);
+    size_t cchWritten = cedict::SpellPinyin(query.data(), pchEnd, false, written, cedict::kMaxFuzzyPinyinLength);
+    UINT64 peqFolded[cedict::kPinyinSymbolCount];
+    UINT64 peqWritten[cedict::kPinyinSymbolCount];
+    cedict::MakePinyinPattern(folded, cchFolded, peqFolded);
+    cedict::MakePinyinPattern(written, cchWritten, peqWritten);
+
+    vector<UINT32> row;
+    vector<Candidate> candidates;
+    for (size_t e = 0; e < spellings.size(); ++e) {
+        const Spelling& s = spellings[e];
+        UINT32 distance;
+        if (fMyers) {
+            distance = cedict::MyersDistance(peqFolded, cchFolded, s.folded.data(), s.folded.size(), maxEdits);
+        } else {
+            row.resize(s.folded.size() + 1);
+            distance = cedict::BoundedEditDistance(folded, cchFolded, s.folded.data(), s.folded.size(),
+                maxEdits, row.data());
+        }
+        if (distance > maxEdits) continue;
+        Candidate candidate = { static_cast<UINT32>(e), distance,
+            cedict::MyersDistance(peqWritten, cchWritten, s.written.data(), s.written.size(),
+                cedict::kMaxFuzzyPinyinLength) };
+        candidates.push_back(candidate);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.distance != b.distance ? a.distance < b.distance
+            : a.writtenDistance != b.writtenDistance ? a.writtenDistance < b.writtenDistance
+            : a.entryId < b.entryId;
+    });
+    results.clear();
+    for (size_t i = 0; i < candidates.size() && i < kTopResults; ++i) {
+        FuzzyMatch match = { candidates[i].entryId, candidates[i].distance };
+        results.push_back(match);
+    }
+}
+
+void MeasureScale(const char* pszScale, const vector<wstring>& pinyin, const vector<wstring>& queries,
+    UINT32 maxEdits)
+{
+    FuzzyPinyinIndex index;
+    index.Build(pinyin.size(), [&](size_t i) {
+        return cedict::MakeSpan(pinyin[i].data(), pinyin[i].data() + pinyin[i].size());
+    });
+    vector<Spelling> spellings(pinyin.size());
+    char buf[1024];
+    for (size_t i = 0; i < pinyin.size(); ++i) {
+        const WCHAR* pchBegin = pinyin[i].data();
+        const WCHAR* pchEnd = pchBegin + pinyin[i].size();
+        spellings[i].folded.assign(buf, cedict::SpellPinyin(pchBegin, pchEnd, true, buf, sizeof(buf)));
+        spellings[i].written.assign(buf, cedict::SpellPinyin(pchBegin, pchEnd, false, buf, sizeof(buf)));
+    }
+
+    FuzzyPinyinIndex::Searcher searcher(index);
+    vector<vector<FuzzyMatch>> indexed(queries.size());
+    UINT64 cCompared = 0;
+    size_t cFound = 0;
+    Stopwatch sw;
+    sw.Start();
+    for (size_t q = 0; q < queries.size(); ++q) {
+        const wstring& query = queries[q];
+        searcher.Search(cedict::MakeSpan(query.data(), query.data() + query.size()), maxEdits, kTopResults,
+            indexed[q]);
+        cCompared += searcher.ComparedEntries();
+        cFound += !indexed[q].empty();
+    }
+    sw.Stop();
+    double indexQps = queries.size() / (sw.ElapsedMilliseconds() / 1000);
+
+    double bruteQps[2];
+    size_t cExpected = 0;
+    size_t cRecalled = 0;
+    vector<FuzzyMatch> expected;
+    for (int fMyers = 1; fMyers >= 0; --fMyers) {
+        sw.Start();
+        for (int q = 0; q < kBruteForceQueries; ++q) {
+            BruteForceSearch(spellings, queries[q], maxEdits, fMyers != 0, expected);
+            if (!fMyers) continue;
+            cExpected += expected.size();
+            for (const FuzzyMatch& match : expected) {
+                for (const FuzzyMatch& found : indexed[q]) {
+                    if (found.entryId == match.entryId) {
+                        cRecalled++;
+                        break;
+                    }
+                }
+            }
+        }
+        sw.Stop();
+        bruteQps[fMyers] = kBruteForceQueries / (sw.ElapsedMilliseconds() / 1000);
+    }
+
+    cout << setw(3) << maxEdits << "  " << std::left << setw(6) << pszScale << std::right
+        << setw(10) << pinyin.size()
+        << setw(11) << indexQps
+        << setw(11) << static_cast<double>(cCompared) / queries.size()
+        << setw(9) << 100.0 * cFound / queries.size()
+        << setw(12) << bruteQps[1]
+        << setw(10) << bruteQps[0]
+        << setw(10) << (cExpected ? 100.0 * cRecalled / cExpected : 100.0) << '\n';
+}
+
+} // namespace
+
+
+int bench::FuzzyPinyinBenchmark(int argc, char* argv[])
+{
+    DictionaryV4 dict(kDictionaryFile);
+    if (dict.Length() == 0) {
+        cout << "The dictionary is empty.\n";
+        return 1;
+    }
+    Stopwatch sw;
+    sw.Start();
+    dict.BuildFuzzyPinyinIndex();
+    sw.Stop();
+
+    vector<wstring> pinyin;
+    for (int i = 0; i < dict.Length(); ++i) {
+        cedict::TextSpan<WCHAR> p = DictionaryV4::View(dict.Item(i).pinyin);
+        pinyin.push_back(wstring(p.pchBegin, p.pchEnd));
+    }
+    UINT32 state = 2463534242u;
+    vector<wstring> scaled = MakeScaledPinyin(pinyin, state);
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "Fuzzy pinyin search: index of " << dict.FuzzyPinyin().Bytes() / (1024.0 * 1024.0)
+        << " MB built in " << sw.ElapsedMilliseconds() << " ms\n";
+    cout << kQueries << " queries, top " << kTopResults << " entries; brute force on the first "
+        << kBruteForceQueries << " (one thread)\n\n";
+    cout << "  k  Scale    Entries  Index QPS   Compared  Found %  Myers QPS    DP QPS  Recall %\n";
+
+    vector<UINT32> edits = { 1, 2 };
+    if (argc > 0 && atoi(argv[0]) > 0) edits.assign(1, static_cast<UINT32>(atoi(argv[0])));
+    for (UINT32 maxEdits : edits) {
+        vector<wstring> queries;
+        for (int q = 0; q < kQueries; ++q) {
+            queries.push_back(MakeQuery(pinyin[NextRandom(state) % pinyin.size()], maxEdits, state));
+        }
+        MeasureScale("1x", pinyin, queries, maxEdits);
+        MeasureScale("10x", scaled, queries, maxEdits);
+    }
+    return 0;
+}
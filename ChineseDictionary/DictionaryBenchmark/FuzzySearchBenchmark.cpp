@@ -0,0 +1,214 @@
+// Fuzzy English search: trigram index vs. brute force.
+//
+// Loads V4 with the fuzzy gloss index (see FuzzyGlossIndex.h), then makes
+// misspelled queries from the words of random entries: one or two words,
+// each with up to k random edits (substitutions, insertions, deletions of a
+// letter), searched with k edits per word at most (fewer for short words,
+// see FuzzyEditsFor). Every query is searched with the index, timed one at a time,
+// then a sample of them by brute force: every word of every entry is
+// compared with the bounded edit distance, with the same ranking. The
+// recall is the share of the brute force top results that the index finds.
+//
+// Usage: DictionaryBenchmark fuzzy [k]   (k = 1 and 2 by default)
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdlib>      // for atoi
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "LatencyHistogram.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::string;
+using std::vector;
+using bench::LatencyHistogram;
+using bench::NextRandom;
+using bench::Now;
+using cedict::FuzzyMatch;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kQueries = 5000;
+const int kBruteForceQueries = 100;
+const size_t kTopResults = 10;
+const size_t kMinQueryWordLength = 4;
+
+typedef cedict::FuzzyGlossIndex<WCHAR> FuzzyGlossIndex;
+
+
+// Applies up to cEdits random edits of a letter to word.
+void Misspell(string& word, int cEdits, UINT32& state)
+{
+    for (int e = 0; e < cEdits; ++e) {
+        size_t i = NextRandom(state) % word.size();
+        char ch = static_cast<char>('a' + NextRandom(state) % 26);
+        switch (NextRandom(state) % 3) {
+        case 0: word[i] = ch; break;
+        case 1: word.insert(word.begin() + i, ch); break;
+        default: if (word.size() > 1) word.erase(word.begin() + i); break;
+        }
+    }
+}
+
+// Queries of one or two misspelled words, from the glosses of random
+// entries.
+vector<std::wstring> MakeQueries(const bench::DictionaryV4& dict, UINT32 maxEdits)
+{
+    vector<std::wstring> queries;
+    UINT32 state = 2463534242u;
+    vector<string> words;
+    while (queries.size() < static_cast<size_t>(kQueries)) {
+        const bench::DictionaryV4::Entry& e = dict.Item(NextRandom(state) % dict.Length());
+        cedict::TextSpan<WCHAR> english = bench::DictionaryV4::View(e.english);
+        words.clear();
+        cedict::ForEachWord(english.pchBegin, english.pchEnd, [&](const char* pchWord, size_t cchWord) {
+            if (cchWord >= kMinQueryWordLength) words.push_back(string(pchWord, cchWord));
+        });
+        if (words.empty()) continue;
+
+        size_t cWords = words.size() > 1 && NextRandom(state) % 4 == 0 ? 2 : 1;
+        size_t iFirst = NextRandom(state) % (words.size() - cWords + 1);
+        std::wstring query;
+        for (size_t w = iFirst; w < iFirst + cWords; ++w) {
+            string word = words[w];
+            Misspell(word, NextRandom(state) % (maxEdits + 1), state);
+            if (!query.empty()) query += L' ';
+            query.append(word.begin(), word.end());
+        }
+        queries.push_back(query);
+    }
+    return queries;
+}
+
+// The search of FuzzyGlossIndex::Searcher, without the index: every word
+// of every entry is compared with every word of the query.
+void BruteForceSearch(const bench::DictionaryV4& dict, const std::wstring& query, UINT32 maxEdits,
+    vector<FuzzyMatch>& results)
+{
+    vector<string> queryWords;
+    cedict::ForEachWord(query.data(), query.data() + query.length(), [&](const char* pchWord, size_t cchWord) {
+        queryWords.push_back(string(pchWord, cchWord));
+    });
+    results.clear();
+    if (queryWords.empty()) return;
+
+    UINT32 row[cedict::kMaxFuzzyWordLength + 1];
+    vector<UINT32> best(queryWords.size());
+    for (int i = 0; i < dict.Length(); ++i) {
+        std::fill(best.begin(), best.end(), maxEdits + 1);
+        cedict::TextSpan<WCHAR> english = bench::DictionaryV4::View(dict.Item(i).english);
+        cedict::ForEachWord(english.pchBegin, english.pchEnd, [&](const char* pchWord, size_t cchWord) {
+            for (size_t q = 0; q < queryWords.size(); ++q) {
+                UINT32 d = cedict::BoundedEditDistance(queryWords[q].data(), queryWords[q].size(),
+                    pchWord, cchWord, maxEdits, row);
+                best[q] = (std::min)(best[q], d);
+            }
+        });
+        UINT32 distance = 0;
+        bool fMatch = true;
+        for (size_t q = 0; q < queryWords.size(); ++q) {
+            fMatch = fMatch && best[q] <= cedict::FuzzyEditsFor(queryWords[q].size(), maxEdits);
+            distance += best[q];
+        }
+        if (fMatch) {
+            FuzzyMatch match = { static_cast<UINT32>(i), distance };
+            results.push_back(match);
+        }
+    }
+    std::sort(results.begin(), results.end(), [](const FuzzyMatch& a, const FuzzyMatch& b) {
+        return a.distance != b.distance ? a.distance < b.distance : a.entryId < b.entryId;
+    });
+    if (results.size() > kTopResults) results.resize(kTopResults);
+}
+
+void MeasureEdits(const bench::DictionaryV4& dict, UINT32 maxEdits, double nsPerTick)
+{
+    vector<std::wstring> queries = MakeQueries(dict, maxEdits);
+    FuzzyGlossIndex::Searcher searcher(dict.FuzzyEnglish());
+    vector<vector<FuzzyMatch>> indexed(queries.size());
+    LatencyHistogram latency;
+    UINT64 cVerified = 0;
+    UINT64 cFound = 0;
+    for (size_t q = 0; q < queries.size(); ++q) {
+        LONGLONG tickStart = Now();
+        searcher.Search(cedict::MakeSpan(queries[q].data(), queries[q].data() + queries[q].length()),
+            maxEdits, kTopResults, indexed[q]);
+        latency.Record(static_cast<UINT64>((Now() - tickStart) * nsPerTick));
+        cVerified += searcher.VerifiedWords();
+        cFound += !indexed[q].empty();
+    }
+
+    Stopwatch sw;
+    sw.Start();
+    vector<FuzzyMatch> expected;
+    size_t cExpected = 0;
+    size_t cRecalled = 0;
+    for (int q = 0; q < kBruteForceQueries; ++q) {
+        BruteForceSearch(dict, queries[q], maxEdits, expected);
+        cExpected += expected.size();
+        for (const FuzzyMatch& match : expected) {
+            for (const FuzzyMatch& found : indexed[q]) {
+                if (found.entryId == match.entryId) {
+                    cRecalled++;
+                    break;
+                }
+            }
+        }
+    }
+    sw.Stop();
+
+    cout << setw(3) << maxEdits
+        << setw(10) << latency.Percentile(0.5) / 1000.0
+        << setw(10) << latency.Percentile(0.99) / 1000.0
+        << setw(10) << latency.Max() / 1000.0
+        << setw(12) << static_cast<double>(cVerified) / queries.size()
+        << setw(10) << 100.0 * cFound / queries.size()
+        << setw(14) << sw.ElapsedMilliseconds() * 1000.0 / kBruteForceQueries
+        << setw(10) << (cExpected ? 100.0 * cRecalled / cExpected : 100.0) << '\n';
+}
+
+} // namespace
+
+
+int bench::FuzzySearchBenchmark(int argc, char* argv[])
+{
+    DictionaryV4 dict(kDictionaryFile);
+    if (dict.Length() == 0) {
+        cout << "The dictionary is empty.\n";
+        return 1;
+    }
+
+    Stopwatch sw;
+    sw.Start();
+    dict.BuildFuzzyGlossIndex();
+    sw.Stop();
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "Fuzzy English search: " << dict.FuzzyEnglish().WordCount() << " distinct words, index of "
+        << dict.FuzzyEnglish().Bytes() / (1024.0 * 1024.0) << " MB built in "
+        << sw.ElapsedMilliseconds() << " ms\n";
+    cout << kQueries << " queries of 1 or 2 words with up to k edits each, top " << kTopResults
+        << " entries; brute force on the first " << kBruteForceQueries << "\n\n";
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double nsPerTick = 1e9 / frequency.QuadPart;
+
+    cout << "  k    p50 us    p99 us    max us    verified   found %   brute us/q  recall %\n";
+    vector<UINT32> edits = { 1, 2 };
+    if (argc > 0 && atoi(argv[0]) > 0) edits.assign(1, static_cast<UINT32>(atoi(argv[0])));
+    for (UINT32 maxEdits : edits) {
+        MeasureEdits(dict, maxEdits, nsPerTick);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Compressed English glosses.
+//
+// Loads the dictionary with the glosses in the string pool and compressed
+// with a learnt symbol table (DictionaryOptions::compressGlosses), then
+// reports the compression ratio, the cost of decoding single entries in
+// random order and the load time overhead of training and encoding.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <memory>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::BestTime;
+using bench::NextRandom;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const int kDecodes = 10 * 1000 * 1000;
+
+// The dictionary of a run is destroyed before the next one, out of the time.
+double BestLoadTime(const cedict::DictionaryOptions& options)
+{
+    std::unique_ptr<bench::DictionaryV4> dict;
+    return BestTime(kRuns, [&]() { dict.reset(); }, [&]() {
+        dict.reset(new bench::DictionaryV4(bench::kDictionaryFile, options));
+    });
+}
+
+// Nanoseconds per English() call on random entries; *pcch gets the
+// characters read.
+double RandomReadNanoseconds(const bench::DictionaryV4& dict, size_t* pcch)
+{
+    std::vector<WCHAR> buf(dict.EnglishBufferLength());
+    const UINT32 cEntries = static_cast<UINT32>(dict.Length());
+    UINT32 state = 0;
+    size_t cch = 0;
+    double bestTime = BestTime(kRuns, [&]() {
+        state = 2463534242u;
+        cch = 0;
+    }, [&]() {
+        for (int i = 0; i < kDecodes; ++i) {
+            cedict::TextSpan<WCHAR> english = dict.English(NextRandom(state) % cEntries, buf.data());
+            cch += english.Length();
+        }
+    });
+    *pcch = cch;
+    return bestTime * 1e6 / kDecodes;
+}
+
+} // namespace
+
+
+int bench::GlossCompressionBenchmark(int, char*[])
+{
+    cedict::DictionaryOptions plainOptions;
+    cedict::DictionaryOptions compressedOptions;
+    compressedOptions.compressGlosses = true;
+
+    DictionaryV4 plain(kDictionaryFile, plainOptions);
+    DictionaryV4 compressed(kDictionaryFile, compressedOptions);
+
+    // The decoded glosses must match the plain ones.
+    std::vector<WCHAR> buf(compressed.EnglishBufferLength());
+    for (int i = 0; i < plain.Length(); ++i) {
+        if (compressed.English(i, buf.data()) != plain.English(i, nullptr)) {
+            cout << "Decoded gloss of entry " << i << " does not match.\n";
+            return 1;
+        }
+    }
+
+    const auto& glosses = compressed.Glosses();
+    size_t cbCompressed = glosses.CompressedBytes() + glosses.OffsetBytes()
+        + glosses.SymbolTableBytes();
+
+    cout << "Compressed English glosses (V4, " << plain.Length() << " entries)\n\n";
+    cout << std::fixed << std::setprecision(2);
+    cout << "Symbols learnt:       " << glosses.SymbolCount() << '\n';
+    cout << "Plain glosses:        " << glosses.RawBytes() / 1024 << " KB (UTF-16)\n";
+    cout << "Encoded glosses:      " << glosses.CompressedBytes() / 1024 << " KB\n";
+    cout << "  + offsets, symbols: " << cbCompressed / 1024 << " KB\n";
+    cout << "Compression ratio:    "
+        << static_cast<double>(glosses.RawBytes()) / glosses.CompressedBytes()
+        << " (" << static_cast<double>(glosses.RawBytes()) / cbCompressed
+        << " with offsets and symbols)\n";
+    cout << "Pool chunks:          " << plain.Statistics().cStorageChunks << " plain, "
+        << compressed.Statistics().cStorageChunks << " compressed\n\n";
+
+    size_t cchPlain = 0;
+    size_t cchCompressed = 0;
+    double nsPlain = RandomReadNanoseconds(plain, &cchPlain);
+    double nsCompressed = RandomReadNanoseconds(compressed, &cchCompressed);
+    double cchAverage = static_cast<double>(cchCompressed) / kDecodes;
+    cout << "Random reads (best of " << kRuns << " runs of " << kDecodes << ")\n";
+    cout << "  plain:      " << nsPlain << " ns/entry\n";
+    cout << "  compressed: " << nsCompressed << " ns/entry, "
+        << cchAverage * sizeof(WCHAR) * 1000 / nsCompressed << " MB/s decoded\n\n";
+
+    double msPlain = BestLoadTime(plainOptions);
+    double msCompressed = BestLoadTime(compressedOptions);
+    cout << "Load time (best of " << kRuns << " runs)\n";
+    cout << "  plain:      " << msPlain << " ms\n";
+    cout << "  compressed: " << msCompressed << " ms ("
+        << std::showpos << msCompressed - msPlain << std::noshowpos << " ms)\n";
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Large pages for the entry vector and the string pool.
+//
+// Loads the dictionary with and without DictionaryOptions::largePages and
+// measures the throughput of random entry reads, each touching the entry
+// array and three strings in the pool: an access pattern dominated by TLB
+// misses once the dictionary spans thousands of 4 KB pages.
+//
+// Windows offers no user-mode access to the dTLB miss counters: to see them,
+// profile this benchmark with VTune or with WPR/xperf PMC sampling
+// (e.g. the DTLB_LOAD_MISSES.WALK_COMPLETED event).
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using bench::NextRandom;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const int kLookups = 10 * 1000 * 1000;
+
+template <typename Dictionary>
+double RandomLookupsPerSecond(const Dictionary& dict, UINT32* pChecksum)
+{
+    const UINT32 cEntries = static_cast<UINT32>(dict.Length());
+    UINT32 state = 2463534242u;
+    UINT32 checksum = 0;
+
+    Stopwatch sw;
+    sw.Start();
+    for (int i = 0; i < kLookups; ++i) {
+        const auto& entry = dict.Item(NextRandom(state) % cEntries);
+        checksum += entry.trad[0] + entry.pinyin[0] + entry.english[0];
+    }
+    sw.Stop();
+
+    *pChecksum = checksum;
+    return kLookups / (sw.ElapsedMilliseconds() / 1000.0);
+}
+
+template <typename Dictionary>
+void MeasureVariant(const char* pszName, bool fPresize, bool fLargePages)
+{
+    cedict::DictionaryOptions options;
+    options.presize = fPresize;
+    options.largePages = fLargePages;
+
+    Dictionary dict(bench::kDictionaryFile, options);
+
+    double bestRate = 0;
+    UINT32 checksum = 0;
+    for (int run = 0; run < kRuns; ++run) {
+        double rate = RandomLookupsPerSecond(dict, &checksum);
+        if (rate > bestRate) bestRate = rate;
+    }
+
+    cout << std::left << setw(8) << pszName
+        << setw(10) << (fPresize ? "two-pass" : "one-pass")
+        << setw(13) << (fLargePages ? "large" : "regular")
+        << std::right
+        << setw(12) << dict.Statistics().cStorageChunks
+        << setw(14) << dict.Statistics().cLargePageChunks
+        << std::fixed << std::setprecision(2)
+        << setw(16) << bestRate / 1e6
+        << "   (checksum " << checksum << ")\n";
+}
+
+} // namespace
+
+
+int bench::LargePagesBenchmark(int, char*[])
+{
+    cout << "Random entry reads with and without large pages (best of "
+        << kRuns << " x " << kLookups << " reads)\n\n";
+    cout << "Large pages available: "
+        << (cedict::LargePagesAvailable() ? "yes" : "no (grant the 'Lock pages in memory' user right)")
+        << "\n";
+    cout << "dTLB misses: not readable from user mode, profile with VTune or WPR PMC sampling\n\n";
+    cout << "Variant Mode      Pages         Pool chunks  Large chunks     M lookups/s\n";
+
+    for (int large = 0; large < 2; ++large) {
+        MeasureVariant<DictionaryV3>("V3", false, large != 0);
+        MeasureVariant<DictionaryV4>("V4", false, large != 0);
+        MeasureVariant<DictionaryV4>("V4", true, large != 0);
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// LatencyHistogram.h -- Log-linear histogram of latencies, for percentiles.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <intrin.h>     // for _BitScanReverse
+#include <algorithm>
+#include <cmath>        // for ceil
+#include <vector>
+
+
+namespace bench
+{
+
+
+// Latency histogram in the manner of HdrHistogram: values below
+// kSubBuckets are counted exactly, and each power of 2 above is split into
+// kSubBuckets linear buckets, so that any value is known to within 1/32 of
+// itself, over the whole 64-bit range, with a fixed 15 KB array.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : m_counts(kBuckets, 0), m_count(0), m_max(0) {}
+
+    void Record(UINT64 value)
+    {
+        m_counts[Bucket(value)]++;
+        m_count++;
+        if (value > m_max) m_max = value;
+    }
+
+    void Add(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i < kBuckets; ++i) m_counts[i] += other.m_counts[i];
+        m_count += other.m_count;
+        m_max = (std::max)(m_max, other.m_max);
+    }
+
+    UINT64 Count() const { return m_count; }
+    UINT64 Max() const { return m_max; }
+
+    // Value below which the fraction q of the values are (the highest value
+    // of their bucket).
+    UINT64 Percentile(double q) const
+    {
+        UINT64 cRank = static_cast<UINT64>(std::ceil(q * m_count));
+        if (cRank == 0) cRank = 1;
+        UINT64 cSeen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            cSeen += m_counts[i];
+            if (cSeen >= cRank) return (std::min)(HighestValue(i), m_max);
+        }
+        return m_max;
+    }
+
+private:
+    enum { kSubBits = 5, kSubBuckets = 1 << kSubBits, kBuckets = (64 - kSubBits + 1) * kSubBuckets };
+
+    static size_t Bucket(UINT64 value)
+    {
+        if (value < kSubBuckets) return static_cast<size_t>(value);
+        // _BitScanReverse64 is not available on x86.
+        unsigned long iMsb = 0;
+        if (value >> 32) {
+            _BitScanReverse(&iMsb, static_cast<unsigned long>(value >> 32));
+            iMsb += 32;
+        } else {
+            _BitScanReverse(&iMsb, static_cast<unsigned long>(value));
+        }
+        int shift = static_cast<int>(iMsb) - kSubBits;
+        return (shift + 1) * kSubBuckets + static_cast<size_t>((value >> shift) - kSubBuckets);
+    }
+
+    static UINT64 HighestValue(size_t bucket)
+    {
+        if (bucket < kSubBuckets) return bucket;
+        int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+        UINT64 sub = bucket % kSubBuckets + kSubBuckets;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<UINT64> m_counts;
+    UINT64 m_count;
+    UINT64 m_max;
+};
+
+
+} // namespace bench
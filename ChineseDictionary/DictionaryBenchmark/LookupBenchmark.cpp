@@ -0,0 +1,317 @@
+// Lookup latency and throughput under skewed and uniform workloads.
+//
+// Loads V4 with the headword index and the field indexes, and takes the
+// distinct keys of each field from it: traditional and simplified headwords,
+// pinyin and English glosses. For each field, N threads run three workloads,
+// each thread its own precomputed sequence of queries:
+//
+//  - uniform: every key equally likely;
+//  - Zipf: the key of rank r (ranks shuffled over the keys) with probability
+//    proportional to 1 / r^s, as in real query logs, so that the hot keys
+//    stay in cache;
+//  - misses: keys that are not in the dictionary (a key with a private use
+//    character appended).
+//
+// A lookup resolves the key and reads the pinyin of the entry found. Each
+// lookup is timed with the time stamp counter into an HDR-style histogram
+// per thread, merged at the end, from which the percentiles are read. The
+// throughput (QPS) is measured on a second, untimed run of the same queries,
+// so that it does not include the cost of reading the counter.
+//
+// Usage: DictionaryBenchmark lookup [threads] [Zipf exponent]
+//        (defaults to one thread per logical processor, and s = 0.99)
+
+#include <windows.h>
+#include <intrin.h>     // for __rdtsc
+#include <algorithm>
+#include <atomic>
+#include <cmath>        // for pow
+#include <cstdlib>      // for atoi, atof
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "LatencyHistogram.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::vector;
+using std::wstring;
+using bench::LatencyHistogram;
+using bench::NextRandom;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kLookupsPerThread = 1000 * 1000;
+const double kDefaultZipfExponent = 0.99;
+const WCHAR kMissSuffix = 0xE000;   // private use: in no key of the dictionary
+
+typedef bench::DictionaryV4 Dictionary;
+typedef cedict::TextSpan<WCHAR> Key;
+
+
+// Time stamp counter ticks per nanosecond, measured against the
+// performance counter.
+double TicksPerNanosecond()
+{
+    Stopwatch sw;
+    sw.Start();
+    UINT64 tsc = __rdtsc();
+    while (sw.ElapsedMilliseconds() < 100) {}
+    UINT64 cTicks = __rdtsc() - tsc;
+    return cTicks / (sw.ElapsedMilliseconds() * 1e6);
+}
+
+
+// The keys of a field, distinct, with their misses.
+struct KeySet
+{
+    vector<wstring> hits;
+    vector<wstring> misses;
+    vector<Key> hitKeys;        // spans of the strings above
+    vector<Key> missKeys;
+};
+
+void MakeKeySet(vector<wstring> keys, KeySet& set)
+{
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    set.hits.swap(keys);
+    for (const wstring& key : set.hits) set.misses.push_back(key + kMissSuffix);
+    for (const wstring& key : set.hits) {
+        set.hitKeys.push_back(cedict::MakeSpan(key.data(), key.data() + key.length()));
+    }
+    for (const wstring& key : set.misses) {
+        set.missKeys.push_back(cedict::MakeSpan(key.data(), key.data() + key.length()));
+    }
+}
+
+inline wstring ToString(const Key& key)
+{
+    return wstring(key.pchBegin, key.pchEnd);
+}
+
+
+// Entry id of key in the given field, or kNoEntry.
+typedef UINT32 (*FindFunction)(const Dictionary& dict, const Key& key);
+
+UINT32 FindTraditional(const Dictionary& dict, const Key& key)
+{
+    return dict.Find(key.pchBegin, key.pchEnd);
+}
+
+template <const cedict::FieldIndex<WCHAR>& (Dictionary::*Index)() const>
+UINT32 FindInField(const Dictionary& dict, const Key& key)
+{
+    const cedict::FieldIndex<WCHAR>& index = (dict.*Index)();
+    UINT32 posting = index.Find(key);
+    return posting == cedict::kNoEntry ? cedict::kNoEntry : index.EntryId(posting);
+}
+
+struct FieldInfo
+{
+    const char* name;
+    FindFunction find;
+    KeySet keys;
+};
+
+
+enum Workload { kUniform, kZipf, kMisses };
+
+// The query sequence of a thread: indexes into the hit or the miss keys.
+vector<UINT32> MakeQueries(Workload workload, const vector<double>& zipfCdf,
+    const vector<UINT32>& zipfRanks, UINT32 seed)
+{
+    vector<UINT32> queries(kLookupsPerThread);
+    UINT32 state = seed;
+    const UINT32 cKeys = static_cast<UINT32>(zipfRanks.size());
+    for (UINT32& query : queries) {
+        if (workload == kZipf) {
+            double u = NextRandom(state) / 4294967296.0;
+            size_t rank = std::upper_bound(zipfCdf.begin(), zipfCdf.end(), u) - zipfCdf.begin();
+            query = zipfRanks[(std::min)(rank, zipfRanks.size() - 1)];
+        } else {
+            query = NextRandom(state) % cKeys;
+        }
+    }
+    return queries;
+}
+
+struct RunResult
+{
+    LatencyHistogram latency;   // in ticks
+    double queriesPerSecond;
+    UINT64 cFound;
+};
+
+// Runs the workload from cThreads threads, the calling one included: once
+// timing each lookup, once untimed for the throughput.
+RunResult RunWorkload(const Dictionary& dict, const FieldInfo& field, Workload workload,
+    int cThreads, double zipfExponent)
+{
+    const vector<Key>& keys = workload == kMisses ? field.keys.missKeys : field.keys.hitKeys;
+
+    // Rank r is the key zipfRanks[r]; zipfCdf[r] = P(rank <= r).
+    vector<UINT32> zipfRanks(keys.size());
+    vector<double> zipfCdf(keys.size());
+    UINT32 state = 2463534242u;
+    for (size_t r = 0; r < zipfRanks.size(); ++r) {
+        zipfRanks[r] = static_cast<UINT32>(r);
+        size_t j = NextRandom(state) % (r + 1);
+        std::swap(zipfRanks[r], zipfRanks[j]);
+    }
+    double sum = 0;
+    for (size_t r = 0; r < zipfCdf.size(); ++r) {
+        sum += 1 / std::pow(static_cast<double>(r + 1), zipfExponent);
+        zipfCdf[r] = sum;
+    }
+    for (double& p : zipfCdf) p /= sum;
+
+    RunResult result;
+    std::mutex resultMutex;
+    std::atomic<int> arrived(0);
+    std::atomic<UINT64> found(0);
+    std::atomic<size_t> sink(0);
+    Stopwatch sw;
+
+    // The threads start each run together: the nth barrier waits for
+    // n * cThreads arrivals. There are no more threads than processors,
+    // unless asked for, so the waits spin.
+    auto barrier = [&](int n) {
+        arrived++;
+        while (arrived < n * cThreads) {}
+    };
+    // Each thread records into a histogram of its own, on its own stack, and
+    // adds it to the result between the runs.
+    auto run = [&](int t) {
+        vector<UINT32> queries = MakeQueries(workload, zipfCdf, zipfRanks, 88172645u + 7919u * t);
+        LatencyHistogram histogram;
+        UINT64 cFound = 0;
+        size_t cch = 0;
+
+        barrier(1);
+        for (UINT32 query : queries) {
+            UINT64 tscBegin = __rdtsc();
+            UINT32 id = field.find(dict, keys[query]);
+            if (id != cedict::kNoEntry) cch += Dictionary::View(dict.Item(id).pinyin).Length();
+            histogram.Record(__rdtsc() - tscBegin);
+            cFound += id != cedict::kNoEntry;
+        }
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            result.latency.Add(histogram);
+        }
+        found += cFound;
+
+        barrier(2);
+        if (t == 0) sw.Start();
+        for (UINT32 query : queries) {
+            UINT32 id = field.find(dict, keys[query]);
+            if (id != cedict::kNoEntry) cch += Dictionary::View(dict.Item(id).pinyin).Length();
+        }
+        sink += cch;
+    };
+
+    vector<std::thread> threads;
+    for (int t = 1; t < cThreads; ++t) {
+        threads.emplace_back(run, t);
+    }
+    run(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    sw.Stop();
+
+    result.queriesPerSecond = static_cast<double>(cThreads) * kLookupsPerThread
+        / (sw.ElapsedMilliseconds() / 1000.0);
+    result.cFound = found;
+    return result;
+}
+
+} // namespace
+
+
+int bench::LookupBenchmark(int argc, char* argv[])
+{
+    int cThreads = argc > 0 ? atoi(argv[0]) : 0;
+    if (cThreads <= 0) cThreads = static_cast<int>(std::thread::hardware_concurrency());
+    if (cThreads <= 0) cThreads = 1;
+    double zipfExponent = argc > 1 ? atof(argv[1]) : kDefaultZipfExponent;
+    if (zipfExponent <= 0) zipfExponent = kDefaultZipfExponent;
+
+    cedict::DictionaryOptions options;
+    options.buildIndex = true;
+    options.buildFieldIndexes = true;
+    Dictionary dict(kDictionaryFile, options);
+    if (dict.Length() == 0) {
+        cout << "The dictionary is empty.\n";
+        return 1;
+    }
+
+    FieldInfo fields[] = {
+        { "traditional", FindTraditional, KeySet() },
+        { "simplified", FindInField<&Dictionary::SimplifiedIndex>, KeySet() },
+        { "pinyin", FindInField<&Dictionary::PinyinIndex>, KeySet() },
+        { "English", FindInField<&Dictionary::EnglishIndex>, KeySet() },
+    };
+    {
+        vector<wstring> trad, simp, pinyin, english;
+        for (int i = 0; i < dict.Length(); ++i) {
+            const Dictionary::Entry& e = dict.Item(i);
+            trad.push_back(ToString(Dictionary::View(e.trad)));
+            simp.push_back(ToString(Dictionary::View(e.simp)));
+            pinyin.push_back(ToString(Dictionary::View(e.pinyin)));
+            cedict::ForEachGloss(Dictionary::View(e.english), [&](const WCHAR* pchBegin, const WCHAR* pchEnd) {
+                english.push_back(wstring(pchBegin, pchEnd));
+            });
+        }
+        MakeKeySet(std::move(trad), fields[0].keys);
+        MakeKeySet(std::move(simp), fields[1].keys);
+        MakeKeySet(std::move(pinyin), fields[2].keys);
+        MakeKeySet(std::move(english), fields[3].keys);
+    }
+
+    const double ticksPerNs = TicksPerNanosecond();
+    LatencyHistogram overhead;
+    for (int i = 0; i < 100000; ++i) {
+        UINT64 tscBegin = __rdtsc();
+        overhead.Record(__rdtsc() - tscBegin);
+    }
+
+    static const char* const kWorkloadNames[] = { "uniform", "Zipf", "misses" };
+    cout << std::fixed << std::setprecision(1);
+    cout << "Lookups from " << cThreads << " threads, " << kLookupsPerThread << " per thread; Zipf s = "
+        << std::setprecision(2) << zipfExponent << std::setprecision(1) << "\n";
+    cout << "Latencies include reading the time stamp counter ("
+        << overhead.Percentile(0.5) / ticksPerNs << " ns, p50).\n";
+
+    for (const FieldInfo& field : fields) {
+        cout << "\nBy " << field.name << " (" << field.keys.hits.size() << " distinct keys)\n";
+        cout << "  workload     M QPS    p50 ns    p99 ns   p999 ns      max ns\n";
+        for (int w = kUniform; w <= kMisses; ++w) {
+            Workload workload = static_cast<Workload>(w);
+            RunResult r = RunWorkload(dict, field, workload, cThreads, zipfExponent);
+            cout << "  " << std::left << setw(9) << kWorkloadNames[w] << std::right
+                << setw(9) << r.queriesPerSecond / 1e6
+                << setw(10) << r.latency.Percentile(0.5) / ticksPerNs
+                << setw(10) << r.latency.Percentile(0.99) / ticksPerNs
+                << setw(10) << r.latency.Percentile(0.999) / ticksPerNs
+                << setw(12) << r.latency.Max() / ticksPerNs << '\n';
+            UINT64 cExpected = workload == kMisses ? 0 : static_cast<UINT64>(cThreads) * kLookupsPerThread;
+            if (r.cFound != cExpected) {
+                cout << "  warning: " << r.cFound << " lookups found their key instead of "
+                    << cExpected << '\n';
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Memory used by the loader variants.
+//
+// Loads each variant in a process of its own (this program, run again with
+// the name of the variant), so that the peak working set is that of the
+// variant alone, and reports:
+//
+//  - the calls to the global operator new and delete made by the load,
+//    counted by the replacements below, and the bytes they allocated and
+//    freed (as reported by _msize, so heap rounding included);
+//  - the peak working set of the process, and its working set once loaded;
+//  - where the memory of the dictionary goes, from Dictionary::MemoryUsage().
+//
+// The ATL strings of V2A are allocated by the ATL string manager, and the
+// string pool of V4 and large entry vectors by VirtualAlloc: they do not go
+// through operator new, but MemoryUsage() and the working set see them.
+
+#include <windows.h>
+#include <malloc.h>     // for _msize
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <new>
+#include <string>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "ProcessCounters.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::Megabytes;
+
+
+namespace
+{
+
+// Counters of the global operator new and delete, only updated while
+// g_fCounting is set: the variant is then loaded on a single thread.
+struct AllocationCounters
+{
+    size_t cAllocations;
+    size_t cFrees;
+    size_t cbAllocated;
+    size_t cbFreed;
+    INT64 cbLive;       // may go below 0 if blocks allocated before are freed
+    INT64 cbPeakLive;
+};
+
+AllocationCounters g_counters;
+std::atomic<bool> g_fCounting(false);   // read by every thread that allocates
+
+void* CountedAlloc(size_t cb)
+{
+    void* p = malloc(cb ? cb : 1);
+    if (!p) throw std::bad_alloc();
+    if (g_fCounting) {
+        size_t cbBlock = _msize(p);
+        g_counters.cAllocations++;
+        g_counters.cbAllocated += cbBlock;
+        g_counters.cbLive += cbBlock;
+        if (g_counters.cbLive > g_counters.cbPeakLive) g_counters.cbPeakLive = g_counters.cbLive;
+    }
+    return p;
+}
+
+void CountedFree(void* p)
+{
+    if (!p) return;
+    if (g_fCounting) {
+        size_t cbBlock = _msize(p);
+        g_counters.cFrees++;
+        g_counters.cbFreed += cbBlock;
+        g_counters.cbLive -= cbBlock;
+    }
+    free(p);
+}
+
+} // namespace
+
+
+void* operator new(size_t cb) { return CountedAlloc(cb); }
+void* operator new[](size_t cb) { return CountedAlloc(cb); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+
+
+namespace
+{
+
+struct VariantInfo
+{
+    const char* name;
+    const char* description;
+    void (*measure)(const char* pszName, const char* pszDescription);
+};
+
+template <typename Dictionary>
+void MeasureVariant(const char* pszName, const char* pszDescription)
+{
+    PROCESS_MEMORY_COUNTERS pmcStart = bench::QueryMemoryCounters();
+    memset(&g_counters, 0, sizeof(g_counters));
+    g_fCounting = true;
+    Dictionary dict(bench::kDictionaryFile);
+    g_fCounting = false;
+    PROCESS_MEMORY_COUNTERS pmc = bench::QueryMemoryCounters();
+    cedict::MemoryBreakdown mb = dict.MemoryUsage();
+    double cEntries = dict.Length() ? dict.Length() : 1;
+
+    cout << pszName << " (" << pszDescription << "): " << dict.Length() << " entries\n";
+    cout << "  allocations:    " << g_counters.cAllocations << " ("
+        << g_counters.cAllocations / cEntries << " per entry), "
+        << Megabytes(g_counters.cbAllocated) << " MB\n";
+    cout << "  frees:          " << g_counters.cFrees << ", "
+        << Megabytes(g_counters.cbFreed) << " MB; peak live "
+        << Megabytes(static_cast<double>(g_counters.cbPeakLive)) << " MB\n";
+    cout << "  working set:    peak " << Megabytes(pmc.PeakWorkingSetSize) << " MB, loaded "
+        << Megabytes(pmc.WorkingSetSize) << " MB (" << Megabytes(pmcStart.WorkingSetSize)
+        << " MB before loading)\n";
+    cout << "  MemoryUsage():  " << Megabytes(mb.Total()) << " MB, "
+        << mb.Total() / cEntries << " bytes per entry\n";
+    cout << "    entries " << Megabytes(mb.cbEntries) << " + slack " << Megabytes(mb.cbEntrySlack)
+        << ", strings " << Megabytes(mb.cbStrings) << " + slack " << Megabytes(mb.cbStringSlack)
+        << ", pool waste " << Megabytes(mb.cbPoolWaste)
+        << ", buffers " << Megabytes(mb.cbBuffers) << "\n\n";
+}
+
+const VariantInfo g_variants[] = {
+    { "V1", "streams, codecvt, wstring", MeasureVariant<bench::DictionaryV1> },
+    { "V2", "mapped file, MultiByteToWideChar, wstring", MeasureVariant<bench::DictionaryV2> },
+    { "V2A", "mapped file, MultiByteToWideChar, CStringW", MeasureVariant<bench::DictionaryV2A> },
+    { "V3", "mapped file, MultiByteToWideChar, new[] strings", MeasureVariant<bench::DictionaryV3> },
+    { "V4", "mapped file, MultiByteToWideChar, string pool", MeasureVariant<bench::DictionaryV4> },
+};
+
+} // namespace
+
+
+int bench::MemoryBenchmark(int argc, char* argv[])
+{
+    cout << std::fixed << std::setprecision(1);
+    if (argc > 0) {
+        for (const VariantInfo& variant : g_variants) {
+            if (_stricmp(argv[0], variant.name) == 0) {
+                variant.measure(variant.name, variant.description);
+                return 0;
+            }
+        }
+        cout << "Unknown variant: " << argv[0] << '\n';
+        return 1;
+    }
+
+    cout << "Memory used by each variant (one process each)\n\n";
+    for (const VariantInfo& variant : g_variants) {
+        cout.flush();
+        std::string arguments = std::string("memory ") + variant.name;
+        if (!bench::RunBenchmarkProcess(arguments.c_str())) {
+            cout << "Cannot measure " << variant.name << ".\n";
+            return 1;
+        }
+    }
+    return 0;
+}
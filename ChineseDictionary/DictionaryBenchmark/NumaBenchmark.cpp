@@ -0,0 +1,163 @@
+// NUMA-aware replicas.
+//
+// Runs headword lookups from threads pinned to processors spread across the
+// NUMA nodes, first against a single dictionary loaded on the first node,
+// then against per-node replicas (NumaReplicatedDictionary).
+//
+// Usage: DictionaryBenchmark numa [threads]
+//        (defaults to one thread per logical processor)
+
+#include <windows.h>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <string>
+#include <thread>
+#include <vector>
+#include "Benchmarks.h"
+#include "NumaReplicas.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::vector;
+using std::wstring;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kLookupsPerThread = 2 * 1000 * 1000;
+
+typedef bench::DictionaryV4 Dictionary;
+
+// The processors of each node with processors, one GROUP_AFFINITY each.
+vector<vector<GROUP_AFFINITY>> ProcessorsByNode(const vector<USHORT>& nodes)
+{
+    vector<vector<GROUP_AFFINITY>> processors(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        GROUP_AFFINITY node = {};
+        GetNumaNodeProcessorMaskEx(nodes[i], &node);
+        for (int bit = 0; bit < static_cast<int>(8 * sizeof(KAFFINITY)); ++bit) {
+            KAFFINITY mask = static_cast<KAFFINITY>(1) << bit;
+            if (node.Mask & mask) {
+                GROUP_AFFINITY one = {};
+                one.Group = node.Group;
+                one.Mask = mask;
+                processors[i].push_back(one);
+            }
+        }
+    }
+    return processors;
+}
+
+// Runs the lookups from cThreads threads, thread t pinned to a processor of
+// node t % nodes. getDictionary(nodeIndex) picks the dictionary to query.
+template <typename GetDictionary>
+double LookupsPerSecond(const vector<wstring>& keys, int cThreads,
+    const vector<vector<GROUP_AFFINITY>>& processors, GetDictionary getDictionary)
+{
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<UINT32> found(0);
+
+    vector<std::thread> threads;
+    for (int t = 0; t < cThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            size_t nodeIndex = t % processors.size();
+            const vector<GROUP_AFFINITY>& cpus = processors[nodeIndex];
+            if (!cpus.empty()) {
+                GROUP_AFFINITY affinity = cpus[(t / processors.size()) % cpus.size()];
+                SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+            }
+
+            // Copy the keys after pinning, so that they are local as well.
+            vector<wstring> localKeys(keys);
+            const Dictionary& dict = getDictionary(nodeIndex);
+
+            UINT32 state = 2463534242u + t;
+            UINT32 cFound = 0;
+            ready++;
+            while (!go) {}
+            for (int i = 0; i < kLookupsPerThread; ++i) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                const wstring& key = localKeys[state % localKeys.size()];
+                if (dict.Find(key.data(), key.data() + key.length()) != cedict::kNoEntry) {
+                    cFound++;
+                }
+            }
+            found += cFound;
+        });
+    }
+
+    while (ready < cThreads) {}
+    Stopwatch sw;
+    sw.Start();
+    go = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    sw.Stop();
+
+    if (found != static_cast<UINT32>(cThreads) * kLookupsPerThread) {
+        cout << "  warning: " << found << " lookups found their key\n";
+    }
+    return static_cast<double>(cThreads) * kLookupsPerThread
+        / (sw.ElapsedMilliseconds() / 1000.0);
+}
+
+} // namespace
+
+
+int bench::NumaBenchmark(int argc, char* argv[])
+{
+    int cThreads = argc > 0 ? atoi(argv[0]) : 0;
+    if (cThreads <= 0) cThreads = static_cast<int>(std::thread::hardware_concurrency());
+
+    vector<USHORT> nodes = cedict::NumaNodesWithProcessors();
+    vector<vector<GROUP_AFFINITY>> processors = ProcessorsByNode(nodes);
+
+    cout << "Headword lookups from " << cThreads << " threads, "
+        << kLookupsPerThread << " lookups each\n";
+    cout << "NUMA nodes with processors: " << nodes.size();
+    if (nodes.size() == 1) {
+        cout << " (single node: the replicated dictionary has a single replica)";
+    }
+    cout << "\n\n";
+
+    cedict::DictionaryOptions options;
+    options.presize = true;
+    options.buildIndex = true;
+
+    // The shared dictionary is loaded on the first node, as a process that
+    // ignores NUMA would typically end up doing.
+    cedict::PinThreadToNode(nodes[0]);
+    Dictionary shared(kDictionaryFile, options);
+    cedict::NumaReplicatedDictionary<Dictionary> replicated(kDictionaryFile, options);
+
+    vector<wstring> keys;
+    keys.reserve(shared.Length());
+    for (int i = 0; i < shared.Length(); ++i) {
+        cedict::TextSpan<WCHAR> trad = Dictionary::View(shared.Item(i).trad);
+        keys.push_back(wstring(trad.pchBegin, trad.pchEnd));
+    }
+
+    double sharedRate = LookupsPerSecond(keys, cThreads, processors,
+        [&](size_t) -> const Dictionary& { return shared; });
+    double replicatedRate = LookupsPerSecond(keys, cThreads, processors,
+        [&](size_t nodeIndex) -> const Dictionary& {
+            return replicated.ForNode(nodes[nodeIndex]);
+        });
+
+    cout << "Dictionary                 M lookups/s\n";
+    cout << std::fixed << std::setprecision(2);
+    cout << "Shared (first node)     " << setw(14) << sharedRate / 1e6 << '\n';
+    cout << "Per-node replicas (" << replicated.ReplicaCount() << ")   "
+        << setw(14) << replicatedRate / 1e6 << '\n';
+    return 0;
+}
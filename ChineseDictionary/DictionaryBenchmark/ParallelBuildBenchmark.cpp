@@ -0,0 +1,219 @@
+// Startup time with the indexes built in parallel, by thread count.
+//
+// Loads V4 with everything that can be built after loading (the headword,
+// sorted, field and fuzzy indexes, headword filter, script converters and
+// cross references), with DictionaryOptions::buildThreads set to 1, 2, 4... up
+// to the logical processors (see TaskScheduler.h), and reports the best
+// startup time of a few runs: the load, then the builds, all at the same
+// time and each split into tasks. A fingerprint of lookups through every
+// structure checks that the threads build the same ones as a single
+// thread does.
+//
+// Then builds each structure alone on a loaded dictionary, on one thread
+// and on all of them, to show which ones split well.
+//
+// Usage: DictionaryBenchmark parallelbuild [threads...]
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdlib>      // for atoi
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::vector;
+using bench::BestTime;
+using bench::DictionaryV4;
+using cedict::FuzzyMatch;
+using cedict::TaskScheduler;
+
+
+namespace
+{
+
+const int kRuns = 3;
+const int kFuzzyQueries = 200;
+
+typedef cedict::TextSpan<WCHAR> Key;
+
+
+cedict::DictionaryOptions BuildAllOptions(unsigned cThreads)
+{
+    cedict::DictionaryOptions options;
+    options.buildIndex = true;
+    options.headwordFilter = true;
+    options.buildSortedIndex = true;
+    options.buildSortedPinyinIndex = true;
+    options.buildScriptConverters = true;
+    options.buildFieldIndexes = true;
+    options.buildFuzzyGlossIndex = true;
+    options.buildFuzzyPinyinIndex = true;
+    options.buildCrossReferences = true;
+    options.buildThreads = cThreads;
+    return options;
+}
+
+inline void Mix(UINT64& fingerprint, UINT64 x)
+{
+    fingerprint = (fingerprint ^ x) * 0x100000001B3ull;
+}
+
+// Lookups through each structure built by BuildAllOptions(), folded into
+// a number that differs if any of them answers differently.
+UINT64 Fingerprint(const DictionaryV4& dict)
+{
+    UINT64 fingerprint = 0xCBF29CE484222325ull;
+    vector<WCHAR> converted;
+    for (int i = 0; i < dict.Length(); ++i) {
+        const DictionaryV4::Entry& e = dict.Item(i);
+        Key trad = DictionaryV4::View(e.trad);
+        Key simp = DictionaryV4::View(e.simp);
+        Mix(fingerprint, dict.Find(trad.pchBegin, trad.pchEnd));
+        Mix(fingerprint, dict.Filter().MayContain(cedict::HashSpan(trad)));
+        Mix(fingerprint, dict.SortedIndex().IdAt(i));
+        Mix(fingerprint, dict.SortedPinyinIndex().IdAt(i));
+        Mix(fingerprint, dict.SimplifiedIndex().Find(simp));
+        Mix(fingerprint, dict.PinyinIndex().Find(DictionaryV4::View(e.pinyin)));
+        const cedict::CrossReferenceGraph<WCHAR>& graph = dict.CrossReferences();
+        for (const UINT32* p = graph.LinksBegin(i); p != graph.LinksEnd(i); ++p) Mix(fingerprint, *p);
+        Key english = DictionaryV4::View(e.english);
+        cedict::ForEachGloss(english, [&](const WCHAR* pchBegin, const WCHAR* pchEnd) {
+            UINT32 p = dict.EnglishIndex().Find(cedict::MakeSpan(pchBegin, pchEnd));
+            Mix(fingerprint, p == cedict::kNoEntry ? p : dict.EnglishIndex().EntryId(p));
+        });
+        if (i % 64 == 0) {
+            converted.resize(trad.Length() + 1);
+            Mix(fingerprint, dict.TradToSimp().Convert(trad.pchBegin, trad.pchEnd, converted.data()));
+            for (size_t c = 0; c < trad.Length(); ++c) Mix(fingerprint, converted[c]);
+        }
+    }
+
+    // The pinyin and the glosses of spread out entries, as fuzzy queries.
+    cedict::FuzzyGlossIndex<WCHAR>::Searcher englishSearcher(dict.FuzzyEnglish());
+    cedict::FuzzyPinyinIndex<WCHAR>::Searcher pinyinSearcher(dict.FuzzyPinyin());
+    vector<FuzzyMatch> matches;
+    for (int q = 0; q < kFuzzyQueries; ++q) {
+        const DictionaryV4::Entry& e = dict.Item(static_cast<int>(static_cast<UINT64>(q) * dict.Length() / kFuzzyQueries));
+        englishSearcher.Search(DictionaryV4::View(e.english), 1, 10, matches);
+        for (const FuzzyMatch& match : matches) Mix(fingerprint, match.entryId * 4 + match.distance);
+        pinyinSearcher.Search(DictionaryV4::View(e.pinyin), 1, 10, matches);
+        for (const FuzzyMatch& match : matches) Mix(fingerprint, match.entryId * 4 + match.distance);
+    }
+    return fingerprint;
+}
+
+struct StartupResult
+{
+    double bestTime;
+    UINT64 fingerprint;
+};
+
+// The dictionaries of the runs are destroyed out of the time.
+StartupResult MeasureStartup(unsigned cThreads)
+{
+    std::unique_ptr<DictionaryV4> dict;
+    StartupResult result = {};
+    result.bestTime = BestTime(kRuns, [&]() { dict.reset(); }, [&]() {
+        dict.reset(new DictionaryV4(bench::kDictionaryFile, BuildAllOptions(cThreads)));
+    });
+    result.fingerprint = Fingerprint(*dict);
+    return result;
+}
+
+double BestLoadTime()
+{
+    std::unique_ptr<DictionaryV4> dict;
+    return BestTime(kRuns, [&]() { dict.reset(); }, [&]() {
+        dict.reset(new DictionaryV4(bench::kDictionaryFile));
+    });
+}
+
+
+struct Structure
+{
+    const char* pszName;
+    void (DictionaryV4::*pfnBuild)(TaskScheduler*);
+};
+
+const Structure kStructures[] = {
+    { "headword index", &DictionaryV4::BuildIndex },
+    { "headword filter", &DictionaryV4::BuildHeadwordFilter },
+    { "sorted index", &DictionaryV4::BuildSortedIndex },
+    { "sorted pinyin index", &DictionaryV4::BuildSortedPinyinIndex },
+    { "field indexes", &DictionaryV4::BuildFieldIndexes },
+    { "fuzzy gloss index", &DictionaryV4::BuildFuzzyGlossIndex },
+    { "fuzzy pinyin index", &DictionaryV4::BuildFuzzyPinyinIndex },
+    { "script converters", &DictionaryV4::BuildScriptConverters },
+    { "cross references", &DictionaryV4::BuildCrossReferences },
+};
+
+// Best time to build one structure on a freshly loaded dictionary.
+double BestBuildTime(const Structure& structure, TaskScheduler* pScheduler)
+{
+    std::unique_ptr<DictionaryV4> dict;
+    return BestTime(kRuns, [&]() {
+        dict.reset();
+        dict.reset(new DictionaryV4(bench::kDictionaryFile));
+    }, [&]() {
+        (dict.get()->*structure.pfnBuild)(pScheduler);
+    });
+}
+
+} // namespace
+
+
+int bench::ParallelBuildBenchmark(int argc, char* argv[])
+{
+    const unsigned cProcessors = (std::max)(std::thread::hardware_concurrency(), 1u);
+    vector<unsigned> threadCounts;
+    for (int i = 0; i < argc; ++i) {
+        if (atoi(argv[i]) > 0) threadCounts.push_back(static_cast<unsigned>(atoi(argv[i])));
+    }
+    if (threadCounts.empty()) {
+        for (unsigned c = 1; c < cProcessors; c *= 2) threadCounts.push_back(c);
+        threadCounts.push_back(cProcessors);
+    }
+
+    cout << std::fixed << std::setprecision(1);
+    double loadTime = BestLoadTime();
+    cout << "Startup of V4 with every structure, best of " << kRuns
+        << " runs\n(" << cProcessors << " logical processors; the load alone takes " << loadTime << " ms)\n\n";
+    cout << "  threads   startup ms   builds ms   builds speedup   same indexes\n";
+    StartupResult single = MeasureStartup(1);
+    bool fSame = true;
+    for (unsigned cThreads : threadCounts) {
+        StartupResult result = cThreads == 1 ? single : MeasureStartup(cThreads);
+        double buildTime = result.bestTime - loadTime;
+        double singleBuildTime = single.bestTime - loadTime;
+        fSame = fSame && result.fingerprint == single.fingerprint;
+        cout << setw(9) << cThreads << setw(13) << result.bestTime << setw(12) << buildTime
+            << setw(16) << (buildTime > 0 ? singleBuildTime / buildTime : 0.0)
+            << setw(15) << (result.fingerprint == single.fingerprint ? "yes" : "NO") << '\n';
+    }
+
+    const unsigned cMaxThreads = *std::max_element(threadCounts.begin(), threadCounts.end());
+    cout << "\nEach structure alone, on a loaded dictionary\n\n";
+    cout << "                       1 thread ms   " << setw(2) << cMaxThreads << " threads ms   speedup\n";
+    TaskScheduler scheduler(cMaxThreads);
+    for (const Structure& structure : kStructures) {
+        double singleTime = BestBuildTime(structure, nullptr);
+        double parallelTime = BestBuildTime(structure, &scheduler);
+        cout << "  " << std::left << setw(20) << structure.pszName << std::right
+            << setw(13) << singleTime << setw(15) << parallelTime
+            << setw(10) << (parallelTime > 0 ? singleTime / parallelTime : 0.0) << '\n';
+    }
+
+    if (!fSame) {
+        cout << "\nwarning: the indexes built on several threads answer differently\n";
+        return 1;
+    }
+    return 0;
+}
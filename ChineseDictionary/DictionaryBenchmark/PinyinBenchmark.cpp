@@ -0,0 +1,151 @@
+// Pinyin tone marks.
+//
+// Converts the pinyin of every entry from tone numbers to tone marks, on
+// demand with ConvertPinyin() into a reused buffer, and with a baseline
+// that does what a straightforward display path would: split the field in
+// std::wstring syllables and build the result by concatenation. Then
+// compares the load time with and without DictionaryOptions::pinyinToneMarks,
+// which converts all the entries once at load.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Pinyin.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::BestTime;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const int kPasses = 10;
+
+typedef cedict::TextSpan<WCHAR> Span;
+
+// The baseline: one string per syllable, rule applied with std::wstring
+// searches, result built by appending.
+std::wstring ConvertPinyinWithStrings(const std::wstring& pinyin)
+{
+    static const std::wstring vowels = L"aeiou\u00FCAEIOU\u00DC";
+    std::wstring result;
+    size_t pos = 0;
+    while (pos <= pinyin.length()) {
+        size_t posSpace = pinyin.find(L' ', pos);
+        if (posSpace == std::wstring::npos) posSpace = pinyin.length();
+        std::wstring syllable = pinyin.substr(pos, posSpace - pos);
+
+        size_t posColon;
+        while ((posColon = syllable.find(L"u:")) != std::wstring::npos) {
+            syllable.replace(posColon, 2, L"\u00FC");
+        }
+        if (!syllable.empty() && syllable.back() >= L'1' && syllable.back() <= L'5') {
+            int tone = syllable.back() - L'1';
+            syllable.pop_back();
+            size_t posMark = syllable.find_first_of(L"aA");
+            if (posMark == std::wstring::npos) posMark = syllable.find_first_of(L"eE");
+            if (posMark == std::wstring::npos) {
+                posMark = syllable.find(L"ou");
+                if (posMark == std::wstring::npos) posMark = syllable.find_last_of(vowels);
+            }
+            if (tone < 4 && posMark != std::wstring::npos) {
+                int vowel = cedict::detail::VowelOf(syllable[posMark]);
+                syllable[posMark] = cedict::detail::kToneMarks[vowel][tone];
+            }
+        }
+
+        if (pos > 0) result += L' ';
+        result += syllable;
+        pos = posSpace + 1;
+    }
+    return result;
+}
+
+void PrintUtf8(const WCHAR* pch, size_t cch)
+{
+    int cb = WideCharToMultiByte(CP_UTF8, 0, pch, static_cast<int>(cch), NULL, 0, NULL, NULL);
+    std::string s(cb, '\0');
+    if (cb) {
+        WideCharToMultiByte(CP_UTF8, 0, pch, static_cast<int>(cch), &s[0], cb, NULL, NULL);
+    }
+    cout << s;
+}
+
+} // namespace
+
+
+int bench::PinyinBenchmark(int, char*[])
+{
+    DictionaryV4 dict(kDictionaryFile);
+    std::vector<Span> fields;
+    std::vector<std::wstring> fieldStrings;
+    size_t cchMax = 0;
+    size_t cchTotal = 0;
+    for (int i = 0; i < dict.Length(); ++i) {
+        Span pinyin = DictionaryV4::View(dict.Item(i).pinyin);
+        fields.push_back(pinyin);
+        fieldStrings.push_back(std::wstring(pinyin.pchBegin, pinyin.pchEnd));
+        cchMax = (std::max)(cchMax, pinyin.Length());
+        cchTotal += pinyin.Length();
+    }
+
+    // Both conversions must agree.
+    std::vector<WCHAR> buf(cchMax);
+    for (size_t i = 0; i < fields.size(); ++i) {
+        size_t cch = cedict::ConvertPinyin(fields[i].pchBegin, fields[i].pchEnd, buf.data());
+        if (std::wstring(buf.data(), cch) != ConvertPinyinWithStrings(fieldStrings[i])) {
+            cout << "The conversions of entry " << i << " differ.\n";
+            return 1;
+        }
+    }
+
+    cout << "Pinyin tone marks (V4, " << fields.size() << " entries, best of "
+        << kRuns << " runs of " << kPasses << " passes)\n\n";
+    for (size_t i = 0; i < fields.size() && i < 3; ++i) {
+        size_t cch = cedict::ConvertPinyin(fields[i].pchBegin, fields[i].pchEnd, buf.data());
+        cout << "  ";
+        PrintUtf8(fields[i].pchBegin, fields[i].Length());
+        cout << " -> ";
+        PrintUtf8(buf.data(), cch);
+        cout << '\n';
+    }
+    cout << '\n';
+
+    size_t checksum = 0;
+    double msConvert = BestTime(kRuns, [&]() {
+        for (int pass = 0; pass < kPasses; ++pass) {
+            for (const Span& field : fields) {
+                checksum += cedict::ConvertPinyin(field.pchBegin, field.pchEnd, buf.data());
+            }
+        }
+    });
+    double msStrings = BestTime(kRuns, [&]() {
+        for (int pass = 0; pass < kPasses; ++pass) {
+            for (const std::wstring& field : fieldStrings) {
+                checksum += ConvertPinyinWithStrings(field).length();
+            }
+        }
+    });
+
+    const double cConversions = static_cast<double>(fields.size()) * kPasses;
+    cout << std::fixed << std::setprecision(2);
+    cout << "  ConvertPinyin:       " << cConversions / msConvert / 1000 << " M conversions/s, "
+        << cchTotal * kPasses * sizeof(WCHAR) / msConvert / 1000 << " MB/s\n";
+    cout << "  std::wstring based:  " << cConversions / msStrings / 1000 << " M conversions/s, "
+        << cchTotal * kPasses * sizeof(WCHAR) / msStrings / 1000 << " MB/s\n\n";
+
+    cedict::DictionaryOptions marksOptions;
+    marksOptions.pinyinToneMarks = true;
+    double msLoad = BestTime(kRuns, []() { DictionaryV4 d(kDictionaryFile); });
+    double msLoadMarks = BestTime(kRuns, [&]() { DictionaryV4 d(kDictionaryFile, marksOptions); });
+    cout << "Load time\n";
+    cout << "  tone numbers:            " << msLoad << " ms\n";
+    cout << "  tone marks (batch):      " << msLoadMarks << " ms\n";
+    return checksum != 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+// Two-pass exact-size load.
+//
+// Compares the default load, where the entry vector grows by push_back and
+// the string pool by 32 KB chunks, with the two-pass load that counts lines
+// and characters first and allocates once.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include "Benchmarks.h"
+#include "ProcessCounters.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kRuns = 5;
+
+template <typename Dictionary>
+void MeasureVariant(const char* pszName)
+{
+    for (int presize = 0; presize < 2; ++presize) {
+        cedict::DictionaryOptions options;
+        options.presize = presize != 0;
+
+        double bestTime = 0;
+        DWORD minPageFaults = 0;
+        cedict::LoadStatistics stats;
+        for (int run = 0; run < kRuns; ++run) {
+            Stopwatch sw;
+            DWORD pageFaults = bench::PageFaultCount();
+            sw.Start();
+            Dictionary dict(bench::kDictionaryFile, options);
+            sw.Stop();
+            pageFaults = bench::PageFaultCount() - pageFaults;
+
+            if (run == 0 || sw.ElapsedMilliseconds() < bestTime) {
+                bestTime = sw.ElapsedMilliseconds();
+            }
+            if (run == 0 || pageFaults < minPageFaults) {
+                minPageFaults = pageFaults;
+            }
+            stats = dict.Statistics();
+        }
+
+        cout << std::left << setw(8) << pszName
+            << setw(10) << (options.presize ? "two-pass" : "one-pass")
+            << std::right << std::fixed << std::setprecision(1)
+            << setw(10) << bestTime
+            << setw(16) << stats.cEntryReallocations
+            << setw(14) << stats.cStorageChunks
+            << setw(14) << minPageFaults << '\n';
+    }
+}
+
+} // namespace
+
+
+int bench::PresizeBenchmark(int, char*[])
+{
+    cout << "Two-pass exact-size load (best of " << kRuns << " runs)\n\n";
+    cout << "Variant Mode       Time [ms]  Entry reallocs   Pool chunks   Page faults\n";
+
+    MeasureVariant<DictionaryV2>("V2");
+    MeasureVariant<DictionaryV2A>("V2A");
+    MeasureVariant<DictionaryV3>("V3");
+    MeasureVariant<DictionaryV4>("V4");
+    return 0;
+}
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// ProcessCounters.h -- Memory counters of the current process, and runs of
+//                      a benchmark in a process of its own.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include <psapi.h>
+#include <string>
+
+#pragma comment(lib, "psapi.lib")
+
+
+namespace bench
+{
+
+
+inline PROCESS_MEMORY_COUNTERS QueryMemoryCounters()
+{
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    pmc.cb = sizeof(pmc);
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+    return pmc;
+}
+
+// Page faults (soft and hard) taken by the process so far.
+inline DWORD PageFaultCount()
+{
+    return QueryMemoryCounters().PageFaultCount;
+}
+
+// Memory committed by the process that no other process can share (its
+// heaps, stacks and private allocations): unlike the working set, it does
+// not count the mapped files and sections.
+inline SIZE_T PrivateBytes()
+{
+    PROCESS_MEMORY_COUNTERS_EX pmc = {};
+    pmc.cb = sizeof(pmc);
+    GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc));
+    return pmc.PrivateUsage;
+}
+
+// Starts "DictionaryBenchmark --no-verify <arguments>"; its output goes to
+// ours. (The variants were verified by this process.) Returns the process
+// handle, for WaitBenchmarkProcess(), or NULL if it cannot be run.
+inline HANDLE StartBenchmarkProcess(const char* pszArguments)
+{
+    TCHAR szExe[MAX_PATH];
+    DWORD cch = GetModuleFileName(NULL, szExe, MAX_PATH);
+    if (cch == 0 || cch == MAX_PATH) return NULL;
+
+    std::basic_string<TCHAR> commandLine = std::basic_string<TCHAR>(TEXT("\"")) + szExe
+        + TEXT("\" --no-verify ");
+    for (const char* pch = pszArguments; *pch; ++pch) commandLine += static_cast<TCHAR>(*pch);
+
+    STARTUPINFO si = {};
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION pi = {};
+    if (!CreateProcess(NULL, &commandLine[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi)) {
+        return NULL;
+    }
+    CloseHandle(pi.hThread);
+    return pi.hProcess;
+}
+
+// Waits for a process started by StartBenchmarkProcess() and closes its
+// handle. False if it failed.
+inline bool WaitBenchmarkProcess(HANDLE hProcess)
+{
+    WaitForSingleObject(hProcess, INFINITE);
+    DWORD dwExitCode = 1;
+    GetExitCodeProcess(hProcess, &dwExitCode);
+    CloseHandle(hProcess);
+    return dwExitCode == 0;
+}
+
+// Runs "DictionaryBenchmark --no-verify <arguments>" and waits for it, so
+// that peak counters are those of the measured code alone. False if it
+// cannot be run or fails.
+inline bool RunBenchmarkProcess(const char* pszArguments)
+{
+    HANDLE hProcess = StartBenchmarkProcess(pszArguments);
+    return hProcess != NULL && WaitBenchmarkProcess(hProcess);
+}
+
+
+} // namespace bench
@@ -0,0 +1,137 @@
+// Sorted views of the entries: radix sort vs. comparison sorts.
+//
+// Sorts the ids of the entries by their traditional headword and by their
+// pinyin, stored as UTF-8, UTF-16 and WCHAR code units, with std::sort and
+// std::stable_sort of the ids (comparing the keys they point to), with
+// ParallelStableSort on all the threads, and with RadixSortIds (see
+// RadixSort.h) on one thread and on all of them. Reports the best of a few
+// runs of each, and checks that all of them give the order of
+// std::stable_sort: ties broken by id.
+//
+// VS2015 has no parallel algorithms (std::execution::par is C++17), so the
+// parallel comparison sort is the merge sort of TaskScheduler.h, which the
+// sorted index used before the radix sort.
+//
+// Usage: DictionaryBenchmark radixsort [threads]
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdlib>      // for atoi
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <numeric>      // for iota
+#include <thread>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::vector;
+using bench::BestTime;
+using cedict::TaskScheduler;
+
+
+namespace
+{
+
+const int kRuns = 5;
+
+// Best time of kRuns sorts of a fresh copy of ids by sort(ids); the sorted
+// ids of the last run are left in sorted.
+template <typename Sort>
+double BestSortTime(const vector<UINT32>& ids, vector<UINT32>& sorted, Sort sort)
+{
+    return BestTime(kRuns, [&]() { sorted = ids; }, [&]() { sort(sorted); });
+}
+
+// Sorts the ids of dict by the given field with each sort; false if one
+// of them gives another order.
+template <typename Dictionary>
+bool MeasureField(const Dictionary& dict, typename Dictionary::String Dictionary::Entry::*field,
+    const char* pszName, TaskScheduler& scheduler)
+{
+    typedef cedict::TextSpan<typename Dictionary::CharType> Key;
+    vector<Key> keys(dict.Length());
+    for (int i = 0; i < dict.Length(); ++i) keys[i] = Dictionary::View(dict.Item(i).*field);
+    vector<UINT32> ids(keys.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    auto less = [&](UINT32 a, UINT32 b) { return keys[a] < keys[b]; };
+    auto lessThenId = [&](UINT32 a, UINT32 b) {
+        return keys[a] < keys[b] || (!(keys[b] < keys[a]) && a < b);
+    };
+
+    vector<UINT32> expected, sorted;
+    double stableTime = BestSortTime(ids, expected, [&](vector<UINT32>& v) {
+        std::stable_sort(v.begin(), v.end(), less);
+    });
+
+    struct Result
+    {
+        const char* pszSort;
+        double time;
+        bool fSame;
+    };
+    vector<Result> results;
+    double sortTime = BestSortTime(ids, sorted, [&](vector<UINT32>& v) {
+        std::sort(v.begin(), v.end(), lessThenId);
+    });
+    results.push_back({ "std::sort", sortTime, sorted == expected });
+    results.push_back({ "std::stable_sort", stableTime, true });
+    double time = BestSortTime(ids, sorted, [&](vector<UINT32>& v) {
+        cedict::ParallelStableSort(&scheduler, v.begin(), v.end(), less);
+    });
+    results.push_back({ "ParallelStableSort", time, sorted == expected });
+    time = BestSortTime(ids, sorted, [&](vector<UINT32>& v) { cedict::RadixSortIds(keys, v); });
+    results.push_back({ "radix, 1 thread", time, sorted == expected });
+    time = BestSortTime(ids, sorted, [&](vector<UINT32>& v) {
+        cedict::RadixSortIds(keys, v, &scheduler);
+    });
+    results.push_back({ "radix, all threads", time, sorted == expected });
+
+    bool fSame = true;
+    for (const Result& r : results) {
+        cout << "  " << std::left << setw(8) << pszName << setw(20) << r.pszSort << std::right
+            << setw(11) << r.time << setw(10) << (r.time > 0 ? sortTime / r.time : 0.0)
+            << setw(8) << (r.fSame ? "yes" : "NO") << '\n';
+        fSame = fSame && r.fSame;
+    }
+    return fSame;
+}
+
+template <typename Dictionary>
+bool MeasureWidth(const char* pszUnit, TaskScheduler& scheduler)
+{
+    Dictionary dict(bench::kDictionaryFile);
+    cout << pszUnit << " (" << sizeof(typename Dictionary::CharType) << "-byte code units, "
+        << dict.Length() << " entries)\n";
+    bool fSame = MeasureField(dict, &Dictionary::Entry::trad, "trad", scheduler);
+    fSame = MeasureField(dict, &Dictionary::Entry::pinyin, "pinyin", scheduler) && fSame;
+    cout << '\n';
+    return fSame;
+}
+
+} // namespace
+
+
+int bench::RadixSortBenchmark(int argc, char* argv[])
+{
+    unsigned cThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+    if (argc > 0 && atoi(argv[0]) > 0) cThreads = static_cast<unsigned>(atoi(argv[0]));
+    TaskScheduler scheduler(cThreads);
+
+    cout << std::fixed << std::setprecision(2);
+    cout << "Sorting the entry ids by key, best of " << kRuns << " runs, " << cThreads
+        << " threads for the parallel sorts\n\n";
+    cout << "  Key     Sort                  Time [ms]   Speedup   Same\n";
+    bool fSame = MeasureWidth<DictionaryV4Width<char>>("UTF-8", scheduler);
+    fSame = MeasureWidth<DictionaryV4Width<char16_t>>("UTF-16", scheduler) && fSame;
+    fSame = MeasureWidth<DictionaryV4>("WCHAR", scheduler) && fSame;
+
+    if (!fSame) {
+        cout << "warning: a sort gave another order than std::stable_sort\n";
+        return 1;
+    }
+    return 0;
+}
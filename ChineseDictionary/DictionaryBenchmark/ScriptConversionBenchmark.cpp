@@ -0,0 +1,136 @@
+// Traditional/simplified conversion.
+//
+// Learns the conversion tables from the headwords of the dictionary, checks
+// how many headwords they convert exactly, then converts a synthetic corpus
+// made of random headwords, punctuation and Latin words, in both directions.
+// The baseline converts character by character with a std::unordered_map,
+// without phrases.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <unordered_map>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::BestTime;
+using bench::NextRandom;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const size_t kCorpusLength = 32 * 1024 * 1024;     // characters
+
+typedef cedict::TextSpan<WCHAR> Span;
+typedef cedict::ScriptConverter<WCHAR> Converter;
+
+// Same random sequence of entries for both scripts, so that the two corpora
+// are conversions of each other.
+std::vector<WCHAR> MakeCorpus(const bench::DictionaryV4& dict, bool fSimplified)
+{
+    static const WCHAR* const kFillers[] = {
+        L"\u3002", L"\uFF0C", L"\u3001", L" ", L"CEDICT ", L"2016 ", L"\uFF1F",
+    };
+    std::vector<WCHAR> corpus;
+    corpus.reserve(kCorpusLength + 256);
+    UINT32 state = 2463534242u;
+    while (corpus.size() < kCorpusLength) {
+        UINT32 r = NextRandom(state);
+        if (r % 8 == 0) {
+            LPCWSTR psz = kFillers[(r >> 8) % _countof(kFillers)];
+            Span filler = cedict::MakeSpan(psz);
+            corpus.insert(corpus.end(), filler.pchBegin, filler.pchEnd);
+            continue;
+        }
+        const auto& entry = dict.Item((r >> 3) % dict.Length());
+        Span word = bench::DictionaryV4::View(fSimplified ? entry.simp : entry.trad);
+        corpus.insert(corpus.end(), word.pchBegin, word.pchEnd);
+    }
+    corpus.resize(kCorpusLength);
+    return corpus;
+}
+
+// Number of entries whose headword converts exactly.
+size_t CountExact(const bench::DictionaryV4& dict, const Converter& converter, bool fFromTrad)
+{
+    std::vector<WCHAR> buf;
+    size_t cExact = 0;
+    for (int i = 0; i < dict.Length(); ++i) {
+        const auto& entry = dict.Item(i);
+        Span from = bench::DictionaryV4::View(fFromTrad ? entry.trad : entry.simp);
+        Span to = bench::DictionaryV4::View(fFromTrad ? entry.simp : entry.trad);
+        buf.resize(from.Length());
+        size_t cch = converter.Convert(from.pchBegin, from.pchEnd, buf.data());
+        if (cedict::MakeSpan<WCHAR>(buf.data(), buf.data() + cch) == to) cExact++;
+    }
+    return cExact;
+}
+
+void MeasureDirection(const char* pszName, const bench::DictionaryV4& dict,
+    const Converter& converter, bool fFromTrad)
+{
+    std::vector<WCHAR> corpus = MakeCorpus(dict, !fFromTrad);
+    std::vector<WCHAR> out(corpus.size());
+    const double cb = static_cast<double>(corpus.size() * sizeof(WCHAR));
+
+    double ms = BestTime(kRuns, [&]() {
+        converter.Convert(corpus.data(), corpus.data() + corpus.size(), out.data());
+    });
+
+    // Baseline: the same character map in a hash table, no phrases.
+    std::unordered_map<WCHAR, WCHAR> charMap;
+    std::vector<WCHAR> one(1);
+    for (UINT32 ch = 0; ch < 0x10000; ++ch) {
+        WCHAR wch = static_cast<WCHAR>(ch);
+        converter.Convert(&wch, &wch + 1, one.data());
+        if (one[0] != wch) charMap[wch] = one[0];
+    }
+    double msBaseline = BestTime(kRuns, [&]() {
+        WCHAR* pchOut = out.data();
+        for (WCHAR ch : corpus) {
+            auto i = charMap.find(ch);
+            *pchOut++ = i == charMap.end() ? ch : i->second;
+        }
+    });
+
+    size_t cExact = CountExact(dict, converter, fFromTrad);
+    cout << pszName << '\n';
+    cout << "  mapped characters: " << converter.MappedCharCount()
+        << ", phrases: " << converter.PhraseCount()
+        << " (longest " << converter.LongestPhrase() << ")\n";
+    cout << "  exact headwords:   " << cExact << " of " << dict.Length() << " ("
+        << 100.0 * cExact / dict.Length() << "%)\n";
+    cout << "  ScriptConverter:   " << ms << " ms, " << cb / ms / 1000 << " MB/s\n";
+    cout << "  unordered_map:     " << msBaseline << " ms, " << cb / msBaseline / 1000
+        << " MB/s (characters only)\n\n";
+}
+
+} // namespace
+
+
+int bench::ScriptConversionBenchmark(int, char*[])
+{
+    DictionaryV4 dict(kDictionaryFile);
+
+    Stopwatch sw;
+    sw.Start();
+    dict.BuildScriptConverters();
+    sw.Stop();
+
+    cout << std::fixed << std::setprecision(2);
+    cout << "Traditional/simplified conversion (V4, " << dict.Length() << " entries)\n";
+    cout << "Tables built in " << sw.ElapsedMilliseconds() << " ms; corpus of "
+        << kCorpusLength * sizeof(WCHAR) / (1024 * 1024) << " MB (UTF-16), best of "
+        << kRuns << " runs\n\n";
+
+    MeasureDirection("Traditional to simplified", dict, dict.TradToSimp(), true);
+    MeasureDirection("Simplified to traditional", dict, dict.SimpToTrad(), false);
+    return 0;
+}
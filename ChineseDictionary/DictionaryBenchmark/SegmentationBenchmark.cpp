@@ -0,0 +1,187 @@
+// Maximum-match segmentation with a headword filter.
+//
+// Segments a synthetic text (random headwords, punctuation and Latin words)
+// by forward maximum matching: at each position, look up the longest
+// candidate first, then shorter ones, down to a single character. Most
+// candidates are not headwords. Measured with the index alone, then with
+// the Bloom filter of DictionaryOptions::headwordFilter in front of it; also
+// measures the candidates that are not headwords on their own, and reports
+// the false positive rate of the filter over them and its size per key.
+
+#include <windows.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::BestTime;
+using bench::NextRandom;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const size_t kTextLength = 4 * 1024 * 1024;     // characters
+const size_t kMaxWordLength = 8;
+const size_t kMaxNegatives = 4 * 1000 * 1000;
+
+typedef cedict::TextSpan<WCHAR> Span;
+
+std::vector<WCHAR> MakeText(const bench::DictionaryV4& dict)
+{
+    static const WCHAR* const kFillers[] = {
+        L"\u3002", L"\uFF0C", L"\u3001", L"CEDICT", L"2016", L"\uFF1F",
+    };
+    std::vector<WCHAR> text;
+    text.reserve(kTextLength + 256);
+    UINT32 state = 2463534242u;
+    while (text.size() < kTextLength) {
+        UINT32 r = NextRandom(state);
+        Span word = (r % 8 == 0)
+            ? cedict::MakeSpan(kFillers[(r >> 8) % _countof(kFillers)])
+            : bench::DictionaryV4::View(dict.Item((r >> 3) % dict.Length()).trad);
+        text.insert(text.end(), word.pchBegin, word.pchEnd);
+    }
+    text.resize(kTextLength);
+    return text;
+}
+
+struct SegmentationResult
+{
+    size_t cWords;      // words found in the dictionary
+    size_t cProbes;     // calls to Find()
+};
+
+SegmentationResult Segment(const bench::DictionaryV4& dict, const std::vector<WCHAR>& text,
+    size_t cchMaxWord)
+{
+    SegmentationResult result = { 0, 0 };
+    const WCHAR* pch = text.data();
+    const WCHAR* pchEnd = pch + text.size();
+    while (pch < pchEnd) {
+        size_t cch = (std::min)(cchMaxWord, static_cast<size_t>(pchEnd - pch));
+        for (; cch > 0; --cch) {
+            result.cProbes++;
+            if (dict.Find(pch, pch + cch) != cedict::kNoEntry) break;
+        }
+        if (cch > 0) {
+            result.cWords++;
+        } else {
+            cch = 1;
+        }
+        pch += cch;
+    }
+    return result;
+}
+
+// Candidates that are not headwords, and how many of them pass the filter;
+// the first kMaxNegatives of them are kept in negatives.
+void CountFalsePositives(const bench::DictionaryV4& dict, const std::vector<WCHAR>& text,
+    size_t cchMaxWord, size_t* pcNegatives, size_t* pcFalsePositives, std::vector<Span>& negatives)
+{
+    size_t cNegatives = 0;
+    size_t cFalsePositives = 0;
+    negatives.clear();
+    const WCHAR* pch = text.data();
+    const WCHAR* pchEnd = pch + text.size();
+    for (; pch < pchEnd; ++pch) {
+        size_t cchMax = (std::min)(cchMaxWord, static_cast<size_t>(pchEnd - pch));
+        for (size_t cch = 1; cch <= cchMax; ++cch) {
+            Span key = cedict::MakeSpan(pch, pch + cch);
+            if (dict.Index().Find(key) != cedict::kNoEntry) continue;
+            cNegatives++;
+            if (negatives.size() < kMaxNegatives) negatives.push_back(key);
+            if (dict.Filter().MayContain(cedict::HashSpan(key))) cFalsePositives++;
+        }
+    }
+    *pcNegatives = cNegatives;
+    *pcFalsePositives = cFalsePositives;
+}
+
+// Nanoseconds per lookup of the negatives, through the index or Find().
+double NegativeNanoseconds(const bench::DictionaryV4& dict, const std::vector<Span>& negatives,
+    bool fFilter)
+{
+    size_t cFound = 0;
+    double bestTime = BestTime(kRuns, [&]() {
+        for (const Span& key : negatives) {
+            UINT32 id = fFilter ? dict.Find(key.pchBegin, key.pchEnd) : dict.Index().Find(key);
+            if (id != cedict::kNoEntry) cFound++;
+        }
+    });
+    return cFound == 0 ? bestTime * 1e6 / negatives.size() : 0;
+}
+
+void PrintResult(const char* pszName, double ms, const SegmentationResult& result)
+{
+    cout << "  " << std::left << std::setw(16) << pszName << std::right
+        << std::setw(9) << ms << " ms" << std::setw(9) << kTextLength / ms / 1000 << " M chars/s"
+        << std::setw(9) << result.cProbes / ms / 1000 << " M probes/s\n";
+}
+
+} // namespace
+
+
+int bench::SegmentationBenchmark(int, char*[])
+{
+    cedict::DictionaryOptions options;
+    options.buildIndex = true;
+    DictionaryV4 dict(kDictionaryFile, options);
+
+    size_t cchLongest = 0;
+    for (int i = 0; i < dict.Length(); ++i) {
+        cchLongest = (std::max)(cchLongest, DictionaryV4::View(dict.Item(i).trad).Length());
+    }
+    const size_t cchMaxWord = (std::min)(cchLongest, kMaxWordLength);
+    std::vector<WCHAR> text = MakeText(dict);
+
+    cout << std::fixed << std::setprecision(2);
+    cout << "Forward maximum matching (V4, " << dict.Length() << " entries; "
+        << kTextLength / (1024 * 1024) << "M characters, words of up to "
+        << cchMaxWord << " characters, best of " << kRuns << " runs)\n\n";
+
+    SegmentationResult plain;
+    double msPlain = BestTime(kRuns, [&]() { plain = Segment(dict, text, cchMaxWord); });
+
+    Stopwatch sw;
+    sw.Start();
+    dict.BuildHeadwordFilter();
+    sw.Stop();
+    double msBuild = sw.ElapsedMilliseconds();
+
+    SegmentationResult filtered;
+    double msFiltered = BestTime(kRuns, [&]() { filtered = Segment(dict, text, cchMaxWord); });
+
+    PrintResult("index only", msPlain, plain);
+    PrintResult("filter + index", msFiltered, filtered);
+    cout << "  " << plain.cWords << " words, " << plain.cProbes << " probes; speedup "
+        << msPlain / msFiltered << "x\n\n";
+    if (filtered.cWords != plain.cWords || filtered.cProbes != plain.cProbes) {
+        cout << "The segmentations differ.\n";
+        return 1;
+    }
+
+    size_t cNegatives = 0;
+    size_t cFalsePositives = 0;
+    std::vector<Span> negatives;
+    CountFalsePositives(dict, text, cchMaxWord, &cNegatives, &cFalsePositives, negatives);
+    double nsIndex = NegativeNanoseconds(dict, negatives, false);
+    double nsFilter = NegativeNanoseconds(dict, negatives, true);
+    cout << "Non-headword candidates alone (" << negatives.size() << ")\n";
+    cout << "  index only:          " << nsIndex << " ns/lookup\n";
+    cout << "  filter + index:      " << nsFilter << " ns/lookup\n\n";
+    cout << "Filter\n";
+    cout << "  size:                " << dict.Filter().Bytes() / 1024 << " KB, "
+        << dict.Filter().Bytes() * 8.0 / dict.Length() << " bits per headword\n";
+    cout << "  build time:          " << msBuild << " ms\n";
+    cout << "  false positive rate: " << 100.0 * cFalsePositives / cNegatives << "% ("
+        << cFalsePositives << " of " << cNegatives << " non-headwords)\n";
+    return 0;
+}
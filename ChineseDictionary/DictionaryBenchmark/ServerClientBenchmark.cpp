@@ -0,0 +1,300 @@
+// Lookups through the dictionary server, with pipelined requests.
+//
+// Start DictionaryServer first (in the directory of the dictionary file).
+// The benchmark reads the keys of each field with an EntryReader:
+// traditional and simplified headwords, pinyin and English glosses. Each
+// connection then sends its lookups, cycling through the fields, depth at a
+// time: it writes depth requests at once, and reads until it has all their
+// responses. The server answers what it reads as one batch, so deeper
+// pipelines pay fewer reads, writes and thread switches per lookup, at the
+// cost of the latency of each request, timed from the write of its batch to
+// the reading of its response.
+//
+// The write of a batch is overlapped with the reading of its responses: a
+// deep batch does not fit in the pipe buffers, and the server does not read
+// more requests until the client has read the responses it is writing.
+//
+// Usage: DictionaryBenchmark client [connections] [depth]
+//        (defaults to 4 connections, and depths 1, 16 and 128)
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdlib>      // for atoi
+#include <cstring>      // for memcpy, memmove
+#include <functional>   // for std::cref
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <string>
+#include <thread>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "EntryReader.h"
+#include "FieldIndex.h"
+#include "LatencyHistogram.h"
+#include "LookupProtocol.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::vector;
+using std::wstring;
+using bench::LatencyHistogram;
+using bench::NextRandom;
+using bench::Now;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kDefaultConnections = 4;
+const int kDefaultDepths[] = { 1, 16, 128 };
+const int kLookupsPerConnection = 50 * 1000;
+const int kConnectAttempts = 20;
+
+typedef cedict::TextSpan<WCHAR> Key;
+
+
+inline Key MakeKey(const wstring& s)
+{
+    return cedict::MakeSpan(s.data(), s.data() + s.length());
+}
+
+// Opens a connection to the server, or returns INVALID_HANDLE_VALUE.
+HANDLE Connect()
+{
+    for (int attempt = 0; attempt < kConnectAttempts; ++attempt) {
+        HANDLE hPipe = CreateFile(cedict::kLookupPipeName, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+            OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+        if (hPipe != INVALID_HANDLE_VALUE) return hPipe;
+        // All the instances of the pipe are taken until the server creates
+        // the next one.
+        if (GetLastError() != ERROR_PIPE_BUSY) break;
+        WaitNamedPipe(cedict::kLookupPipeName, 1000);
+    }
+    return INVALID_HANDLE_VALUE;
+}
+
+// An overlapped read or write of the pipe, and its event.
+class PipeIo
+{
+public:
+    PipeIo() : m_overlapped(), m_fPending(false)
+    {
+        m_overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+
+    ~PipeIo() { CloseHandle(m_overlapped.hEvent); }
+
+    // Starts writing [pb, pb + cb); the bytes must stay valid until Wait().
+    bool StartWrite(HANDLE hPipe, const BYTE* pb, size_t cb)
+    {
+        return Started(WriteFile(hPipe, pb, static_cast<DWORD>(cb), NULL, &m_overlapped));
+    }
+
+    bool StartRead(HANDLE hPipe, BYTE* pb, size_t cb)
+    {
+        return Started(ReadFile(hPipe, pb, static_cast<DWORD>(cb), NULL, &m_overlapped));
+    }
+
+    // Waits for the transfer, and returns the bytes transferred, or 0 if
+    // it failed.
+    DWORD Wait(HANDLE hPipe)
+    {
+        DWORD cb = 0;
+        if (m_fPending && !GetOverlappedResult(hPipe, &m_overlapped, &cb, TRUE)) cb = 0;
+        m_fPending = false;
+        return cb;
+    }
+
+    // Cancels the transfer if it is still going on, and waits until the
+    // system no longer uses its buffer.
+    void Cancel(HANDLE hPipe)
+    {
+        if (!m_fPending) return;
+        CancelIoEx(hPipe, &m_overlapped);
+        Wait(hPipe);
+    }
+
+private:
+    PipeIo(const PipeIo&) = delete;
+    PipeIo& operator=(const PipeIo&) = delete;
+
+    bool Started(BOOL fDone)
+    {
+        m_fPending = fDone || GetLastError() == ERROR_IO_PENDING;
+        return m_fPending;
+    }
+
+    OVERLAPPED m_overlapped;
+    bool m_fPending;
+};
+
+
+// A lookup: the field, and the key in the keys of the field.
+struct Query
+{
+    cedict::LookupField field;
+    UINT32 iKey;
+};
+
+struct ConnectionResult
+{
+    ConnectionResult() : cHits(0), fOk(false) {}
+
+    LatencyHistogram latency;   // in nanoseconds
+    UINT64 cHits;
+    bool fOk;
+};
+
+// Sends the queries over hPipe, depth at a time.
+void RunConnection(HANDLE hPipe, const vector<wstring> (&keys)[cedict::kLookupFieldCount],
+    const vector<Query>& queries, int depth, double nsPerTick, ConnectionResult& result)
+{
+    vector<BYTE> out;
+    vector<BYTE> in(64 * 1024);
+    PipeIo write;
+    PipeIo read;
+    for (size_t iFirst = 0; iFirst < queries.size(); iFirst += depth) {
+        size_t cQueries = (std::min)(static_cast<size_t>(depth), queries.size() - iFirst);
+        out.clear();
+        for (size_t i = iFirst; i < iFirst + cQueries; ++i) {
+            const Query& query = queries[i];
+            cedict::AppendRequest(out, query.field, MakeKey(keys[query.field][query.iKey]));
+        }
+
+        LONGLONG tickSent = Now();
+        if (!write.StartWrite(hPipe, out.data(), out.size())) return;
+
+        size_t cbHave = 0;
+        for (size_t cResponses = 0; cResponses < cQueries; ) {
+            if (cbHave == in.size()) in.resize(in.size() * 2);
+            DWORD cbRead = 0;
+            if (read.StartRead(hPipe, &in[cbHave], in.size() - cbHave)) cbRead = read.Wait(hPipe);
+            if (cbRead == 0) {
+                write.Cancel(hPipe);
+                return;
+            }
+            cbHave += cbRead;
+
+            size_t ib = 0;
+            for (size_t cb; cResponses < cQueries && (cb = cedict::ResponseSize(&in[ib], cbHave - ib)) != 0; ) {
+                cedict::ResponseHeader header;
+                memcpy(&header, &in[ib], sizeof(header));
+                result.cHits += header.cMatches != 0;
+                result.latency.Record(static_cast<UINT64>((Now() - tickSent) * nsPerTick));
+                cResponses++;
+                ib += cb;
+            }
+            memmove(&in[0], &in[ib], cbHave - ib);
+            cbHave -= ib;
+        }
+        // The server has read all the requests, as it answered them.
+        if (write.Wait(hPipe) != out.size()) return;
+    }
+    result.fOk = true;
+}
+
+} // namespace
+
+
+int bench::ServerClientBenchmark(int argc, char* argv[])
+{
+    int cConnections = argc > 0 ? atoi(argv[0]) : 0;
+    if (cConnections <= 0) cConnections = kDefaultConnections;
+    vector<int> depths(std::begin(kDefaultDepths), std::end(kDefaultDepths));
+    if (argc > 1 && atoi(argv[1]) > 0) depths.assign(1, atoi(argv[1]));
+
+    vector<wstring> keys[cedict::kLookupFieldCount];
+    {
+        cedict::EntryReader<> reader(kDictionaryFile);
+        for (const auto& entry : reader) {
+            keys[cedict::kLookupTraditional].push_back(wstring(entry.trad.pchBegin, entry.trad.pchEnd));
+            keys[cedict::kLookupSimplified].push_back(wstring(entry.simp.pchBegin, entry.simp.pchEnd));
+            keys[cedict::kLookupPinyin].push_back(wstring(entry.pinyin.pchBegin, entry.pinyin.pchEnd));
+            cedict::ForEachGloss(entry.english, [&](const WCHAR* pchBegin, const WCHAR* pchEnd) {
+                keys[cedict::kLookupEnglish].push_back(wstring(pchBegin, pchEnd));
+            });
+        }
+    }
+    if (keys[cedict::kLookupTraditional].empty()) {
+        cout << "The dictionary is empty.\n";
+        return 1;
+    }
+
+    vector<HANDLE> pipes;
+    for (int c = 0; c < cConnections; ++c) {
+        HANDLE hPipe = Connect();
+        if (hPipe == INVALID_HANDLE_VALUE) {
+            cout << "Cannot connect to the server (error " << GetLastError()
+                << "); start DictionaryServer first.\n";
+            for (HANDLE h : pipes) CloseHandle(h);
+            return 1;
+        }
+        pipes.push_back(hPipe);
+    }
+
+    // The same queries for every depth: field f of the lookups f, f + 4, ...
+    vector<vector<Query>> queries(cConnections);
+    for (int c = 0; c < cConnections; ++c) {
+        UINT32 state = 88172645u + 7919u * c;
+        queries[c].resize(kLookupsPerConnection);
+        for (int i = 0; i < kLookupsPerConnection; ++i) {
+            Query& query = queries[c][i];
+            query.field = static_cast<cedict::LookupField>(i % cedict::kLookupFieldCount);
+            query.iKey = NextRandom(state) % keys[query.field].size();
+        }
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double nsPerTick = 1e9 / frequency.QuadPart;
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "Lookups through DictionaryServer from " << cConnections << " connections, "
+        << kLookupsPerConnection << " per connection, all fields in turn\n\n";
+    cout << "  depth    k QPS    p50 us    p99 us   p999 us      max us\n";
+    bool fOk = true;
+    for (int depth : depths) {
+        vector<ConnectionResult> results(cConnections);
+        vector<std::thread> threads;
+        Stopwatch sw;
+        sw.Start();
+        for (int c = 0; c < cConnections; ++c) {
+            threads.emplace_back(RunConnection, pipes[c], std::cref(keys), std::cref(queries[c]),
+                depth, nsPerTick, std::ref(results[c]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        sw.Stop();
+
+        LatencyHistogram latency;
+        UINT64 cHits = 0;
+        for (const ConnectionResult& result : results) {
+            fOk = fOk && result.fOk;
+            latency.Add(result.latency);
+            cHits += result.cHits;
+        }
+        if (!fOk) {
+            cout << "The server closed a connection.\n";
+            break;
+        }
+        cout << setw(7) << depth
+            << setw(9) << static_cast<double>(cConnections) * kLookupsPerConnection
+                / sw.ElapsedMilliseconds()
+            << setw(10) << latency.Percentile(0.5) / 1000.0
+            << setw(10) << latency.Percentile(0.99) / 1000.0
+            << setw(10) << latency.Percentile(0.999) / 1000.0
+            << setw(12) << latency.Max() / 1000.0 << '\n';
+        UINT64 cExpected = static_cast<UINT64>(cConnections) * kLookupsPerConnection;
+        if (cHits != cExpected) {
+            cout << "  warning: " << cHits << " lookups found their key instead of " << cExpected << '\n';
+        }
+    }
+
+    for (HANDLE hPipe : pipes) CloseHandle(hPipe);
+    return fOk ? 0 : 1;
+}
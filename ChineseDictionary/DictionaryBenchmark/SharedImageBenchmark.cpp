@@ -0,0 +1,287 @@
+// Worker processes sharing one image of the dictionary vs. each loading it.
+//
+// Loads V4 and builds its image (see DictionaryImage.h) in a named shared
+// memory section, then starts N worker processes at once (this program, run
+// again as a worker), first with each worker loading its own dictionary,
+// then with each worker attaching to the image. A worker makes the
+// dictionary ready (load or attach, with the headword index either way),
+// reads all the entries once and looks up random headwords, as a worker
+// that serves lookups would, then reports its working set and its private
+// bytes in a section of results shared with this process.
+//
+// The working set counts the pages of the image that a worker has touched,
+// although they are in memory once for all the workers; the private bytes
+// do not, which is the memory that each worker really adds.
+//
+// Usage: DictionaryBenchmark shared [workers]   (16 by default)
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdlib>      // for atoi
+#include <iomanip>
+#include <iostream>     // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "DictionaryImage.h"
+#include "ProcessCounters.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using std::vector;
+using bench::Megabytes;
+using bench::NextRandom;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kDefaultWorkers = 16;
+const int kLookupsPerWorker = 200 * 1000;
+
+typedef cedict::TextSpan<WCHAR> Key;
+typedef cedict::DictionaryImage<WCHAR> DictionaryImage;
+
+enum WorkerMode { kOwnDictionary, kAttachedImage };
+
+// What a worker reports, in its slot of the results section.
+struct WorkerReport
+{
+    double readyMilliseconds;   // to load the dictionary or attach the image
+    double workMilliseconds;
+    UINT64 cbWorkingSet;
+    UINT64 cbPrivate;
+    UINT32 checksum;            // the same in both modes
+    UINT32 fDone;
+};
+
+
+std::wstring ImageName(DWORD dwParentId)
+{
+    return L"Local\\cedict-image-" + std::to_wstring(dwParentId);
+}
+
+std::wstring ResultsName(DWORD dwParentId)
+{
+    return L"Local\\cedict-results-" + std::to_wstring(dwParentId);
+}
+
+
+// The work of a worker, over a loaded dictionary or an image: Item(i)
+// gives the fields of entry i, find(key) the first entry of a headword.
+template <typename ItemFunction, typename FindFunction>
+UINT32 Work(int cEntries, ItemFunction item, FindFunction find)
+{
+    UINT32 checksum = 0;
+    for (int i = 0; i < cEntries; ++i) {
+        cedict::EntryFields<WCHAR> e = item(i);
+        checksum += static_cast<UINT32>(e.trad.Length() + e.simp.Length() + e.pinyin.Length()
+            + e.english.Length());
+    }
+    UINT32 state = 2463534242u;
+    for (int i = 0; i < kLookupsPerWorker; ++i) {
+        Key key = item(NextRandom(state) % cEntries).trad;
+        UINT32 id = find(key);
+        checksum = checksum * 31 + id;
+        if (id != cedict::kNoEntry) checksum += static_cast<UINT32>(item(id).pinyin.Length());
+    }
+    return checksum;
+}
+
+int RunWorker(WorkerMode mode, int iWorker, DWORD dwParentId)
+{
+    HANDLE hResults = OpenFileMapping(FILE_MAP_WRITE, FALSE, ResultsName(dwParentId).c_str());
+    if (hResults == NULL) return 1;
+    WorkerReport* pReports = static_cast<WorkerReport*>(MapViewOfFile(hResults, FILE_MAP_WRITE, 0, 0, 0));
+    if (!pReports) {
+        CloseHandle(hResults);
+        return 1;
+    }
+    WorkerReport& report = pReports[iWorker];
+
+    Stopwatch sw;
+    if (mode == kOwnDictionary) {
+        sw.Start();
+        cedict::DictionaryOptions options;
+        options.buildIndex = true;
+        bench::DictionaryV4 dict(bench::kDictionaryFile, options);
+        sw.Stop();
+        report.readyMilliseconds = sw.ElapsedMilliseconds();
+
+        sw.Start();
+        report.checksum = Work(dict.Length(),
+            [&](int i) {
+                const bench::DictionaryV4::Entry& e = dict.Item(i);
+                cedict::EntryFields<WCHAR> fields = {
+                    bench::DictionaryV4::View(e.trad), bench::DictionaryV4::View(e.simp),
+                    bench::DictionaryV4::View(e.pinyin), bench::DictionaryV4::View(e.english)
+                };
+                return fields;
+            },
+            [&](const Key& key) { return dict.Find(key.pchBegin, key.pchEnd); });
+        sw.Stop();
+        report.workMilliseconds = sw.ElapsedMilliseconds();
+        report.cbWorkingSet = bench::QueryMemoryCounters().WorkingSetSize;
+        report.cbPrivate = bench::PrivateBytes();
+    } else {
+        sw.Start();
+        DictionaryImage image(ImageName(dwParentId).c_str());
+        sw.Stop();
+        report.readyMilliseconds = sw.ElapsedMilliseconds();
+        if (!image.IsOpen()) return 1;
+
+        sw.Start();
+        report.checksum = Work(image.Length(),
+            [&](int i) { return image.Item(i); },
+            [&](const Key& key) { return image.Find(key); });
+        sw.Stop();
+        report.workMilliseconds = sw.ElapsedMilliseconds();
+        report.cbWorkingSet = bench::QueryMemoryCounters().WorkingSetSize;
+        report.cbPrivate = bench::PrivateBytes();
+    }
+    report.fDone = 1;
+
+    UnmapViewOfFile(pReports);
+    CloseHandle(hResults);
+    return 0;
+}
+
+
+struct ModeSummary
+{
+    double readyMedian;
+    double readyMax;
+    double workMedian;
+    double cbWorkingSet;    // mean per worker
+    double cbPrivate;
+    UINT32 checksum;
+    bool fSameChecksum;
+};
+
+// Runs cWorkers workers of the given mode at once; false if one failed.
+bool RunWorkers(WorkerMode mode, int cWorkers, WorkerReport* pReports, ModeSummary& summary)
+{
+    std::fill(pReports, pReports + cWorkers, WorkerReport());
+    vector<HANDLE> processes;
+    bool fOk = true;
+    cout.flush();
+    for (int i = 0; i < cWorkers; ++i) {
+        std::string arguments = std::string("shared worker ") + (mode == kOwnDictionary ? "load " : "attach ")
+            + std::to_string(i) + ' ' + std::to_string(GetCurrentProcessId());
+        HANDLE hProcess = bench::StartBenchmarkProcess(arguments.c_str());
+        if (hProcess == NULL) {
+            fOk = false;
+            break;
+        }
+        processes.push_back(hProcess);
+    }
+    for (HANDLE hProcess : processes) {
+        fOk = bench::WaitBenchmarkProcess(hProcess) && fOk;
+    }
+    if (!fOk) return false;
+
+    vector<double> ready, work;
+    summary.cbWorkingSet = 0;
+    summary.cbPrivate = 0;
+    summary.checksum = pReports[0].checksum;
+    summary.fSameChecksum = true;
+    for (int i = 0; i < cWorkers; ++i) {
+        const WorkerReport& report = pReports[i];
+        if (!report.fDone) return false;
+        ready.push_back(report.readyMilliseconds);
+        work.push_back(report.workMilliseconds);
+        summary.cbWorkingSet += static_cast<double>(report.cbWorkingSet) / cWorkers;
+        summary.cbPrivate += static_cast<double>(report.cbPrivate) / cWorkers;
+        summary.fSameChecksum = summary.fSameChecksum && report.checksum == pReports[0].checksum;
+    }
+    std::sort(ready.begin(), ready.end());
+    std::sort(work.begin(), work.end());
+    summary.readyMedian = ready[ready.size() / 2];
+    summary.readyMax = ready.back();
+    summary.workMedian = work[work.size() / 2];
+    return true;
+}
+
+} // namespace
+
+
+int bench::SharedImageBenchmark(int argc, char* argv[])
+{
+    cout << std::fixed << std::setprecision(1);
+    if (argc > 0 && _stricmp(argv[0], "worker") == 0) {
+        if (argc < 4) return 1;
+        WorkerMode mode = _stricmp(argv[1], "load") == 0 ? kOwnDictionary : kAttachedImage;
+        return RunWorker(mode, atoi(argv[2]), static_cast<DWORD>(atoi(argv[3])));
+    }
+
+    int cWorkers = argc > 0 ? atoi(argv[0]) : 0;
+    if (cWorkers <= 0) cWorkers = kDefaultWorkers;
+
+    Stopwatch sw;
+    sw.Start();
+    DictionaryV4 dict(kDictionaryFile);
+    sw.Stop();
+    double loadMilliseconds = sw.ElapsedMilliseconds();
+    if (dict.Length() == 0) {
+        cout << "The dictionary is empty.\n";
+        return 1;
+    }
+
+    sw.Start();
+    DictionaryImage image(dict, ImageName(GetCurrentProcessId()).c_str());
+    sw.Stop();
+    if (!image.IsOpen()) {
+        cout << "Cannot create the image section (error " << GetLastError() << ").\n";
+        return 1;
+    }
+    cout << "Image of " << image.Length() << " entries: " << Megabytes(static_cast<double>(image.Bytes()))
+        << " MB, built in " << sw.ElapsedMilliseconds() << " ms after a " << loadMilliseconds
+        << " ms load\n";
+
+    const DWORD cbResults = static_cast<DWORD>(cWorkers * sizeof(WorkerReport));
+    HANDLE hResults = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, cbResults,
+        ResultsName(GetCurrentProcessId()).c_str());
+    WorkerReport* pReports = hResults == NULL ? nullptr
+        : static_cast<WorkerReport*>(MapViewOfFile(hResults, FILE_MAP_WRITE, 0, 0, 0));
+    if (!pReports) {
+        cout << "Cannot create the results section.\n";
+        if (hResults) CloseHandle(hResults);
+        return 1;
+    }
+
+    cout << "\n" << cWorkers << " workers at once; each makes the dictionary ready, reads all the entries\n"
+        << "and looks up " << kLookupsPerWorker << " headwords (medians and means per worker)\n\n";
+    cout << "                   ready ms   max ms   work ms   working set MB   private MB\n";
+    ModeSummary summaries[2];
+    static const char* const kModeNames[] = { "own dictionary", "attached image" };
+    bool fOk = true;
+    for (int m = kOwnDictionary; m <= kAttachedImage && fOk; ++m) {
+        ModeSummary& s = summaries[m];
+        fOk = RunWorkers(static_cast<WorkerMode>(m), cWorkers, pReports, s);
+        if (!fOk) {
+            cout << "A worker failed.\n";
+            break;
+        }
+        cout << "  " << std::left << setw(15) << kModeNames[m] << std::right
+            << setw(11) << s.readyMedian << setw(9) << s.readyMax << setw(10) << s.workMedian
+            << setw(17) << Megabytes(s.cbWorkingSet) << setw(13) << Megabytes(s.cbPrivate) << '\n';
+    }
+    UnmapViewOfFile(pReports);
+    CloseHandle(hResults);
+    if (!fOk) return 1;
+
+    const ModeSummary& own = summaries[kOwnDictionary];
+    const ModeSummary& attached = summaries[kAttachedImage];
+    if (!own.fSameChecksum || !attached.fSameChecksum || own.checksum != attached.checksum) {
+        cout << "warning: the workers did not all compute the same result\n";
+    }
+    double cbSaved = own.cbPrivate - attached.cbPrivate;
+    cout << "\nPrivate memory saved per worker: " << Megabytes(cbSaved) << " MB; for " << cWorkers
+        << " workers: " << Megabytes(cbSaved * cWorkers) << " MB, less the "
+        << Megabytes(static_cast<double>(image.Bytes())) << " MB image held once\n";
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Ordered headword lookups.
+//
+// Builds the headwords of the dictionary, repeated 1 and 100 times with
+// numbered copies (or the scales given on the command line), into a
+// SortedHeadwordIndex and into a plain sorted vector of spans, then compares
+// the lower bound searches of both: the Eytzinger index against
+// std::lower_bound. Half of the queries are headwords; the other half are
+// headwords with their last character changed, which mostly are not.
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdlib>  // for atoi
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using bench::BestTime;
+using bench::NextRandom;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kRuns = 3;
+const size_t kQueries = 2 * 1000 * 1000;
+
+typedef cedict::TextSpan<WCHAR> Span;
+
+// Spans over text, which holds the strings back to back; offsets has one
+// more element than there are strings.
+std::vector<Span> MakeSpans(const std::vector<WCHAR>& text, const std::vector<size_t>& offsets)
+{
+    std::vector<Span> spans;
+    spans.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        spans.push_back(cedict::MakeSpan(text.data() + offsets[i], text.data() + offsets[i + 1]));
+    }
+    return spans;
+}
+
+bool MeasureScale(const bench::DictionaryV4& dict, int scale)
+{
+    // The headwords, copy n > 0 with n appended.
+    std::vector<WCHAR> keyText;
+    std::vector<size_t> keyOffsets;
+    for (int n = 0; n < scale; ++n) {
+        std::wstring suffix = n > 0 ? std::to_wstring(n) : std::wstring();
+        for (int i = 0; i < dict.Length(); ++i) {
+            Span trad = bench::DictionaryV4::View(dict.Item(i).trad);
+            keyOffsets.push_back(keyText.size());
+            keyText.insert(keyText.end(), trad.pchBegin, trad.pchEnd);
+            keyText.insert(keyText.end(), suffix.begin(), suffix.end());
+        }
+    }
+    keyOffsets.push_back(keyText.size());
+    std::vector<Span> keys = MakeSpans(keyText, keyOffsets);
+
+    // The queries, in a buffer of their own.
+    std::vector<WCHAR> queryText;
+    std::vector<size_t> queryOffsets;
+    UINT32 state = 2463534242u;
+    for (size_t i = 0; i < kQueries; ++i) {
+        const Span& key = keys[NextRandom(state) % keys.size()];
+        queryOffsets.push_back(queryText.size());
+        queryText.insert(queryText.end(), key.pchBegin, key.pchEnd);
+        if (i % 2) queryText.back()++;
+    }
+    queryOffsets.push_back(queryText.size());
+    std::vector<Span> queries = MakeSpans(queryText, queryOffsets);
+
+    Stopwatch sw;
+    sw.Start();
+    std::vector<Span> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    sw.Stop();
+    double msSort = sw.ElapsedMilliseconds();
+
+    cedict::SortedHeadwordIndex<WCHAR> index;
+    sw.Start();
+    index.Build(keys);
+    sw.Stop();
+    double msBuild = sw.ElapsedMilliseconds();
+
+    // Both must find the same keys.
+    for (const Span& query : queries) {
+        auto i = std::lower_bound(sorted.begin(), sorted.end(), query);
+        size_t rank = index.LowerBound(query);
+        bool fEnd = i == sorted.end();
+        if (fEnd != (rank == index.Size()) || (!fEnd && *i != index.KeyAt(rank))) {
+            cout << "LowerBound() and std::lower_bound() differ.\n";
+            return false;
+        }
+    }
+
+    size_t checksum = 0;
+    double msLowerBound = BestTime(kRuns, [&]() {
+        for (const Span& query : queries) {
+            checksum += std::lower_bound(sorted.begin(), sorted.end(), query) - sorted.begin();
+        }
+    });
+    double msIndex = BestTime(kRuns, [&]() {
+        for (const Span& query : queries) {
+            checksum += index.LowerBound(query);
+        }
+    });
+
+    cout << "x" << std::left << setw(6) << scale << std::right
+        << setw(10) << keys.size()
+        << setw(12) << msSort << setw(12) << msBuild
+        << setw(16) << msLowerBound * 1e6 / kQueries
+        << setw(14) << msIndex * 1e6 / kQueries
+        << setw(10) << msLowerBound / msIndex << "x\n";
+    return checksum != 0;
+}
+
+} // namespace
+
+
+int bench::SortedIndexBenchmark(int argc, char* argv[])
+{
+    std::vector<int> scales;
+    for (int i = 0; i < argc; ++i) {
+        if (atoi(argv[i]) > 0) scales.push_back(atoi(argv[i]));
+    }
+    if (scales.empty()) {
+        scales.push_back(1);
+        scales.push_back(100);
+    }
+
+    DictionaryV4 dict(kDictionaryFile);
+    cout << std::fixed << std::setprecision(1);
+    cout << "Lower bound searches (V4 headwords, " << kQueries << " queries, best of "
+        << kRuns << " runs)\n\n";
+    cout << "Scale     Keys   Sort [ms]  Build [ms]  lower_bound [ns]  Eytzinger [ns]  Speedup\n";
+    for (int scale : scales) {
+        if (!MeasureScale(dict, scale)) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Storage width: UTF-8, UTF-16 and UTF-32 code units.
+//
+// Loads the dictionary with V4 (string pool) and with V2 (STL strings),
+// each storing char (UTF-8), char16_t (UTF-16) or char32_t (UTF-32) code
+// units through UtfTranscoder, next to the WCHAR variants of Windows, and
+// compares their load time, the code units of the entries and the memory
+// that Dictionary::MemoryUsage() reports. Every field of every entry is
+// decoded to code points and compared with those of the first variant: all
+// the variants must store the same text.
+//
+// WCHAR is UTF-16 on Windows; a port to Linux, where wchar_t is 4 bytes,
+// would store char16_t to keep that size, or char to keep the UTF-8 of the
+// file as it is.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <memory>
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using bench::AppendCodePoints;
+using bench::BestTime;
+using bench::Megabytes;
+
+
+namespace
+{
+
+const int kRuns = 5;
+
+struct WidthResult
+{
+    double bestTime;
+    size_t cEntries;
+    size_t cCodeUnits;
+    size_t cCharacters;
+    size_t cDifferentFields;    // from the reference
+    cedict::MemoryBreakdown memory;
+};
+
+// The code points of the fields of the first variant, four per entry.
+typedef std::vector<std::u32string> ReferenceFields;
+
+// Loads the variant; its fields are compared with reference, or make it
+// if it is empty.
+template <typename Dictionary>
+WidthResult MeasureVariant(ReferenceFields& reference)
+{
+    std::unique_ptr<Dictionary> dict;
+    WidthResult result = {};
+    result.bestTime = BestTime(kRuns, [&]() { dict.reset(); }, [&]() {
+        dict.reset(new Dictionary(bench::kDictionaryFile));
+    });
+
+    result.cEntries = dict->Length();
+    result.memory = dict->MemoryUsage();
+    const bool fReference = reference.empty();
+    std::u32string codePoints;
+    for (int i = 0; i < dict->Length(); ++i) {
+        const typename Dictionary::Entry& e = dict->Item(i);
+        const typename Dictionary::String* fields[] = { &e.trad, &e.simp, &e.pinyin, &e.english };
+        for (size_t f = 0; f < _countof(fields); ++f) {
+            auto view = Dictionary::View(*fields[f]);
+            codePoints.clear();
+            AppendCodePoints(view.pchBegin, view.pchEnd, codePoints);
+            result.cCodeUnits += view.Length();
+            result.cCharacters += codePoints.length();
+
+            size_t iField = _countof(fields) * i + f;
+            if (fReference) {
+                reference.push_back(codePoints);
+            } else if (iField >= reference.size() || codePoints != reference[iField]) {
+                result.cDifferentFields++;
+            }
+        }
+    }
+    return result;
+}
+
+template <typename Dictionary>
+WidthResult PrintVariant(const char* pszName, const char* pszUnit, ReferenceFields& reference)
+{
+    WidthResult r = MeasureVariant<Dictionary>(reference);
+    cout << "  " << std::left << setw(6) << pszName << setw(10) << pszUnit << std::right
+        << setw(5) << sizeof(typename Dictionary::CharType)
+        << setw(11) << r.bestTime
+        << setw(13) << r.cCodeUnits
+        << setw(12) << Megabytes(static_cast<double>(r.memory.cbStrings))
+        << setw(12) << Megabytes(static_cast<double>(r.memory.Total()))
+        << setw(10) << static_cast<double>(r.memory.Total()) / (r.cEntries ? r.cEntries : 1) << '\n';
+    return r;
+}
+
+} // namespace
+
+
+int bench::StorageWidthBenchmark(int, char*[])
+{
+    cout << std::fixed << std::setprecision(1);
+    cout << "Storage width: code units of each size (best of " << kRuns << " loads)\n\n";
+    cout << "  Name  Unit      Size  Time [ms]   Code units  Strings MB    Total MB   B/entry\n";
+
+    ReferenceFields reference;
+    WidthResult results[] = {
+        PrintVariant<DictionaryV4Width<char>>("V4", "UTF-8", reference),
+        PrintVariant<DictionaryV4Width<char16_t>>("V4", "UTF-16", reference),
+        PrintVariant<DictionaryV4Width<char32_t>>("V4", "UTF-32", reference),
+        PrintVariant<DictionaryV4>("V4", "WCHAR", reference),
+        PrintVariant<DictionaryV2Width<char>>("V2", "UTF-8", reference),
+        PrintVariant<DictionaryV2Width<char16_t>>("V2", "UTF-16", reference),
+        PrintVariant<DictionaryV2Width<char32_t>>("V2", "UTF-32", reference),
+        PrintVariant<DictionaryV2>("V2", "WCHAR", reference),
+    };
+
+    for (const WidthResult& r : results) {
+        if (r.cEntries != results[0].cEntries || r.cDifferentFields != 0) {
+            cout << "\nwarning: the variants do not all store the same " << results[0].cEntries
+                << " entries of " << results[0].cCharacters << " characters\n";
+            return 1;
+        }
+    }
+    cout << "\nAll the variants store " << results[0].cEntries << " entries of "
+        << results[0].cCharacters << " characters.\n";
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Background teardown.
+//
+// Measures what destroying a loaded dictionary costs the thread that drops
+// it: first destroying it in place, as the LoadDictionary programs do when
+// the dictionary goes out of scope, then retiring it to a
+// BackgroundReclaimer, which destroys it on its own thread.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <memory>
+#include "BackgroundReclaimer.h"
+#include "Benchmarks.h"
+#include "Stopwatch.h"
+#include "Variants.h"
+
+using std::cout;
+using std::setw;
+using win32::Stopwatch;
+
+
+namespace
+{
+
+const int kRuns = 5;
+
+template <typename Dictionary>
+void MeasureVariant(const char* pszName, cedict::BackgroundReclaimer& reclaimer)
+{
+    double bestInPlace = 0;
+    double bestRetire = 0;
+    double bestBackground = 0;
+    for (int run = 0; run < kRuns; ++run) {
+        Stopwatch sw;
+
+        std::unique_ptr<Dictionary> dict(new Dictionary(bench::kDictionaryFile));
+        sw.Start();
+        dict.reset();
+        sw.Stop();
+        double inPlace = sw.ElapsedMilliseconds();
+
+        dict.reset(new Dictionary(bench::kDictionaryFile));
+        sw.Start();
+        reclaimer.Retire(std::move(dict));
+        sw.Stop();
+        double retire = sw.ElapsedMilliseconds();
+
+        // Time until the reclaimer is done, i.e. what it took off the caller.
+        sw.Start();
+        reclaimer.WaitIdle();
+        sw.Stop();
+        double background = sw.ElapsedMilliseconds();
+
+        if (run == 0 || inPlace < bestInPlace) bestInPlace = inPlace;
+        if (run == 0 || retire < bestRetire) bestRetire = retire;
+        if (run == 0 || background < bestBackground) bestBackground = background;
+    }
+
+    cout << std::left << setw(8) << pszName
+        << std::right << std::fixed << std::setprecision(3)
+        << setw(16) << bestInPlace
+        << setw(16) << bestRetire
+        << setw(18) << bestBackground << '\n';
+}
+
+} // namespace
+
+
+int bench::TeardownBenchmark(int, char*[])
+{
+    cedict::BackgroundReclaimer reclaimer;
+
+    cout << "Dictionary teardown cost on the calling thread (best of " << kRuns << " runs)\n\n";
+    cout << "Variant  In place [ms]   Retire [ms]   Background [ms]\n";
+
+    MeasureVariant<DictionaryV1>("V1", reclaimer);
+    MeasureVariant<DictionaryV2>("V2", reclaimer);
+    MeasureVariant<DictionaryV2A>("V2A", reclaimer);
+    MeasureVariant<DictionaryV3>("V3", reclaimer);
+    MeasureVariant<DictionaryV4>("V4", reclaimer);
+    return 0;
+}
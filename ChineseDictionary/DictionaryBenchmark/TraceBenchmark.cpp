@@ -0,0 +1,117 @@
+// Timeline trace of the loader phases.
+//
+// Measures the cost of tracing on a V4 load (Tracer stopped vs. started),
+// then traces a session that exercises the threads of the project: a load
+// with all the structures built after it by the task workers (see
+// TaskScheduler.h), the NUMA replicas, V3 and V4
+// loaded at the same time on two threads, and the destruction of all of
+// them by the BackgroundReclaimer. The trace is written in the Chrome trace
+// event format (cedict-trace.json, or the file given on the command line),
+// for chrome://tracing or https://ui.perfetto.dev.
+
+#include <windows.h>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <memory>
+#include <thread>
+#include "BackgroundReclaimer.h"
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "LoadTrace.h"
+#include "NumaReplicas.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::BestTime;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const char kDefaultTraceFile[] = "cedict-trace.json";
+
+// Each run starts a new trace, so the events of the last one are left.
+double BestLoadTime(bool fTrace)
+{
+    double bestTime = BestTime(kRuns, [fTrace]() {
+        if (fTrace) cedict::Tracer::Start();
+    }, []() {
+        bench::DictionaryV4 dict(bench::kDictionaryFile);
+    });
+    cedict::Tracer::Stop();
+    return bestTime;
+}
+
+// Loads a Dictionary on a thread of its own, named pszThreadName.
+template <typename Dictionary>
+std::thread LoadOnThread(const char* pszThreadName, std::unique_ptr<Dictionary>& p)
+{
+    return std::thread([pszThreadName, &p]() {
+        cedict::Tracer::SetThreadName(pszThreadName);
+        p.reset(new Dictionary(bench::kDictionaryFile));
+    });
+}
+
+} // namespace
+
+
+int bench::TraceBenchmark(int argc, char* argv[])
+{
+    const char* pszTraceFile = argc > 0 ? argv[0] : kDefaultTraceFile;
+    cedict::Tracer::SetThreadName("main");
+
+    double msPlain = BestLoadTime(false);
+    double msTraced = BestLoadTime(true);
+    size_t cLoadEvents = cedict::Tracer::EventCount();
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "Tracing cost (V4 load, best of " << kRuns << " runs)\n\n";
+    cout << "  Tracer stopped: " << std::setw(8) << msPlain << " ms\n";
+    cout << "  Tracer started: " << std::setw(8) << msTraced << " ms, " << cLoadEvents
+        << " events, " << (msTraced - msPlain) * 1e6 / (cLoadEvents ? cLoadEvents : 1)
+        << " ns per event\n\n";
+
+    cedict::Tracer::Start();
+    {
+        cedict::BackgroundReclaimer reclaimer;
+
+        cedict::DictionaryOptions options;
+        options.buildIndex = true;
+        options.headwordFilter = true;
+        options.buildSortedIndex = true;
+        options.buildSortedPinyinIndex = true;
+        options.buildScriptConverters = true;
+        options.buildFieldIndexes = true;
+        options.buildFuzzyGlossIndex = true;
+        options.buildFuzzyPinyinIndex = true;
+        options.buildCrossReferences = true;
+        options.buildThreads = 0;
+        std::unique_ptr<DictionaryV4> full(new DictionaryV4(kDictionaryFile, options));
+
+        std::unique_ptr<cedict::NumaReplicatedDictionary<DictionaryV4>> replicas(
+            new cedict::NumaReplicatedDictionary<DictionaryV4>(kDictionaryFile, options));
+
+        std::unique_ptr<DictionaryV3> v3;
+        std::unique_ptr<DictionaryV4> v4;
+        std::thread loader3 = LoadOnThread("V3 loader", v3);
+        std::thread loader4 = LoadOnThread("V4 loader", v4);
+        loader3.join();
+        loader4.join();
+
+        reclaimer.Retire(std::move(full));
+        reclaimer.Retire(std::move(replicas));
+        reclaimer.Retire(std::move(v3));
+        reclaimer.Retire(std::move(v4));
+        reclaimer.WaitIdle();
+    }
+    cedict::Tracer::Stop();
+
+    if (!cedict::Tracer::WriteChromeTrace(pszTraceFile)) {
+        cout << "Cannot write " << pszTraceFile << ".\n";
+        return 1;
+    }
+    cout << "Session trace: " << cedict::Tracer::EventCount() << " events ("
+        << cedict::Tracer::DroppedCount() << " dropped) written to " << pszTraceFile << '\n';
+    return 0;
+}
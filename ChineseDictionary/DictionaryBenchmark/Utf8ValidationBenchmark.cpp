@@ -0,0 +1,154 @@
+// UTF-8 validation.
+//
+// Measures the throughput of the SSSE3 validator over the whole dictionary
+// file, against the scalar validator and a separate MultiByteToWideChar pass
+// with MB_ERR_INVALID_CHARS, and the load time with and without
+// DictionaryOptions::validateUtf8. Then corrupts some lines of a copy of the
+// file, and checks that the loader reports exactly those lines, with and
+// without the validation pass.
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdio>   // for std::remove
+#include <fstream>
+#include <iomanip>
+#include <iostream> // for cin/cout
+#include <set>
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "MappedTextFile.h"
+#include "Utf8Validation.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::BestTime;
+using bench::NextRandom;
+
+
+namespace
+{
+
+const int kRuns = 5;
+const int kCorruptLines = 25;
+const char kCorruptFile[] = "cedict-corrupt.u8";
+
+void PrintThroughput(const char* pszName, double ms, size_t cb)
+{
+    cout << "  " << std::left << std::setw(28) << pszName << std::right
+        << std::setw(8) << ms << " ms" << std::setw(10) << cb / ms / 1e6 << " GB/s\n";
+}
+
+// Writes a copy of text with a 0xFF byte (never valid in UTF-8) in the
+// middle of kCorruptLines random entry lines. Returns their offsets.
+std::set<size_t> WriteCorruptCopy(const CHAR* pch, size_t cb)
+{
+    std::vector<size_t> lineOffsets;
+    for (size_t ib = 0; ib < cb; ) {
+        const CHAR* pchEOL = std::find(pch + ib, pch + cb, '\n');
+        if (pch[ib] != '#' && pchEOL - (pch + ib) > 2) lineOffsets.push_back(ib);
+        ib = (pchEOL - pch) + 1;
+    }
+
+    std::string text(pch, cb);
+    std::set<size_t> corrupted;
+    UINT32 state = 2463534242u;
+    while (corrupted.size() < static_cast<size_t>(kCorruptLines)
+            && corrupted.size() < lineOffsets.size()) {
+        size_t ib = lineOffsets[NextRandom(state) % lineOffsets.size()];
+        if (!corrupted.insert(ib).second) continue;
+        size_t cbLine = std::find(pch + ib, pch + cb, '\n') - (pch + ib);
+        text[ib + cbLine / 2] = static_cast<char>(0xFF);
+    }
+
+    std::ofstream out(kCorruptFile, std::ios::out | std::ios::binary);
+    out.write(text.data(), text.size());
+    return corrupted;
+}
+
+bool CheckReported(const char* pszMode, const bench::DictionaryV4& dict,
+    const std::set<size_t>& corrupted)
+{
+    const cedict::LoadStatistics& stats = dict.Statistics();
+    std::set<size_t> reported;
+    for (const cedict::MalformedLine& line : dict.MalformedLines()) {
+        if (line.reason == cedict::MalformedLine::InvalidUtf8) reported.insert(line.ibOffset);
+    }
+
+    cout << "  " << std::left << std::setw(18) << pszMode << std::right
+        << std::setw(8) << dict.Length() << " entries, "
+        << stats.cInvalidUtf8Lines << " invalid UTF-8 lines, "
+        << stats.cUnparsableLines << " unparsable lines"
+        << (stats.fRejected ? ", rejected" : "") << '\n';
+    if (!dict.MalformedLines().empty()) {
+        const cedict::MalformedLine& first = dict.MalformedLines().front();
+        cout << "  " << std::setw(18) << "" << "first: line " << first.iLine
+            << ", offset " << first.ibOffset << '\n';
+    }
+    if (reported != corrupted) {
+        cout << "  The reported lines do not match the corrupted ones.\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+
+int bench::Utf8ValidationBenchmark(int, char*[])
+{
+    cedict::MappedTextFile mtf(kDictionaryFile);
+    const CHAR* pch = mtf.Buffer();
+    const size_t cb = mtf.Length();
+    if (!pch) {
+        cout << "Cannot open the dictionary file.\n";
+        return 1;
+    }
+
+    cout << std::fixed << std::setprecision(2);
+    cout << "UTF-8 validation of " << cb / 1024 << " KB (best of " << kRuns << " runs)\n\n";
+
+    bool fValid = true;
+    double msSimd = BestTime(kRuns, [&]() {
+        fValid = cedict::ValidateUtf8Lines(pch, cb, [](const CHAR*, const CHAR*) {});
+    });
+    double msScalar = BestTime(kRuns, [&]() {
+        fValid = fValid && cedict::FindInvalidUtf8(pch, pch + cb) == pch + cb;
+    });
+    std::vector<WCHAR> buf(cb);
+    double msWin32 = BestTime(kRuns, [&]() {
+        int cch = static_cast<int>(cb);
+        fValid = fValid && MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS,
+            pch, cch, buf.data(), cch) != 0;
+    });
+    PrintThroughput(cedict::detail::CpuHasSsse3() ? "SSSE3 validator" : "Validator (no SSSE3)",
+        msSimd, cb);
+    PrintThroughput("Scalar validator", msScalar, cb);
+    PrintThroughput("MultiByteToWideChar pass", msWin32, cb);
+    cout << "  The file is " << (fValid ? "valid" : "NOT valid") << " UTF-8\n\n";
+
+    cedict::DictionaryOptions validateOptions;
+    validateOptions.validateUtf8 = true;
+    double msLoad = BestTime(kRuns, []() { DictionaryV4 dict(kDictionaryFile); });
+    double msLoadValidate = BestTime(kRuns, [&]() {
+        DictionaryV4 dict(kDictionaryFile, validateOptions);
+    });
+    cout << "Load time (V4)\n";
+    cout << "  default:      " << msLoad << " ms\n";
+    cout << "  validateUtf8: " << msLoadValidate << " ms\n\n";
+
+    std::set<size_t> corrupted = WriteCorruptCopy(pch, cb);
+    bool fOk;
+    cout << "Copy with " << corrupted.size() << " corrupted lines\n";
+    {
+        DictionaryV4 dict(TEXT("cedict-corrupt.u8"));
+        fOk = CheckReported("default", dict, corrupted);
+    }
+    {
+        DictionaryV4 dict(TEXT("cedict-corrupt.u8"), validateOptions);
+        fOk = CheckReported("validateUtf8", dict, corrupted) && fOk;
+    }
+    std::remove(kCorruptFile);
+    return fOk ? 0 : 1;
+}
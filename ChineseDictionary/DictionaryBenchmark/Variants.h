@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Variants.h -- The loader variants compared by the benchmarks, i.e. the
+//               policies picked by the LoadDictionary programs.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <windows.h>
+#include "Dictionary.h"
+#include "InputPolicies.h"
+#include "TranscodePolicies.h"
+#include "StoragePolicies.h"
+#include "AtlStringStorage.h"
+
+
+namespace bench
+{
+
+
+// Dictionary file loaded by default; like the LoadDictionary programs,
+// it is expected in the current directory.
+const LPCTSTR kDictionaryFile = TEXT("cedict.u8");
+
+// V1: C++ standard I/O streams, codecvt and STL wstring.
+typedef cedict::Dictionary<
+    cedict::StreamInput, cedict::CodecvtTranscoder, cedict::WStringStorage
+> DictionaryV1;
+
+// V2: memory mapped files, MultiByteToWideChar and STL wstring.
+typedef cedict::Dictionary<
+    cedict::MappedFileInput, cedict::Win32Transcoder, cedict::WStringStorage
+> DictionaryV2;
+
+// V2A: memory mapped files, MultiByteToWideChar and ATL CStringW.
+typedef cedict::Dictionary<
+    cedict::MappedFileInput, cedict::Win32Transcoder, cedict::CStringStorage
+> DictionaryV2A;
+
+// V3: memory mapped files, MultiByteToWideChar and raw C-style strings.
+typedef cedict::Dictionary<
+    cedict::MappedFileInput, cedict::Win32Transcoder, cedict::RawStringStorage
+> DictionaryV3;
+
+// V4: memory mapped files, MultiByteToWideChar and custom pool string allocator.
+typedef cedict::Dictionary<
+    cedict::MappedFileInput, cedict::Win32Transcoder, cedict::PoolStringStorage
+> DictionaryV4;
+
+// V4 storing UTF-8, UTF-16 or UTF-32 code units instead of WCHAR, as a port
+// beyond Windows would (see UtfTranscoder).
+template <typename Char>
+using DictionaryV4Width = cedict::Dictionary<
+    cedict::MappedFileInput, cedict::UtfTranscoder<Char>, cedict::BasicPoolStringStorage<Char>
+>;
+
+// The same with STL strings of each width, as V2.
+template <typename Char>
+using DictionaryV2Width = cedict::Dictionary<
+    cedict::MappedFileInput, cedict::UtfTranscoder<Char>, cedict::BasicStringStorage<Char>
+>;
+
+
+} // namespace bench
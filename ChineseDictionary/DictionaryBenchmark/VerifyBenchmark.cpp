@@ -0,0 +1,319 @@
+// Differential check of the loader variants.
+//
+// Loads the same file through every variant (and V4 with the options that
+// change how the entries are stored, and an EntryReader, which reads them
+// without loading), turns the entries into code points, whatever the width
+// of their storage, and compares them field by field with those of V1, as
+// well as the lines that each variant skipped. A faster variant that does
+// not load exactly what V1 loads is a bug: the driver runs this check on
+// the dictionary file before any benchmark (see DictionaryBenchmark.cpp).
+//
+// The benchmark also checks fuzzed files, made of lines of the dictionary
+// (or of a few built-in lines without it) with random damage: truncation,
+// stray separators, carriage returns, null characters and invalid, overlong
+// or surrogate UTF-8 sequences.
+
+#include <windows.h>
+#include <algorithm>
+#include <cstdio>   // for std::remove
+#include <cstdlib>  // for atoi
+#include <fstream>
+#include <iostream> // for cin/cout
+#include <string>
+#include <vector>
+#include "BenchmarkHelpers.h"
+#include "Benchmarks.h"
+#include "EntryReader.h"
+#include "MappedTextFile.h"
+#include "Variants.h"
+
+using std::cout;
+using bench::AppendCodePoints;
+using bench::NextRandom;
+
+
+namespace
+{
+
+const int kDefaultFuzzFiles = 500;
+const size_t kFuzzLines = 64;
+const size_t kSeedLines = 4096;
+const size_t kMaxReported = 5;
+const char kFuzzFile[] = "cedict-fuzz.u8";
+
+// The entries of a dictionary, as the dictionary and its variant no longer
+// matter: the code points of four fields per entry, in file order.
+struct LoadedEntries
+{
+    std::vector<std::u32string> fields;
+    std::vector<cedict::MalformedLine> malformed;
+};
+
+const char* const kFieldNames[] = { "traditional", "simplified", "pinyin", "English" };
+const char* const kReasonNames[] = { "invalid UTF-8", "unparsable" };
+
+enum VariantOptions
+{
+    kDefaultOptions = 0,
+    kPresize = 1,
+    kCompressGlosses = 2,
+    kLargePages = 4,
+};
+
+template <typename Dictionary, int options>
+LoadedEntries Load(LPCTSTR pszFile)
+{
+    cedict::DictionaryOptions dictOptions;
+    dictOptions.presize = (options & kPresize) != 0;
+    dictOptions.compressGlosses = (options & kCompressGlosses) != 0;
+    dictOptions.largePages = (options & kLargePages) != 0;
+    Dictionary dict(pszFile, dictOptions);
+
+    typedef typename Dictionary::CharType Char;
+    LoadedEntries loaded;
+    std::vector<Char> buf(dict.EnglishBufferLength());
+    loaded.fields.reserve(4 * dict.Length());
+    for (int i = 0; i < dict.Length(); ++i) {
+        const typename Dictionary::Entry& e = dict.Item(i);
+        cedict::TextSpan<Char> fields[] = {
+            Dictionary::View(e.trad),
+            Dictionary::View(e.simp),
+            Dictionary::View(e.pinyin),
+            dict.English(i, buf.data()),
+        };
+        for (const cedict::TextSpan<Char>& field : fields) {
+            loaded.fields.push_back(std::u32string());
+            AppendCodePoints(field.pchBegin, field.pchEnd, loaded.fields.back());
+        }
+    }
+    loaded.malformed = dict.MalformedLines();
+    return loaded;
+}
+
+// The entries that an EntryReader reads, with the parsing of the loader but
+// nothing stored.
+LoadedEntries Read(LPCTSTR pszFile)
+{
+    LoadedEntries loaded;
+    cedict::EntryReader<> reader(pszFile);
+    for (const auto& entry : reader) {
+        cedict::TextSpan<WCHAR> fields[] = { entry.trad, entry.simp, entry.pinyin, entry.english };
+        for (const cedict::TextSpan<WCHAR>& field : fields) {
+            loaded.fields.push_back(std::u32string());
+            AppendCodePoints(field.pchBegin, field.pchEnd, loaded.fields.back());
+        }
+    }
+    loaded.malformed = reader.MalformedLines();
+    return loaded;
+}
+
+struct VariantInfo
+{
+    const char* name;
+    LoadedEntries (*load)(LPCTSTR pszFile);
+};
+
+// The first one is the reference.
+const VariantInfo g_variants[] = {
+    { "V1", Load<bench::DictionaryV1, kDefaultOptions> },
+    { "V2", Load<bench::DictionaryV2, kDefaultOptions> },
+    { "V2A", Load<bench::DictionaryV2A, kDefaultOptions> },
+    { "V3", Load<bench::DictionaryV3, kDefaultOptions> },
+    { "V4", Load<bench::DictionaryV4, kDefaultOptions> },
+    { "V4 presize", Load<bench::DictionaryV4, kPresize> },
+    { "V4 compressed glosses", Load<bench::DictionaryV4, kCompressGlosses> },
+    { "V4 large pages", Load<bench::DictionaryV4, kLargePages> },
+    { "V4 UTF-8", Load<bench::DictionaryV4Width<char>, kDefaultOptions> },
+    { "V4 UTF-16", Load<bench::DictionaryV4Width<char16_t>, kDefaultOptions> },
+    { "EntryReader", Read },
+};
+
+// Printable form of a field: non-ASCII and control characters as \uXXXX,
+// or \UXXXXXXXX above the BMP.
+std::string Escape(const std::u32string& s)
+{
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string escaped;
+    for (char32_t ch : s) {
+        if (ch >= 0x20 && ch < 0x7F) {
+            escaped += static_cast<char>(ch);
+        } else {
+            escaped += ch > 0xFFFF ? "\\U" : "\\u";
+            for (int shift = ch > 0xFFFF ? 28 : 12; shift >= 0; shift -= 4) escaped += kHex[(ch >> shift) & 0xF];
+        }
+    }
+    return escaped;
+}
+
+// Number of differences between the reference and the variant; the first
+// kMaxReported are printed.
+size_t Compare(const LoadedEntries& reference, const LoadedEntries& loaded, const char* pszName)
+{
+    size_t cDifferences = 0;
+    auto report = [&]() -> bool {
+        if (cDifferences++ == 0) cout << "  " << pszName << " differs from " << g_variants[0].name << ":\n";
+        return cDifferences <= kMaxReported;
+    };
+
+    if (loaded.fields.size() != reference.fields.size() && report()) {
+        cout << "    " << loaded.fields.size() / 4 << " entries instead of "
+            << reference.fields.size() / 4 << '\n';
+    }
+    size_t cFields = (std::min)(loaded.fields.size(), reference.fields.size());
+    for (size_t i = 0; i < cFields; ++i) {
+        if (loaded.fields[i] != reference.fields[i] && report()) {
+            cout << "    entry " << i / 4 << ", " << kFieldNames[i % 4] << ": \""
+                << Escape(loaded.fields[i]) << "\" instead of \"" << Escape(reference.fields[i]) << "\"\n";
+        }
+    }
+
+    if (loaded.malformed.size() != reference.malformed.size() && report()) {
+        cout << "    " << loaded.malformed.size() << " lines skipped instead of "
+            << reference.malformed.size() << '\n';
+    }
+    size_t cMalformed = (std::min)(loaded.malformed.size(), reference.malformed.size());
+    for (size_t i = 0; i < cMalformed; ++i) {
+        const cedict::MalformedLine& a = loaded.malformed[i];
+        const cedict::MalformedLine& b = reference.malformed[i];
+        if ((a.iLine != b.iLine || a.ibOffset != b.ibOffset || a.reason != b.reason) && report()) {
+            cout << "    skipped line " << a.iLine << " (" << kReasonNames[a.reason] << ") instead of line "
+                << b.iLine << " (" << kReasonNames[b.reason] << ")\n";
+        }
+    }
+    return cDifferences;
+}
+
+// Loads the file with every variant; returns the number of variants that
+// do not load what the reference loads.
+size_t CheckFile(LPCTSTR pszFile, size_t* pcEntries)
+{
+    LoadedEntries reference = g_variants[0].load(pszFile);
+    *pcEntries = reference.fields.size() / 4;
+    size_t cDiverging = 0;
+    for (size_t i = 1; i < _countof(g_variants); ++i) {
+        if (Compare(reference, g_variants[i].load(pszFile), g_variants[i].name) != 0) cDiverging++;
+    }
+    return cDiverging;
+}
+
+// Lines to damage: entry lines of the dictionary file, or a few built-in
+// ones if it cannot be read.
+std::vector<std::string> SeedLines()
+{
+    std::vector<std::string> lines;
+    cedict::MappedTextFile mtf(bench::kDictionaryFile);
+    const CHAR* pch = mtf.Buffer();
+    const CHAR* pchEnd = pch ? pch + mtf.Length() : pch;
+    while (pch < pchEnd && lines.size() < kSeedLines) {
+        const CHAR* pchEOL = std::find(pch, pchEnd, '\n');
+        if (pch < pchEOL && *pch != '#') lines.push_back(std::string(pch, pchEOL));
+        pch = pchEOL + 1;
+    }
+    if (lines.empty()) {
+        lines.push_back("\xE4\xB8\xAD\xE5\x9C\x8B \xE4\xB8\xAD\xE5\x9B\xBD [Zhong1 guo2] /China/");
+        lines.push_back("\xE4\xBD\xA0\xE5\xA5\xBD \xE4\xBD\xA0\xE5\xA5\xBD [ni3 hao3] /hello/hi/");
+        lines.push_back("\xE5\xAD\x97 \xE5\xAD\x97 [zi4] /letter/symbol/character/word/CL:\xE4\xB8\xAA[ge4]/");
+        lines.push_back("A\xE8\x82\xA1 A\xE8\x82\xA1 [A gu3] /A-share (PRC)/");
+    }
+    return lines;
+}
+
+void Damage(std::string& line, UINT32& state)
+{
+    // Bytes that matter to the parser or to the transcoders: separators,
+    // control characters, continuation bytes and invalid lead bytes.
+    static const char kBytes[] = { ' ', '[', ']', '/', '#', '\r', '\0', '\t',
+        '\x80', '\xBF', '\xC0', '\xC2', '\xE0', '\xED', '\xF0', '\xF4', '\xF8', '\xFF' };
+    // Invalid sequences: encoded surrogates (CESU-8), overlong forms, code
+    // points above U+10FFFF; and a valid 4-byte one (U+20000, a surrogate
+    // pair in UTF-16).
+    static const char* const kSequences[] = { "\xED\xA0\x80", "\xED\xBF\xBF", "\xC0\xAF",
+        "\xE0\x80\xAF", "\xF4\x90\x80\x80", "\xF0\xA0\x80\x80" };
+
+    size_t ich = line.empty() ? 0 : NextRandom(state) % (line.size() + 1);
+    switch (NextRandom(state) % 8) {
+    case 0:
+        line.resize(ich);
+        break;
+    case 1:
+        if (ich < line.size()) line.erase(ich, 1);
+        break;
+    case 2:
+    case 3:
+        line.insert(ich, 1, kBytes[NextRandom(state) % _countof(kBytes)]);
+        break;
+    case 4:
+        line.insert(ich, kSequences[NextRandom(state) % _countof(kSequences)]);
+        break;
+    case 5:
+        line.insert(ich, line.substr(ich, NextRandom(state) % 16));
+        break;
+    case 6:
+        line += '\r';
+        break;
+    default:
+        line.assign(NextRandom(state) % 2 ? "" : "   ");
+        break;
+    }
+}
+
+bool WriteFuzzFile(const std::vector<std::string>& seeds, UINT32& state)
+{
+    std::ofstream out(kFuzzFile, std::ios::out | std::ios::binary);
+    for (size_t i = 0; i < kFuzzLines; ++i) {
+        std::string line = seeds[NextRandom(state) % seeds.size()];
+        if (NextRandom(state) % 3 == 0) {
+            for (UINT32 c = 1 + NextRandom(state) % 3; c > 0; --c) Damage(line, state);
+        }
+        out << line;
+        // The last line may have no end of line.
+        if (i + 1 < kFuzzLines || NextRandom(state) % 2) out << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+
+bool bench::VerifyVariants()
+{
+    size_t cEntries = 0;
+    if (CheckFile(kDictionaryFile, &cEntries) == 0) return true;
+    cout << "The loader variants do not load the same entries.\n";
+    return false;
+}
+
+int bench::VerifyBenchmark(int argc, char* argv[])
+{
+    int cFuzzFiles = argc > 0 ? atoi(argv[0]) : kDefaultFuzzFiles;
+    if (cFuzzFiles < 0) cFuzzFiles = kDefaultFuzzFiles;
+
+    cout << "Loading with " << _countof(g_variants) << " variants, compared with "
+        << g_variants[0].name << "\n\n";
+    size_t cEntries = 0;
+    size_t cDiverging = CheckFile(kDictionaryFile, &cEntries);
+    cout << "Dictionary file: " << cEntries << " entries, "
+        << (cDiverging ? "variants differ" : "all variants agree") << "\n\n";
+
+    std::vector<std::string> seeds = SeedLines();
+    UINT32 state = 2463534242u;
+    size_t cFailedFiles = 0;
+    size_t cFuzzEntries = 0;
+    for (int i = 0; i < cFuzzFiles; ++i) {
+        if (!WriteFuzzFile(seeds, state)) {
+            cout << "Cannot write the fuzzed file.\n";
+            return 1;
+        }
+        size_t cFileEntries = 0;
+        size_t c = CheckFile(TEXT("cedict-fuzz.u8"), &cFileEntries);
+        cFuzzEntries += cFileEntries;
+        if (c != 0) {
+            cout << "  (in fuzzed file " << i << ")\n";
+            cFailedFiles++;
+        }
+    }
+    std::remove(kFuzzFile);
+    cout << "Fuzzed files: " << cFuzzFiles << " of " << kFuzzLines << " lines, " << cFuzzEntries
+        << " entries loaded, " << cFailedFiles << " with differences\n";
+    return cDiverging == 0 && cFailedFiles == 0 ? 0 : 1;
+}
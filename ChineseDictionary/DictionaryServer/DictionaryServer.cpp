@@ -0,0 +1,223 @@
+// Dictionary server - Loads the dictionary once and answers the lookups of
+// other processes over a local named pipe
+//
+// Workers that embed the dictionary each pay its load time and its memory;
+// with the server, they send it their lookups instead (see the "client"
+// benchmark of DictionaryBenchmark). The protocol is in
+// Common\LookupProtocol.h: lookups by traditional or simplified headword,
+// by pinyin or by English gloss.
+//
+// Each connection is served by a thread of its own. The thread reads
+// whatever the client has written so far, answers all the complete requests
+// in it as one batch, and writes all the responses at once: a client that
+// pipelines its requests pays one read and one write per batch rather than
+// per request, and the traditional headword lookups of a batch go through
+// Dictionary::FindBatch, which overlaps their cache misses.
+//
+// Like the LoadDictionary programs, it expects the dictionary file in the
+// current directory. It runs until it is stopped with Ctrl+C.
+
+#include <windows.h>
+#include <cstring>  // for memmove
+#include <functional> // for std::cref
+#include <iostream> // for cin/cout
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Dictionary.h"
+#include "InputPolicies.h"
+#include "LookupProtocol.h"
+#include "Stopwatch.h"
+#include "StoragePolicies.h"
+#include "TranscodePolicies.h"
+
+using std::cout;
+using std::vector;
+using win32::Stopwatch;
+
+typedef cedict::Dictionary<
+    cedict::MappedFileInput,
+    cedict::Win32Transcoder,
+    cedict::PoolStringStorage
+> Dictionary;
+
+typedef cedict::TextSpan<WCHAR> Key;
+
+
+namespace
+{
+
+const DWORD kPipeBufferSize = 64 * 1024;
+
+std::mutex g_coutMutex;
+
+// Buffers of a connection, reused from one batch to the next.
+struct Batch
+{
+    vector<cedict::RequestHeader> requests;
+    vector<Key> keys;
+    vector<Key> tradKeys;           // the keys of the traditional lookups...
+    vector<UINT32> tradIds;         // ... and the first entry of each
+    vector<WCHAR> englishBuf;       // for compressed glosses
+    vector<BYTE> out;
+};
+
+void AddEntries(const Dictionary& dict, cedict::ResponseWriter& response, UINT32 id,
+    const cedict::FieldIndex<WCHAR>* pIndex, Batch& batch)
+{
+    for (size_t c = 0; id != cedict::kNoEntry && c < cedict::kMaxEntriesPerResponse; ++c) {
+        UINT32 iEntry = pIndex ? pIndex->EntryId(id) : id;
+        const Dictionary::Entry& e = dict.Item(iEntry);
+        response.AddEntry(Dictionary::View(e.trad), Dictionary::View(e.simp),
+            Dictionary::View(e.pinyin), dict.English(iEntry, batch.englishBuf.data()));
+        id = pIndex ? pIndex->Next(id) : dict.Index().Next(id);
+    }
+}
+
+size_t CountMatches(const Dictionary& dict, UINT32 id, const cedict::FieldIndex<WCHAR>* pIndex)
+{
+    size_t c = 0;
+    for (; id != cedict::kNoEntry; id = pIndex ? pIndex->Next(id) : dict.Index().Next(id)) c++;
+    return c;
+}
+
+// Answers the complete requests in [pb, pb + cb) into batch.out. Returns
+// the bytes of requests answered, or -1 on a request that breaks the
+// protocol.
+size_t AnswerBatch(const Dictionary& dict, const BYTE* pb, size_t cb, Batch& batch)
+{
+    batch.requests.clear();
+    batch.keys.clear();
+    batch.tradKeys.clear();
+    size_t cbUsed = 0;
+    while (cb - cbUsed >= sizeof(cedict::RequestHeader)) {
+        // Check the length first: the buffer could not hold a longer key.
+        Key key;
+        cedict::RequestHeader request = cedict::ReadRequest(pb + cbUsed, key);
+        if (request.cchKey > cedict::kMaxKeyLength) return static_cast<size_t>(-1);
+        size_t cbRequest = cedict::RequestSize(pb + cbUsed, cb - cbUsed);
+        if (cbRequest == 0) break;
+        batch.requests.push_back(request);
+        batch.keys.push_back(key);
+        if (request.field == cedict::kLookupTraditional) batch.tradKeys.push_back(key);
+        cbUsed += cbRequest;
+    }
+
+    batch.tradIds.resize(batch.tradKeys.size());
+    dict.FindBatch(batch.tradKeys.data(), batch.tradKeys.size(), batch.tradIds.data());
+
+    const cedict::FieldIndex<WCHAR>* indexes[cedict::kLookupFieldCount] = {
+        nullptr, &dict.SimplifiedIndex(), &dict.PinyinIndex(), &dict.EnglishIndex()
+    };
+    batch.out.clear();
+    size_t iTrad = 0;
+    for (size_t i = 0; i < batch.requests.size(); ++i) {
+        UINT8 field = batch.requests[i].field;
+        if (field >= cedict::kLookupFieldCount) {
+            cedict::ResponseWriter response(batch.out, 0);
+            continue;
+        }
+        const cedict::FieldIndex<WCHAR>* pIndex = indexes[field];
+        UINT32 id = pIndex ? pIndex->Find(batch.keys[i]) : batch.tradIds[iTrad++];
+        cedict::ResponseWriter response(batch.out, CountMatches(dict, id, pIndex));
+        AddEntries(dict, response, id, pIndex, batch);
+    }
+    return cbUsed;
+}
+
+bool WriteAll(HANDLE hPipe, const BYTE* pb, size_t cb)
+{
+    while (cb > 0) {
+        DWORD cbWritten = 0;
+        if (!WriteFile(hPipe, pb, static_cast<DWORD>(cb), &cbWritten, NULL)) return false;
+        pb += cbWritten;
+        cb -= cbWritten;
+    }
+    return true;
+}
+
+void Serve(const Dictionary& dict, HANDLE hPipe, int iConnection)
+{
+    Batch batch;
+    batch.englishBuf.resize(dict.EnglishBufferLength() + 1);
+    vector<BYTE> in(kPipeBufferSize);
+    size_t cbHave = 0;
+    size_t cRequests = 0;
+    size_t cBatches = 0;
+    bool fProtocolError = false;
+
+    for (;;) {
+        DWORD cbRead = 0;
+        if (!ReadFile(hPipe, &in[cbHave], static_cast<DWORD>(in.size() - cbHave), &cbRead, NULL)
+            || cbRead == 0) {
+            break;
+        }
+        cbHave += cbRead;
+
+        size_t cbUsed = AnswerBatch(dict, in.data(), cbHave, batch);
+        if (cbUsed == static_cast<size_t>(-1)) {
+            fProtocolError = true;
+            break;
+        }
+        if (!batch.requests.empty()) {
+            cRequests += batch.requests.size();
+            cBatches++;
+            if (!WriteAll(hPipe, batch.out.data(), batch.out.size())) break;
+        }
+        // Keep the start of a request that is not all there yet.
+        memmove(in.data(), in.data() + cbUsed, cbHave - cbUsed);
+        cbHave -= cbUsed;
+    }
+
+    DisconnectNamedPipe(hPipe);
+    CloseHandle(hPipe);
+
+    std::lock_guard<std::mutex> lock(g_coutMutex);
+    cout << "Connection " << iConnection << ": " << cRequests << " requests in " << cBatches
+        << " batches (" << (cBatches ? static_cast<double>(cRequests) / cBatches : 0.0)
+        << " per batch)" << (fProtocolError ? ", closed on a malformed request" : "") << '\n';
+    cout.flush();
+}
+
+} // namespace
+
+
+int main()
+{
+    cout << "Chinese English Dictionary server\n\n";
+
+    cedict::DictionaryOptions options;
+    options.buildIndex = true;
+    options.buildFieldIndexes = true;
+    options.buildThreads = 0;   // all the processors: nothing is served until it is done
+    Stopwatch sw;
+    sw.Start();
+    Dictionary dict(TEXT("cedict.u8"), options);
+    sw.Stop();
+    if (dict.Length() == 0) {
+        cout << "Cannot load cedict.u8.\n";
+        return 1;
+    }
+    cout << dict.Length() << " entries loaded and indexed in " << sw.ElapsedMilliseconds() << " ms\n";
+    cout << "Listening on ";
+    for (const WCHAR* pch = cedict::kLookupPipeName; *pch; ++pch) cout << static_cast<char>(*pch);
+    cout << '\n';
+    cout.flush();
+
+    for (int iConnection = 1; ; ++iConnection) {
+        // The first instance fails if another process already owns the name.
+        DWORD dwOpenMode = PIPE_ACCESS_DUPLEX | (iConnection == 1 ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+        HANDLE hPipe = CreateNamedPipe(cedict::kLookupPipeName, dwOpenMode,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, kPipeBufferSize, kPipeBufferSize, 0, NULL);
+        if (hPipe == INVALID_HANDLE_VALUE) {
+            cout << "Cannot create the pipe (error " << GetLastError() << ").\n";
+            return 1;
+        }
+        if (!ConnectNamedPipe(hPipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+            CloseHandle(hPipe);
+            continue;
+        }
+        std::thread(Serve, std::cref(dict), hPipe, iConnection).detach();
+    }
+}